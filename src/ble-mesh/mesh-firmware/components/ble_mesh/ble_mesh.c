@@ -70,6 +70,12 @@ static rgb_conf_t *rgb_conf;
 // we can use Espressif ID
 #define CID_ESP 0x02E5
 
+// vendor model that relays distance rows of station survey
+#define BLE_MESH_VND_MODEL_ID_DIST 0x0000
+#define BLE_MESH_MODEL_OP_DIST_ROW ESP_BLE_MESH_MODEL_OP_3(0x00, CID_ESP)
+// entry of distance row in message: address and distance, both uint16_t little endian
+#define DIST_ENTRY_SIZE 4
+
 // NVS handle for reading the web_config options
 static nvs_handle_t config_nvs;
 
@@ -194,6 +200,13 @@ static esp_ble_mesh_gen_location_setup_srv_t location_setup_server = {
 ESP_BLE_MESH_MODEL_PUB_DEFINE(location_cli_pub, 2 + LOC_LOCAL_SIZE, ROLE_NODE);
 static esp_ble_mesh_client_t location_client;
 
+// Distance row model definition
+// it has no state, received rows are passed to value change callback
+static esp_ble_mesh_model_op_t dist_op[] = {
+    ESP_BLE_MESH_MODEL_OP(BLE_MESH_MODEL_OP_DIST_ROW, 0),
+    ESP_BLE_MESH_MODEL_OP_END,
+};
+
 /*
  * Definitions of BLE-mesh Elements
  */
@@ -215,6 +228,11 @@ static esp_ble_mesh_model_t root_models[] = {
     ESP_BLE_MESH_MODEL_GEN_LEVEL_CLI(&level_cli_pub, &level_client),
 };
 
+// vendor models of the main element
+static esp_ble_mesh_model_t vnd_models[] = {
+    ESP_BLE_MESH_VENDOR_MODEL(CID_ESP, BLE_MESH_VND_MODEL_ID_DIST, dist_op, NULL, NULL),
+};
+
 // additional elements that are needed for RGB server
 static esp_ble_mesh_model_t extend_model_0[] = {
     BLE_MESH_MODEL_RGB_ELM1_SRV(&rgb_elm1_pub, &rgb_srv_elm1),
@@ -225,7 +243,7 @@ static esp_ble_mesh_model_t extend_model_1[] = {
 
 // array of elements used in this node
 static esp_ble_mesh_elem_t elements[] = {
-    ESP_BLE_MESH_ELEMENT(0, root_models, ESP_BLE_MESH_MODEL_NONE),
+    ESP_BLE_MESH_ELEMENT(0, root_models, vnd_models),
     ESP_BLE_MESH_ELEMENT(0, extend_model_0, ESP_BLE_MESH_MODEL_NONE),
     ESP_BLE_MESH_ELEMENT(0, extend_model_1, ESP_BLE_MESH_MODEL_NONE),
 };
@@ -485,6 +503,12 @@ static void example_ble_mesh_config_server_cb(esp_ble_mesh_cfg_server_cb_event_t
                 param->value.state_change.appkey_add.net_idx,
                 param->value.state_change.appkey_add.app_idx);
             ESP_LOG_BUFFER_HEX("AppKey", param->value.state_change.appkey_add.app_key, 16);
+            // provisioning apps do not know the distance row model, bind it locally
+            esp_err_t err = esp_ble_mesh_node_bind_app_key_to_local_model(esp_ble_mesh_get_primary_element_address(),
+                CID_ESP, BLE_MESH_VND_MODEL_ID_DIST, param->value.state_change.appkey_add.app_idx);
+            if(err != ESP_OK){
+                LOGGER_E(TAG, "Could not bind AppKey to distance row model (err %d)", err);
+            }
             break;
         case ESP_BLE_MESH_MODEL_OP_MODEL_APP_BIND:
             LOGGER_I(TAG, "ESP_BLE_MESH_MODEL_OP_MODEL_APP_BIND");
@@ -540,6 +564,44 @@ static void rgb_client_get_cb(uint16_t addr, rgb_t rgb){
     }
 }
 
+// callback for vendor models
+// passes received distance rows (except own) to value change callback
+static void custom_model_cb(esp_ble_mesh_model_cb_event_t event, esp_ble_mesh_model_cb_param_t *param)
+{
+    if(event == ESP_BLE_MESH_MODEL_SEND_COMP_EVT && param->model_send_comp.err_code != ESP_OK){
+        LOGGER_E(TAG, "Could not send message 0x%06" PRIx32 " (err %d)", param->model_send_comp.opcode, param->model_send_comp.err_code);
+        return;
+    }
+    if(event != ESP_BLE_MESH_MODEL_OPERATION_EVT || param->model_operation.opcode != BLE_MESH_MODEL_OP_DIST_ROW){
+        return;
+    }
+    uint16_t src = param->model_operation.ctx->addr;
+    // rows sent to all nodes are delivered also to this node
+    if(src == esp_ble_mesh_get_primary_element_address()){
+        return;
+    }
+    size_t count = param->model_operation.length / DIST_ENTRY_SIZE;
+    if(count > BLE_MESH_DIST_ROW_MAX_ENTRIES){
+        count = BLE_MESH_DIST_ROW_MAX_ENTRIES;
+    }
+    ble_mesh_dist_entry_t entries[BLE_MESH_DIST_ROW_MAX_ENTRIES];
+    const uint8_t *msg = param->model_operation.msg;
+    for(size_t i = 0; i < count; i++){
+        entries[i].addr = msg[i * DIST_ENTRY_SIZE] | (msg[i * DIST_ENTRY_SIZE + 1] << 8);
+        entries[i].distance_cm = msg[i * DIST_ENTRY_SIZE + 2] | (msg[i * DIST_ENTRY_SIZE + 3] << 8);
+    }
+    LOGGER_I(TAG, "Distance row of 0x%04" PRIx16 " (%u entries)", src, (unsigned) count);
+    if(s_value_change_cb){
+        s_value_change_cb((ble_mesh_value_change_data_t){
+            .type=DIST_ROW_CHANGE,
+            .addr=src,
+            .dist_row={
+                .entries = entries,
+                .count = count
+            }});
+    }
+}
+
 // initialization of BLE-mesh
 // ideally it is called from app_main function
 static esp_err_t mesh_init(void)
@@ -551,6 +613,7 @@ static esp_err_t mesh_init(void)
     esp_ble_mesh_register_generic_server_callback(example_ble_mesh_generic_server_cb);
     esp_ble_mesh_register_generic_client_callback(generic_client_cb);
     esp_ble_mesh_register_health_server_callback(example_ble_mesh_health_server_cb);
+    esp_ble_mesh_register_custom_model_callback(custom_model_cb);
     ble_mesh_rgb_control_server_register_change_callback(update_light);
     ble_mesh_rgb_client_init();
     ble_mesh_rgb_client_register_get_cb(rgb_client_get_cb);
@@ -810,6 +873,31 @@ esp_err_t ble_mesh_get_level(uint16_t addr){
     return esp_ble_mesh_generic_client_get_state(&common, &get_state);
 }
 
+esp_err_t ble_mesh_send_dist_row(uint16_t addr, const ble_mesh_dist_entry_t *entries, size_t count){
+    if(count > BLE_MESH_DIST_ROW_MAX_ENTRIES){
+        return ESP_ERR_INVALID_SIZE;
+    }
+    uint8_t msg[BLE_MESH_DIST_ROW_MAX_ENTRIES * DIST_ENTRY_SIZE];
+    for(size_t i = 0; i < count; i++){
+        msg[i * DIST_ENTRY_SIZE]     = entries[i].addr & 0xff;
+        msg[i * DIST_ENTRY_SIZE + 1] = entries[i].addr >> 8;
+        msg[i * DIST_ENTRY_SIZE + 2] = entries[i].distance_cm & 0xff;
+        msg[i * DIST_ENTRY_SIZE + 3] = entries[i].distance_cm >> 8;
+    }
+
+    esp_ble_mesh_msg_ctx_t ctx = {0};
+    ctx.net_idx = store.net_idx;
+    ctx.app_idx = store.app_idx;
+    ctx.addr = addr;
+    ctx.send_ttl = 3;
+    ctx.send_rel = false;
+
+    LOGGER_I(TAG, "Sending distance row (%u entries) to 0x%04" PRIx16, (unsigned) count, addr);
+
+    return esp_ble_mesh_server_model_send_msg(&vnd_models[0], &ctx, BLE_MESH_MODEL_OP_DIST_ROW,
+        count * DIST_ENTRY_SIZE, msg);
+}
+
 esp_err_t ble_mesh_get_addresses(uint16_t *primary_addr, uint8_t *addresses){
     (*primary_addr) = esp_ble_mesh_get_primary_element_address();
     (*addresses) = esp_ble_mesh_get_element_count();
@@ -13,6 +13,7 @@
 
 #include "color/color.h"
 #include <inttypes.h>
+#include <stddef.h>
 #include "board.h"
 #include "rgb_control_client.h"
 #include "location_defs.h"
@@ -100,6 +101,32 @@ esp_err_t ble_mesh_set_level(uint16_t addr, int16_t level);
  */
 esp_err_t ble_mesh_get_level(uint16_t addr);
 
+/**
+ * @brief Maximum number of entries of a distance row
+ * 
+ * row of 40 entries fits into 14 segments of mesh message
+ * and its serial field ("AAAA=DDDD," per entry) into receive buffer of serial_comm
+ */
+#define BLE_MESH_DIST_ROW_MAX_ENTRIES 40
+
+/**
+ * @brief Distance measured by a station to another station (entry of distance row)
+ */
+typedef struct{
+    uint16_t addr; /**< address of the other station */
+    uint16_t distance_cm; /**< measured distance */
+} ble_mesh_dist_entry_t;
+
+/**
+ * @brief Send distances measured by this station to other stations (station survey)
+ * 
+ * @param addr destination address (0xffff for all nodes)
+ * @param entries distances to other stations
+ * @param count number of entries (at most @ref BLE_MESH_DIST_ROW_MAX_ENTRIES)
+ * @return esp_err_t ESP_OK if message is sent
+ */
+esp_err_t ble_mesh_send_dist_row(uint16_t addr, const ble_mesh_dist_entry_t *entries, size_t count);
+
 /**
  * @brief Get addresses of this node
  * 
@@ -113,9 +140,15 @@ typedef enum{
     LOC_LOCAL_CHANGE = 0,
     RGB_CHANGE,
     ONOFF_CHANGE,
-    LEVEL_CHANGE
+    LEVEL_CHANGE,
+    DIST_ROW_CHANGE
 } ble_mesh_value_change_type_t;
 
+typedef struct{
+    const ble_mesh_dist_entry_t *entries; /**< valid only during the callback */
+    uint8_t count;
+} ble_mesh_dist_row_t;
+
 typedef struct{
     ble_mesh_value_change_type_t type;
     uint16_t addr;
@@ -124,6 +157,7 @@ typedef struct{
         rgb_t rgb;
         bool onoff;
         int16_t level;
+        ble_mesh_dist_row_t dist_row;
     };
 } ble_mesh_value_change_data_t;
 
@@ -72,6 +72,45 @@ void log_init(){
     }
 }
 
+// length of one `AAAA=DDDD,` entry of distance row (format of StationSurvey)
+#define DIST_ENTRY_STR_LEN (4+1+4+1)
+
+// parse distance row `AAAA=DDDD,AAAA=DDDD` (hexadecimal address and distance in cm)
+static esp_err_t str_to_dist_row(const std::string& value, ble_mesh_dist_entry_t *entries, size_t *count){
+    size_t pos = 0;
+    *count = 0;
+    while(pos < value.length()){
+        size_t end = value.find(',', pos);
+        if(end == std::string::npos){
+            end = value.length();
+        }
+        if(*count >= BLE_MESH_DIST_ROW_MAX_ENTRIES){
+            return ESP_ERR_INVALID_SIZE;
+        }
+        ble_mesh_dist_entry_t& entry = entries[*count];
+        if(sscanf(value.substr(pos, end - pos).c_str(), "%4" SCNx16 "=%4" SCNx16, &entry.addr, &entry.distance_cm) != 2){
+            return ESP_FAIL;
+        }
+        (*count)++;
+        pos = end + 1;
+    }
+    return ESP_OK;
+}
+
+static std::string dist_row_to_str(const ble_mesh_dist_row_t& row){
+    std::string value;
+    value.reserve(row.count * DIST_ENTRY_STR_LEN);
+    for(size_t i = 0; i < row.count; i++){
+        char entry[DIST_ENTRY_STR_LEN + 1];
+        snprintf(entry, sizeof(entry), "%04" PRIx16 "=%04" PRIx16 ",", row.entries[i].addr, row.entries[i].distance_cm);
+        value += entry;
+    }
+    if(!value.empty()){
+        value.pop_back(); // trailing ','
+    }
+    return value;
+}
+
 void serial_comm_change_callback(uint16_t addr, const std::string& field, const std::string& value){
     if(field == "rgb"){
         rgb_t color;
@@ -116,6 +155,16 @@ void serial_comm_change_callback(uint16_t addr, const std::string& field, const
         ESP_LOGI(TAG, "Setting 0x%04" PRIx16 " to level: %" PRId16, addr, level);
         ble_mesh_set_level(addr, level);
     }
+    if(field == "dist"){
+        ble_mesh_dist_entry_t entries[BLE_MESH_DIST_ROW_MAX_ENTRIES];
+        size_t count;
+        esp_err_t err = str_to_dist_row(value, entries, &count);
+        if(err != ESP_OK){
+            LOGGER_E(TAG, "Invalid distance row: %s", value.c_str());
+            return;
+        }
+        ble_mesh_send_dist_row(addr, entries, count);
+    }
 }
 
 void serial_comm_get_callback(uint16_t addr, const std::string& field){
@@ -217,6 +266,9 @@ extern "C" void value_change_cb(ble_mesh_value_change_data_t event_data){
 
         serialSrv->SetField(event_data.addr, "level", buf, false);
     }
+    if(event_data.type == DIST_ROW_CHANGE){
+        serialSrv->SetField(event_data.addr, "dist", dist_row_to_str(event_data.dist_row), false);
+    }
 }
 
 // entry point of program
@@ -12,7 +12,12 @@
 #include "esp_log.h"
 #include "esp_event.h"
 #include "esp_wifi.h"
+#include "esp_timer.h"
+#include "esp_random.h"
 #include <stdint.h>
+#include <cmath>
+#include <algorithm>
+#include <limits>
 
 #define EVENT_LOOP_QUEUE_SIZE 16
 
@@ -31,44 +36,80 @@ constexpr float distance_bias = 1.687536 * 100;
  */
 constexpr float distance_multi = 0.659338;
 
-EventGroupHandle_t DistancePoint::_s_ftm_event_group {};
-wifi_event_ftm_report_t DistancePoint::_s_ftm_report{};
+typedef struct{
+    float speed_cm_s; /**< assumed movement of point or this device even if the distance did not change */
+    float near_cm; /**< added to distance so that priority of very close points is bounded */
+    float unknown_distance_cm; /**< distance used for points that were never measured successfully */
+    float rate_smoothing; /**< weight of new sample in running averages of rate and duration */
+} scheduling_config_t;
 
-esp_err_t DistancePoint::initDistanceMeasurement(){
-    _s_ftm_event_group = xEventGroupCreate();
+constexpr scheduling_config_t scheduling_config {
+    .speed_cm_s = 30,
+    .near_cm = 100,
+    .unknown_distance_cm = 20 * 100,
+    .rate_smoothing = 0.5,
+};
 
-    return esp_event_handler_instance_register(WIFI_EVENT,
-                                               WIFI_EVENT_FTM_REPORT,
-                                               &DistancePoint::event_handler,
-                                               NULL,
-                                               NULL);
-}
+const health_config_t dm_point_health_config {
+    .backoff_base = pdMS_TO_TICKS(CONFIG_DISTANCE_POINT_BACKOFF_BASE_MS),
+    .backoff_max = pdMS_TO_TICKS(CONFIG_DISTANCE_POINT_BACKOFF_MAX_MS),
+    .jitter = 0.25,
+    .dead_failures = CONFIG_DISTANCE_POINT_DEAD_FAILURES,
+    .probe_interval = pdMS_TO_TICKS(CONFIG_DISTANCE_POINT_PROBE_INTERVAL_MS),
+    .probation_successes = 2,
+};
 
-void DistancePoint::event_handler(void* arg, esp_event_base_t event_base, 
-            int32_t event_id, void* event_data){
-    if (event_id == WIFI_EVENT_FTM_REPORT) {
-        wifi_event_ftm_report_t *event = (wifi_event_ftm_report_t *) event_data;
-
-        if (event->status == FTM_STATUS_SUCCESS) {
-            if(_s_ftm_report.ftm_report_data){
-                free(_s_ftm_report.ftm_report_data);
-                _s_ftm_report.ftm_report_data = NULL;
-                _s_ftm_report.ftm_report_num_entries = 0;
-            }
-            _s_ftm_report.rtt_raw = event->rtt_raw;
-            _s_ftm_report.rtt_est = event->rtt_est;
-            _s_ftm_report.dist_est = event->dist_est;
-            _s_ftm_report.ftm_report_data = event->ftm_report_data;
-            _s_ftm_report.ftm_report_num_entries = event->ftm_report_num_entries;
-            xEventGroupSetBits(_s_ftm_event_group, FTM_REPORT_BIT);
-            ESP_LOGI(TAG, "FTM measurement success");
-        } else {
-            ESP_LOGW(TAG, "FTM procedure with Peer(" MACSTR ") failed! (Status - %d)",
-                     MAC2STR(event->peer_mac), event->status);
-            xEventGroupSetBits(_s_ftm_event_group, FTM_FAILURE_BIT);
-        }
-    }
-}
+/**
+ * @brief Expected airtime of FTM sessions planned in one round (0 = measure all points in every round)
+ */
+constexpr int64_t tick_budget_us = (int64_t) CONFIG_DISTANCE_METER_TICK_BUDGET_MS * 1000;
+
+/**
+ * @brief Expected airtime off home channel in one round (0 = no limit)
+ */
+constexpr int64_t home_dwell_us = (int64_t) CONFIG_DISTANCE_METER_HOME_DWELL_MS * 1000;
+
+typedef struct{
+    uint8_t default_frm_count; /**< frame count assumed for 0 = no preference */
+    uint16_t default_burst_period; /**< burst period (100 ms) assumed for 0 = no preference */
+    uint32_t frames_per_burst; /**< FTM frames exchanged in one burst */
+    uint32_t frame_ms; /**< time of one FTM frame exchange */
+    uint32_t timeout_margin_ms; /**< session is failed when it does not report this long after its nominal duration */
+} ftm_timing_t;
+
+constexpr ftm_timing_t ftm_timing {
+    .default_frm_count = 16,
+    .default_burst_period = 2,
+    .frames_per_burst = 8,
+    .frame_ms = 2,
+    .timeout_margin_ms = CONFIG_DISTANCE_FTM_TIMEOUT_MARGIN_MS,
+};
+
+typedef struct{
+    TickType_t ttl; /**< point is reachable this long after a scan found it */
+    TickType_t interval; /**< channel is scanned again after this time (before its points expire) */
+    TickType_t timeout; /**< scan without WIFI_EVENT_SCAN_DONE is considered finished after this time */
+    bool passive; /**< listen for beacons instead of sending probe requests */
+    uint32_t channel_time_ms; /**< time spent on the scanned channel */
+} reachability_config_t;
+
+constexpr reachability_config_t reachability_config {
+    .ttl = pdMS_TO_TICKS(CONFIG_DISTANCE_METER_REACHABLE_TTL_MS),
+    .interval = pdMS_TO_TICKS(CONFIG_DISTANCE_METER_REACHABLE_TTL_MS / 2),
+    .timeout = pdMS_TO_TICKS(CONFIG_DISTANCE_METER_SCAN_TIME_MS + 2000),
+#if CONFIG_DISTANCE_METER_PASSIVE_SCAN
+    .passive = true,
+#else
+    .passive = false,
+#endif
+    .channel_time_ms = CONFIG_DISTANCE_METER_SCAN_TIME_MS,
+};
+
+/**
+ * @brief Internal events of DistanceMeter event loop (session results passed to processing)
+ */
+ESP_EVENT_DEFINE_BASE(DM_SESSION_EVENT);
+#define DM_SESSION_DONE 0
 
 uint32_t DistancePoint::distanceCorrection(uint32_t distance_cm){
     return distance_bias + distance_multi * (float) distance_cm;
@@ -91,83 +132,138 @@ distance_measurement_t DistancePoint::filterDistance(const distance_measurement_
     };
 }
 
-esp_err_t DistancePoint::measureDistance(distance_measurement_t &measurement){
+esp_err_t DistancePoint::startMeasurement(){
     wifi_ftm_initiator_cfg_t ftmi_cfg {};
     memcpy(ftmi_cfg.resp_mac, _mac, 6);
     ftmi_cfg.channel = _channel;
     ftmi_cfg.frm_count = _frm_count;
     ftmi_cfg.burst_period = _burst_period;
 
-    ftm_result_t ftm_report = measureRawDistance(&ftmi_cfg);
+    return esp_wifi_ftm_initiate_session(&ftmi_cfg);
+}
 
-    if(ftm_report.status == FTM_STATUS_SUCCESS){
-        // calculate mean rssi
-        int32_t rssi_sum = 0;
-        for(auto && report : ftm_report.ftm_report_data){
-            rssi_sum += report.rssi;
-        }
-        int8_t rssi_mean = rssi_sum / (int32_t) ftm_report.ftm_report_data.size();
-        // filter distance
-        distance_measurement_t new_measurement = {
-            .distance_cm = distanceCorrection(ftm_report.dist_est),
-            .rssi = rssi_mean
-        };
-        measurement = filterDistance(new_measurement);
-        ESP_LOGI(TAG, "Measured distance to point with id=%" PRIu32 " dist_raw=%" PRIu32 " rssi_raw=%" PRId8 " dist_est=%" PRIu32 " rssi_avg=%" PRId8, _id, ftm_report.dist_est, rssi_mean, measurement.distance_cm, measurement.rssi);
-
-        // allow _latest_log = -1 but not anything other
-        if(_latest_log + 1 < 0) _latest_log = 0;
-        size_t next_log = _latest_log + 1;
-        if(next_log >= log_size){
-            ESP_LOGI(TAG, "resetting log index %d+1 (%d) to 0 (log_size=%d)", _latest_log, next_log, log_size);
-            next_log = 0;
+esp_err_t DistancePoint::finishMeasurement(const ftm_session_result_t &result, distance_measurement_t &measurement){
+    _duration_us = _attempted ? _duration_us + scheduling_config.rate_smoothing * ((float) result.duration_us - _duration_us) : result.duration_us;
+    _attempted = true;
+    _last_attempt = result.timestamp;
+
+    _health.update(result.success, result.timestamp, esp_random());
+    if(!result.success){
+        return ESP_FAIL;
+    }
+    if(!result.channel_switch){
+        _same_channel_duration_us = _same_channel_duration_us ?
+            _same_channel_duration_us + scheduling_config.rate_smoothing * ((float) result.duration_us - _same_channel_duration_us) : result.duration_us;
+    }
+
+    // filter distance
+    distance_measurement_t new_measurement = {
+        .distance_cm = distanceCorrection(result.dist_est),
+        .rssi = result.rssi
+    };
+    measurement = filterDistance(new_measurement);
+    ESP_LOGI(TAG, "Measured distance to point with id=%" PRIu32 " dist_raw=%" PRIu32 " rssi_raw=%" PRId8 " dist_est=%" PRIu32 " rssi_avg=%" PRId8, _id, result.dist_est, result.rssi, measurement.distance_cm, measurement.rssi);
+
+    // allow _latest_log = -1 but not anything other
+    if(_latest_log + 1 < 0) _latest_log = 0;
+    size_t next_log = _latest_log + 1;
+    if(next_log >= log_size){
+        ESP_LOGI(TAG, "resetting log index %d+1 (%d) to 0 (log_size=%d)", _latest_log, next_log, log_size);
+        next_log = 0;
+    }
+    assert(next_log < log_size);
+    if(_latest_log >= 0){
+        const distance_log_t& previous = _distance_log[_latest_log];
+        const float dt_s = pdTICKS_TO_MS(_last_attempt - previous.timestamp) / 1000.0f;
+        if(dt_s > 0){
+            const float rate = std::abs((float) measurement.distance_cm - (float) previous.measurement.distance_cm) / dt_s;
+            _rate_cm_s += scheduling_config.rate_smoothing * (rate - _rate_cm_s);
         }
-        assert(next_log < log_size);
-        _distance_log[next_log].timestamp = xTaskGetTickCount();
-        _distance_log[next_log].measurement.distance_cm = measurement.distance_cm;
-        _distance_log[next_log].measurement.rssi = rssi_mean;
-        _latest_log = next_log;
-        return ESP_OK;
     }
-    return ESP_FAIL;
+    _distance_log[next_log].timestamp = _last_attempt;
+    _distance_log[next_log].measurement.distance_cm = measurement.distance_cm;
+    _distance_log[next_log].measurement.rssi = result.rssi;
+    _latest_log = next_log;
+    return ESP_OK;
 }
 
-ftm_result_t DistancePoint::measureRawDistance(wifi_ftm_initiator_cfg_t* ftmi_cfg){
-    EventBits_t bits;
+uint32_t DistancePoint::nominalDuration(){
+    const uint32_t frames = _frm_count ? _frm_count : ftm_timing.default_frm_count;
+    const uint32_t burst_period_ms = (_burst_period ? _burst_period : ftm_timing.default_burst_period) * 100;
+    const uint32_t bursts = (frames + ftm_timing.frames_per_burst - 1) / ftm_timing.frames_per_burst;
+    // first burst starts immediately, the others wait for their burst period
+    return (bursts - 1) * burst_period_ms + frames * ftm_timing.frame_ms;
+}
 
-    // clear bits so that timeout of xEventGroupWaitBits does not have bits set from previous event
-    xEventGroupClearBits(_s_ftm_event_group, FTM_REPORT_BIT | FTM_FAILURE_BIT);
+uint32_t DistancePoint::sessionTimeout(){
+    return nominalDuration() + ftm_timing.timeout_margin_ms;
+}
 
-    esp_err_t err = esp_wifi_ftm_initiate_session(ftmi_cfg);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to start FTM session");
-        return {};
+uint32_t DistancePoint::expectedDuration(){
+    return _attempted ? _duration_us : nominalDuration() * 1000;
+}
+
+float DistancePoint::priority(TickType_t now){
+    if(!_attempted){
+        return std::numeric_limits<float>::infinity();
     }
-    
-    bits = xEventGroupWaitBits(_s_ftm_event_group, FTM_REPORT_BIT | FTM_FAILURE_BIT,
-                                           pdTRUE, pdFALSE, 5000 / portTICK_PERIOD_MS);
-    if ((bits & FTM_REPORT_BIT) != 0) {
-        ftm_result_t ftm_result {};
-        memcpy(ftm_result.peer_mac, _s_ftm_report.peer_mac, 6);
-        ftm_result.status = _s_ftm_report.status;
-        ftm_result.rtt_raw = _s_ftm_report.rtt_raw;
-        ftm_result.rtt_est = _s_ftm_report.rtt_est;
-        ftm_result.dist_est = _s_ftm_report.dist_est;
-        for(uint8_t i = 0; i < _s_ftm_report.ftm_report_num_entries; i++){
-            ftm_result.ftm_report_data.push_back(_s_ftm_report.ftm_report_data[i]);
+    const float age_s = pdTICKS_TO_MS(now - _last_attempt) / 1000.0f;
+    const float distance_cm = _latest_log >= 0 ? _distance_log[_latest_log].measurement.distance_cm : scheduling_config.unknown_distance_cm;
+    // expected change of distance since the last attempt relative to the distance
+    const float drift_cm = (_rate_cm_s + scheduling_config.speed_cm_s) * age_s;
+    return _usefulness * drift_cm / (distance_cm + scheduling_config.near_cm);
+}
+
+bool DistancePoint::isReachable(TickType_t now){
+    return _seen && now - _last_seen <= reachability_config.ttl;
+}
+
+uint64_t MacTable::key(const uint8_t mac[6]){
+    uint64_t key = 0;
+    for(size_t i = 0; i < 6; i++){
+        key = (key << 8) | mac[i];
+    }
+    return key;
+}
+
+size_t MacTable::slot(uint64_t key) const{
+    const size_t mask = _entries.size() - 1;
+    // multiplicative hashing, the high bits are the best mixed
+    size_t index = ((key * 0x9E3779B97F4A7C15ull) >> 32) & mask;
+    while(_entries[index].key != empty_key && _entries[index].key != key){
+        index = (index + 1) & mask;
+    }
+    return index;
+}
+
+void MacTable::grow(){
+    std::vector<entry_t> old_entries = std::move(_entries);
+    _entries.assign(std::max<size_t>(old_entries.size() * 2, 16), {empty_key, UINT32_MAX});
+    for(auto && entry : old_entries){
+        if(entry.key != empty_key){
+            _entries[slot(entry.key)] = entry;
         }
-        free(_s_ftm_report.ftm_report_data);
-        _s_ftm_report.ftm_report_data = NULL;
-        _s_ftm_report.ftm_report_num_entries = 0;
-        return ftm_result;
-    } else{
-        // FTM failed
-        ftm_result_t ftm_result {};
-        ftm_result.status = FTM_STATUS_FAIL;
-        ftm_result.dist_est = UINT32_MAX;
-        return ftm_result;
     }
-    return {};
+}
+
+void MacTable::insert(const uint8_t mac[6], uint32_t id){
+    // keep load factor at most 1/2 so that probe sequences stay short
+    if((_count + 1) * 2 > _entries.size()){
+        grow();
+    }
+    const uint64_t k = key(mac);
+    entry_t& entry = _entries[slot(k)];
+    if(entry.key == empty_key){
+        _count++;
+    }
+    entry = {k, id};
+}
+
+uint32_t MacTable::find(const uint8_t mac[6]) const{
+    if(_entries.empty()){
+        return UINT32_MAX;
+    }
+    return _entries[slot(key(mac))].id;
 }
 
 esp_err_t DistancePoint::getDistanceFromLog(distance_log_t &measurement_log, size_t offset){
@@ -214,19 +310,71 @@ DistanceMeter::DistanceMeter(bool wifi_initialized, bool only_reachable)
         ESP_LOGE(TAG, "create event loop failed");
     }
 
-    esp_err_t err = DistancePoint::initDistanceMeasurement();
+    esp_err_t err = initSessions();
     if(err != ESP_OK){
-        ESP_LOGE(TAG, "DistancePoint initDistanceMeasurement failed! %d", err);
+        ESP_LOGE(TAG, "DistanceMeter initSessions failed! %d", err);
     }
 }
 
 DistanceMeter::DistanceMeter(bool wifi_initialized, esp_event_loop_handle_t event_loop_handle, bool only_reachable) 
         : _only_reachable(only_reachable), _points() {
     _event_loop_hdl = event_loop_handle;
-    esp_err_t err = DistancePoint::initDistanceMeasurement();
+    esp_err_t err = initSessions();
     if(err != ESP_OK){
-        ESP_LOGE(TAG, "DistancePoint initDistanceMeasurement failed! %d", err);
+        ESP_LOGE(TAG, "DistanceMeter initSessions failed! %d", err);
+    }
+}
+
+DistanceMeter::~DistanceMeter(){
+    stopTask();
+    esp_event_handler_instance_unregister(WIFI_EVENT, WIFI_EVENT_FTM_REPORT, _ftm_handler);
+    if(_scan_handler){
+        esp_event_handler_instance_unregister(WIFI_EVENT, WIFI_EVENT_SCAN_DONE, _scan_handler);
     }
+    esp_event_handler_unregister_with(_event_loop_hdl, DM_SESSION_EVENT, DM_SESSION_DONE, &DistanceMeter::sessionResultHandler);
+    if(_session_timer){
+        esp_timer_stop(_session_timer);
+        esp_timer_delete(_session_timer);
+    }
+    vSemaphoreDelete(_mutex);
+}
+
+esp_err_t DistanceMeter::initSessions(){
+    _mutex = xSemaphoreCreateMutex();
+
+    const esp_timer_create_args_t timer_args {
+        .callback = &DistanceMeter::sessionTimeoutCallback,
+        .arg = this,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "DM-session",
+        .skip_unhandled_events = true,
+    };
+    esp_err_t err = esp_timer_create(&timer_args, &_session_timer);
+    if(err != ESP_OK){
+        return err;
+    }
+
+    err = esp_event_handler_register_with(_event_loop_hdl, DM_SESSION_EVENT, DM_SESSION_DONE, &DistanceMeter::sessionResultHandler, this);
+    if(err != ESP_OK){
+        return err;
+    }
+
+    // default event loop needs to be created before
+    if(_only_reachable){
+        err = esp_event_handler_instance_register(WIFI_EVENT,
+                                                  WIFI_EVENT_SCAN_DONE,
+                                                  &DistanceMeter::scanEventHandler,
+                                                  this,
+                                                  &_scan_handler);
+        if(err != ESP_OK){
+            return err;
+        }
+    }
+    return esp_event_handler_instance_register(WIFI_EVENT,
+                                               WIFI_EVENT_FTM_REPORT,
+                                               &DistanceMeter::ftmEventHandler,
+                                               this,
+                                               &_ftm_handler);
 }
 
 uint32_t DistanceMeter::addPoint(uint8_t mac[6], uint8_t channel, uint32_t id){
@@ -280,6 +428,10 @@ uint32_t DistanceMeter::_addPoint(const uint8_t mac[6], std::string macstr, uint
     ESP_LOGI(TAG, "Added point: [%s] channel %d", macstr.c_str(), channel);
     _points.emplace(id, std::make_shared<DistancePoint>(id, mac, macstr, channel));
     _points_mac_id.emplace(macstr, id);
+    _points_mac.insert(mac, id);
+    if(std::none_of(_scan_channels.begin(), _scan_channels.end(), [channel](const channel_scan_t& c){ return c.channel == channel; })){
+        _scan_channels.push_back({channel, false, 0});
+    }
     return id;
 }
 
@@ -291,6 +443,15 @@ std::shared_ptr<DistancePoint> DistanceMeter::getPoint(uint32_t id){
     return nullptr;
 }
 
+esp_err_t DistanceMeter::getDistanceFromLog(uint32_t id, distance_log_t &measurement, size_t offset){
+    std::shared_ptr<DistancePoint> point = getPoint(id);
+    if(!point) return ESP_ERR_NOT_FOUND;
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    esp_err_t err = point->getDistanceFromLog(measurement, offset);
+    xSemaphoreGive(_mutex);
+    return err;
+}
+
 void DistanceMeter::startTask(){
     stopTask();
     // STACK_SIZE=1024*2???
@@ -308,10 +469,36 @@ void DistanceMeter::stopTask(){
     }
 }
 
+TickType_t distance_log_age(const distance_log_t& log, TickType_t now){
+    return now - log.timestamp;
+}
+
+bool distance_log_expired(const distance_log_t& log, TickType_t now, const distance_aging_t& aging){
+    return distance_log_age(log, now) > aging.horizon;
+}
+
+float distance_log_sigma(const distance_log_t& log, TickType_t now, const distance_aging_t& aging){
+    const float age_s = pdTICKS_TO_MS(distance_log_age(log, now)) / 1000.0f;
+    const float drift = aging.speed_cm_s * age_s;
+    return std::sqrt(aging.sigma_cm * aging.sigma_cm + drift * drift);
+}
+
+uint32_t distance_log_upper_bound(const distance_log_t& log, TickType_t now, const distance_aging_t& aging){
+    const float age_s = pdTICKS_TO_MS(distance_log_age(log, now)) / 1000.0f;
+    return log.measurement.distance_cm + (uint32_t)(aging.speed_cm_s * age_s);
+}
+
+/**
+ * @brief Aging of distances for nearest device selection (in 10s travel by 3m)
+ */
+static constexpr distance_aging_t nearest_aging {
+    .sigma_cm = 0,
+    .speed_cm_s = 30,
+    .horizon = portMAX_DELAY,
+};
+
 static uint32_t nearestDeviceDistanceFunction(const distance_log_t& log, TickType_t now){
-    TickType_t time_diff = (pdTICKS_TO_MS(now) - pdTICKS_TO_MS(log.timestamp));
-    // in 10s travel by 3m = 300 cm in 10000 ms
-    return log.measurement.distance_cm + (time_diff * (300.0 / 10000.0));
+    return distance_log_upper_bound(log, now, nearest_aging);
 }
 
 std::shared_ptr<DistancePoint> DistanceMeter::nearestPoint() {
@@ -323,6 +510,8 @@ std::shared_ptr<DistancePoint> DistanceMeter::nearestPoint() {
     bool first = true;
     distance_log_t log_measurement;
     esp_err_t err;
+    // logs are written by measurementDone() in event loop
+    xSemaphoreTake(_mutex, portMAX_DELAY);
     for(const auto& [id, point] : _points){
         err = point->getDistanceFromLog(log_measurement);
         if(err != ESP_OK) continue;
@@ -334,69 +523,274 @@ std::shared_ptr<DistancePoint> DistanceMeter::nearestPoint() {
             best_id = id;
         }
     }
+    xSemaphoreGive(_mutex);
     if(first){
         // no nearest point was found
         return nullptr;
     }
     return _points[best_id];
 }
-std::vector<std::shared_ptr<DistancePoint>> DistanceMeter::reachablePoints(){
-    static uint16_t g_scan_ap_num;
-    static wifi_ap_record_t *g_ap_list_buffer;
+void DistanceMeter::checkScanTimeout(TickType_t now){
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    if(_scanning && now - _scan_start > reachability_config.timeout){
+        ESP_LOGW(TAG, "Scan did not finish in time");
+        esp_wifi_scan_stop();
+        endScan();
+    }
+    xSemaphoreGive(_mutex);
+    postSessionResults();
+}
 
-    std::vector<std::shared_ptr<DistancePoint>> result;
+void DistanceMeter::endScan(){
+    _scanning = false;
+    // measureDistance() may have queued a session during the scan
+    if(!_active){
+        startNextSession();
+    }
+}
 
-    wifi_scan_config_t scan_config {};
-    esp_err_t err;
-    uint8_t i;
+bool DistanceMeter::refreshReachability(TickType_t now){
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    // sessions and scans do not share the radio, sessions queued by measureDistance() go first
+    const bool busy = _scanning || _active || !_queue.empty();
+    const bool scanning = _scanning;
+    xSemaphoreGive(_mutex);
+    if(busy){
+        return scanning;
+    }
 
-    err = esp_wifi_scan_start(&scan_config, true);
-    if (err != ESP_OK) {
-        ESP_LOGI(TAG, "Failed to perform scan");
-        return {};
+    // channel never scanned or scanned the longest time ago
+    auto oldest = std::min_element(_scan_channels.begin(), _scan_channels.end(), [now](const channel_scan_t& a, const channel_scan_t& b){
+        if(a.scanned != b.scanned) return !a.scanned;
+        return now - a.last_scan > now - b.last_scan;
+    });
+    if(oldest == _scan_channels.end() || (oldest->scanned && now - oldest->last_scan < reachability_config.interval)){
+        return false;
     }
 
-    esp_wifi_scan_get_ap_num(&g_scan_ap_num);
-    if (g_scan_ap_num == 0) {
-        ESP_LOGI(TAG, "No matching AP found");
-        return {};
+    wifi_scan_config_t scan_config {};
+    scan_config.channel = oldest->channel;
+    scan_config.show_hidden = true;
+    if(reachability_config.passive){
+        scan_config.scan_type = WIFI_SCAN_TYPE_PASSIVE;
+        scan_config.scan_time.passive = reachability_config.channel_time_ms;
+    } else{
+        scan_config.scan_type = WIFI_SCAN_TYPE_ACTIVE;
+        scan_config.scan_time.active.min = reachability_config.channel_time_ms;
+        scan_config.scan_time.active.max = reachability_config.channel_time_ms;
     }
 
-    if (g_ap_list_buffer) {
-        free(g_ap_list_buffer);
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    esp_err_t err = ESP_ERR_INVALID_STATE;
+    if(!_active && _queue.empty()){
+        err = esp_wifi_scan_start(&scan_config, false);
     }
+    if(err == ESP_OK){
+        _scanning = true;
+        _scan_start = now;
+    }
+    xSemaphoreGive(_mutex);
+    // channel is not retried before interval even if the scan could not be started
+    oldest->scanned = true;
+    oldest->last_scan = now;
+    if(err != ESP_OK){
+        ESP_LOGI(TAG, "Failed to start scan of channel %d: %s", oldest->channel, esp_err_to_name(err));
+        return false;
+    }
+    ESP_LOGI(TAG, "Scanning channel %d", oldest->channel);
+    return true;
+}
+
+void DistanceMeter::scanEventHandler(void* arg, esp_event_base_t event_base, 
+            int32_t event_id, void* event_data){
+    if (event_id != WIFI_EVENT_SCAN_DONE) return;
+    static_cast<DistanceMeter*>(arg)->scanDone();
+}
 
-    g_ap_list_buffer = (wifi_ap_record_t*) malloc(g_scan_ap_num * sizeof(wifi_ap_record_t));
-    if (g_ap_list_buffer == NULL) {
-        ESP_LOGE(TAG, "Failed to malloc buffer to print scan results");
-        return {};
+void DistanceMeter::scanDone(){
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    const bool own_scan = _scanning;
+    xSemaphoreGive(_mutex);
+    if(!own_scan){
+        // scan of other component (e.g. wifi_connect), its records are not ours to read
+        return;
     }
 
-    err = esp_wifi_scan_get_ap_records(&g_scan_ap_num, (wifi_ap_record_t *)g_ap_list_buffer);
-    if (err == ESP_OK) {
-        for (i = 0; i < g_scan_ap_num; i++) {
-            char buffer[17+1];
-            sprintf(buffer, MACSTR, MAC2STR(g_ap_list_buffer[i].bssid));
-            std::string mac {buffer};
-            if(_points_mac_id.contains(mac) && g_ap_list_buffer[i].ftm_responder){
-                result.push_back(_points[_points_mac_id[mac]]);
+    const TickType_t now = xTaskGetTickCount();
+    uint16_t ap_num = 0;
+    esp_wifi_scan_get_ap_num(&ap_num);
+    // records are read even without points to release them in WiFi driver
+    if(_ap_records.size() < ap_num){
+        _ap_records.resize(ap_num);
+    }
+    size_t seen = 0;
+    if(ap_num > 0 && esp_wifi_scan_get_ap_records(&ap_num, _ap_records.data()) == ESP_OK){
+        // reachability is read by tick() in DM task
+        xSemaphoreTake(_mutex, portMAX_DELAY);
+        for(uint16_t i = 0; i < ap_num; i++){
+            const wifi_ap_record_t& record = _ap_records[i];
+            if(!record.ftm_responder) continue;
+            const uint32_t id = _points_mac.find(record.bssid);
+            if(id == UINT32_MAX) continue;
+            std::shared_ptr<DistancePoint> point = getPoint(id);
+            if(point){
+                point->setSeen(now);
+                seen++;
             }
-            ESP_LOGI(TAG, "[%s][%s][rssi=%d]""%s", mac.c_str(), g_ap_list_buffer[i].ssid, g_ap_list_buffer[i].rssi,
-                        g_ap_list_buffer[i].ftm_responder ? "[FTM Responder]" : "");
         }
+        xSemaphoreGive(_mutex);
     }
 
-    ESP_LOGI(TAG, "sta scan done");
-    return result;
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    endScan();
+    xSemaphoreGive(_mutex);
+    postSessionResults();
+    ESP_LOGI(TAG, "Scan done, %d APs, %d points seen", ap_num, seen);
 }
 
-esp_err_t DistanceMeter::measureDistance(std::shared_ptr<DistancePoint> point){
-    if(!point) return ESP_FAIL;
-    
-    esp_err_t err;
-    distance_measurement_t measurement {UINT32_MAX, INT8_MIN};
+void DistanceMeter::startNextSession(){
+    while(!_queue.empty()){
+        std::shared_ptr<DistancePoint> point = _queue.front();
+        _queue.pop_front();
 
-    err = point->measureDistance(measurement);
+        _active_start_us = esp_timer_get_time();
+        esp_err_t err = point->startMeasurement();
+        if(err == ESP_OK){
+            const uint32_t timeout_ms = point->sessionTimeout();
+            _active_switched = _channel != 0 && point->getChannel() != _channel;
+            _channel = point->getChannel();
+            _active = point;
+            _active_deadline_us = _active_start_us + (int64_t) timeout_ms * 1000;
+            esp_timer_start_once(_session_timer, (uint64_t) timeout_ms * 1000);
+            return;
+        }
+        ESP_LOGE(TAG, "Failed to start FTM session with [%s]: %s", point->getMacStr().c_str(), esp_err_to_name(err));
+        ftm_session_result_t result {};
+        result.point_id = point->getID();
+        result.success = false;
+        result.timestamp = xTaskGetTickCount();
+        _results.push_back(result);
+    }
+}
+
+void DistanceMeter::finishSession(ftm_session_result_t &result){
+    result.point_id = _active->getID();
+    result.duration_us = esp_timer_get_time() - _active_start_us;
+    result.timestamp = xTaskGetTickCount();
+    _session_stats.sessions++;
+    result.channel_switch = _active_switched;
+    if(_active_switched){
+        _session_stats.channel_switches++;
+    }
+    // usual duration does not include this session yet (it is processed in event loop)
+    if(result.success && _active->sameChannelDuration() > 0){
+        const int64_t excess_us = (int64_t) result.duration_us - _active->sameChannelDuration();
+        if(_active_switched){
+            _session_stats.switch_samples++;
+            _session_stats.switch_excess_us += excess_us;
+        } else{
+            _session_stats.same_channel_samples++;
+            _session_stats.same_channel_excess_us += excess_us;
+        }
+    }
+    _active = nullptr;
+    _results.push_back(result);
+    // radio measures the next point while this result is processed in event loop
+    startNextSession();
+}
+
+void DistanceMeter::postSessionResults(){
+    while(true){
+        xSemaphoreTake(_mutex, portMAX_DELAY);
+        if(_results.empty()){
+            xSemaphoreGive(_mutex);
+            return;
+        }
+        const ftm_session_result_t result = _results.front();
+        _results.pop_front();
+        xSemaphoreGive(_mutex);
+
+        esp_err_t err = esp_event_post_to(_event_loop_hdl, DM_SESSION_EVENT, DM_SESSION_DONE, &result, sizeof(result), pdMS_TO_TICKS(10));
+        if(err != ESP_OK){
+            xSemaphoreTake(_mutex, portMAX_DELAY);
+            _session_stats.dropped_results++;
+            const uint32_t dropped = _session_stats.dropped_results;
+            xSemaphoreGive(_mutex);
+            ESP_LOGE(TAG, "failed to post session result of point %" PRIu32 "! %s (%" PRIu32 " results lost)", result.point_id, esp_err_to_name(err), dropped);
+        }
+    }
+}
+
+void DistanceMeter::ftmEventHandler(void* arg, esp_event_base_t event_base, 
+            int32_t event_id, void* event_data){
+    if (event_id != WIFI_EVENT_FTM_REPORT) return;
+    DistanceMeter* dm = static_cast<DistanceMeter*>(arg);
+    wifi_event_ftm_report_t *event = (wifi_event_ftm_report_t *) event_data;
+
+    ftm_session_result_t result {};
+    if (event->status == FTM_STATUS_SUCCESS && event->ftm_report_num_entries > 0) {
+        // calculate mean rssi
+        int32_t rssi_sum = 0;
+        for(uint8_t i = 0; i < event->ftm_report_num_entries; i++){
+            rssi_sum += event->ftm_report_data[i].rssi;
+        }
+        result.success = true;
+        result.dist_est = event->dist_est;
+        result.rssi = rssi_sum / (int32_t) event->ftm_report_num_entries;
+    } else {
+        ESP_LOGW(TAG, "FTM procedure with Peer(" MACSTR ") failed! (Status - %d)",
+                 MAC2STR(event->peer_mac), event->status);
+    }
+    if(event->ftm_report_data){
+        free(event->ftm_report_data);
+        event->ftm_report_data = NULL;
+        event->ftm_report_num_entries = 0;
+    }
+
+    xSemaphoreTake(dm->_mutex, portMAX_DELAY);
+    if(dm->_active && memcmp(dm->_active->getMac(), event->peer_mac, 6) == 0){
+        esp_timer_stop(dm->_session_timer);
+        dm->finishSession(result);
+    } else{
+        // session already timed out
+        ESP_LOGW(TAG, "Ignoring late FTM report of Peer(" MACSTR ")", MAC2STR(event->peer_mac));
+    }
+    xSemaphoreGive(dm->_mutex);
+    dm->postSessionResults();
+}
+
+void DistanceMeter::sessionTimeoutCallback(void* arg){
+    DistanceMeter* dm = static_cast<DistanceMeter*>(arg);
+    xSemaphoreTake(dm->_mutex, portMAX_DELAY);
+    // report may have finished the session while this callback was waiting for the mutex
+    if(dm->_active && esp_timer_get_time() >= dm->_active_deadline_us){
+        ESP_LOGW(TAG, "FTM session with [%s] timed out", dm->_active->getMacStr().c_str());
+        esp_wifi_ftm_end_session();
+        ftm_session_result_t result {};
+        result.success = false;
+        dm->finishSession(result);
+    }
+    xSemaphoreGive(dm->_mutex);
+    dm->postSessionResults();
+}
+
+void DistanceMeter::sessionResultHandler(void* arg, esp_event_base_t event_base, 
+            int32_t event_id, void* event_data){
+    static_cast<DistanceMeter*>(arg)->measurementDone(*(ftm_session_result_t*) event_data);
+}
+
+void DistanceMeter::measurementDone(const ftm_session_result_t &result){
+    std::shared_ptr<DistancePoint> point = getPoint(result.point_id);
+    if(!point) return;
+
+    distance_measurement_t measurement {UINT32_MAX, INT8_MIN};
+    // DM task reads health, durations and logs of points when it plans a round
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    const dm_point_health_t old_health = point->getHealth();
+    esp_err_t err = point->finishMeasurement(result, measurement);
+    const dm_point_health_t new_health = point->getHealth();
+    const uint8_t failures = point->getFailures();
+    xSemaphoreGive(_mutex);
     bool valid = err == ESP_OK;
     dm_measurement_data_t event_data;
     event_data.point_id = point->getID();
@@ -407,30 +801,202 @@ esp_err_t DistanceMeter::measureDistance(std::shared_ptr<DistancePoint> point){
     err = esp_event_post_to(_event_loop_hdl, DM_EVENT, DM_MEASUREMENT_DONE, &event_data, sizeof(event_data), pdMS_TO_TICKS(10));
     if(err != ESP_OK){
         ESP_LOGE(TAG, "failed to post an event! %s", esp_err_to_name(err));
-        return ESP_FAIL;
     }
-    
-    return ESP_OK;
+
+    if(new_health != old_health){
+        dm_point_health_change_t health_data;
+        health_data.point_id = point->getID();
+        health_data.old_health = old_health;
+        health_data.new_health = new_health;
+        health_data.failures = failures;
+        if(health_data.new_health == DM_POINT_DEAD){
+            ESP_LOGW(TAG, "Point %" PRIu32 " [%s] is dead after %d failures", point->getID(), point->getMacStr().c_str(), health_data.failures);
+        }
+        err = esp_event_post_to(_event_loop_hdl, DM_EVENT, DM_POINT_HEALTH_CHANGE, &health_data, sizeof(health_data), pdMS_TO_TICKS(10));
+        if(err != ESP_OK){
+            ESP_LOGE(TAG, "failed to post an event! %s", esp_err_to_name(err));
+        }
+    }
+
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    if(_waiting_task && _waiting_point == result.point_id){
+        _waiting_err = valid ? ESP_OK : ESP_FAIL;
+        _waiting_measurement = measurement;
+        xTaskNotifyGive(_waiting_task);
+    }
+    xSemaphoreGive(_mutex);
+}
+
+esp_err_t DistanceMeter::measureDistance(uint32_t id, distance_measurement_t &measurement){
+    std::shared_ptr<DistancePoint> point = getPoint(id);
+    if(!point) return ESP_ERR_NOT_FOUND;
+
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    if(_waiting_task){
+        xSemaphoreGive(_mutex);
+        return ESP_ERR_INVALID_STATE;
+    }
+    // clear notification left by result that came after timeout of previous call
+    ulTaskNotifyTake(pdTRUE, 0);
+    _waiting_task = xTaskGetCurrentTaskHandle();
+    _waiting_point = id;
+    _waiting_err = ESP_ERR_TIMEOUT;
+    // wait for running session (or reachability scan) and the requested one
+    uint32_t timeout_ms = point->sessionTimeout();
+    if(_active){
+        timeout_ms += _active->sessionTimeout();
+    }
+    if(_scanning){
+        // session is started when the scan ends (endScan())
+        timeout_ms += pdTICKS_TO_MS(reachability_config.timeout);
+    }
+    _queue.push_front(point);
+    if(!_active && !_scanning){
+        startNextSession();
+    }
+    xSemaphoreGive(_mutex);
+    postSessionResults();
+
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(timeout_ms) + pdMS_TO_TICKS(100));
+
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    esp_err_t err = _waiting_err;
+    if(err == ESP_OK){
+        measurement = _waiting_measurement;
+    }
+    _waiting_task = nullptr;
+    _waiting_point = UINT32_MAX;
+    xSemaphoreGive(_mutex);
+    return err;
+}
+
+void DistanceMeter::scheduleRound(){
+    std::sort(_schedule.begin(), _schedule.end(), [](const scheduled_point_t& a, const scheduled_point_t& b){
+        return a.priority > b.priority;
+    });
+
+    // points that fit into the budget are moved to the front (in order of priority)
+    int64_t planned_us = 0;
+    size_t planned = 0;
+    for(size_t i = 0; i < _schedule.size(); i++){
+        const uint32_t duration_us = _schedule[i].duration_us;
+        // a shorter measurement of a point with lower priority may still fit
+        if(tick_budget_us > 0 && planned > 0 && planned_us + duration_us > tick_budget_us) continue;
+        std::swap(_schedule[planned], _schedule[i]);
+        planned_us += duration_us;
+        planned++;
+    }
+
+    uint8_t home_channel = 0;
+    if(home_dwell_us > 0){
+        wifi_second_chan_t second;
+        if(esp_wifi_get_channel(&home_channel, &second) != ESP_OK){
+            home_channel = 0;
+        }
+    }
+
+    // the highest priority of each channel, planned points are in order of priority so the first one is the highest
+    _channel_priority.clear();
+    for(size_t i = 0; i < planned; i++){
+        const uint8_t channel = _schedule[i].point->getChannel();
+        if(std::none_of(_channel_priority.begin(), _channel_priority.end(), [channel](const channel_priority_t& c){ return c.channel == channel; })){
+            _channel_priority.push_back({channel, _schedule[i].priority});
+        }
+    }
+
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    // radio is on home channel between rounds (or still on channel of the last session), that group goes first
+    const uint8_t first_channel = home_channel != 0 ? home_channel : _channel;
+    for(auto && c : _channel_priority){
+        if(c.channel == first_channel){
+            c.priority = std::numeric_limits<float>::infinity();
+        }
+    }
+    // groups by channel, group with higher priority first (points deferred by dwell limit lead the next round)
+    std::sort(_channel_priority.begin(), _channel_priority.end(), [](const channel_priority_t& a, const channel_priority_t& b){
+        return a.priority > b.priority || (a.priority == b.priority && a.channel < b.channel);
+    });
+    auto group_of = [this](const scheduled_point_t& entry){
+        const uint8_t channel = entry.point->getChannel();
+        return std::find_if(_channel_priority.begin(), _channel_priority.end(), [channel](const channel_priority_t& c){ return c.channel == channel; });
+    };
+    std::stable_sort(_schedule.begin(), _schedule.begin() + planned, [&group_of](const scheduled_point_t& a, const scheduled_point_t& b){
+        return group_of(a) < group_of(b);
+    });
+
+    int64_t queued_us = 0;
+    int64_t off_home_us = 0;
+    size_t queued = 0;
+    for(size_t i = 0; i < planned; i++){
+        const std::shared_ptr<DistancePoint>& point = _schedule[i].point;
+        const uint32_t duration_us = _schedule[i].duration_us;
+        if(home_channel != 0 && point->getChannel() != home_channel){
+            off_home_us += duration_us;
+            if(queued > 0 && off_home_us > home_dwell_us){
+                // the rest waits for next round, radio returns to home channel in between
+                _session_stats.dwell_limited++;
+                break;
+            }
+        }
+        _queue.push_back(point);
+        queued_us += duration_us;
+        queued++;
+    }
+    _session_stats.rounds++;
+    const dm_session_stats_t stats = _session_stats;
+    startNextSession();
+    xSemaphoreGive(_mutex);
+    postSessionResults();
+    ESP_LOGI(TAG, "Scheduled %d of %d points, expected airtime %" PRId64 " us, %" PRIu32 " channel switches in %" PRIu32 " sessions (%" PRId64 " us per switch)",
+        queued, _schedule.size(), queued_us, stats.channel_switches, stats.sessions, channelSwitchCost(stats));
+}
+
+dm_session_stats_t DistanceMeter::getSessionStats(){
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    const dm_session_stats_t stats = _session_stats;
+    xSemaphoreGive(_mutex);
+    return stats;
+}
+
+int64_t DistanceMeter::channelSwitchCost(const dm_session_stats_t &stats){
+    if(stats.switch_samples == 0 || stats.same_channel_samples == 0){
+        return 0;
+    }
+    return stats.switch_excess_us / stats.switch_samples - stats.same_channel_excess_us / stats.same_channel_samples;
 }
 
 void DistanceMeter::tick(TickType_t diff){
     static std::shared_ptr<DistancePoint> s_nearest_point = nullptr;
     esp_err_t err;
 
+    TickType_t now = xTaskGetTickCount();
+
     if(_only_reachable){
-        auto points = reachablePoints();
-        ESP_LOGI(TAG, "%d reachable points", points.size());
-        for(auto && point : points){
-            measureDistance(point);
-        }
-    } else{
-        ESP_LOGI(TAG, "Measuring distance to %d points", _points.size());
-        for(const auto& [key, point] : _points){
-            measureDistance(point);
-        }
+        // also when a round is running, measureDistance() may wait for the end of the scan
+        checkScanTimeout(now);
     }
 
-    TickType_t now = xTaskGetTickCount();
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    const bool round_running = _active != nullptr || !_queue.empty();
+    xSemaphoreGive(_mutex);
+
+    // next round is planned when sessions of the previous one are finished
+    if(!round_running){
+        _schedule.clear();
+        // in only_reachable mode FTM sessions wait while a channel is scanned
+        if(!_only_reachable || !refreshReachability(now)){
+            // points are updated by measurementDone() in event loop, also sessions queued by measureDistance()
+            // may finish during the round, state used for planning is read at once
+            xSemaphoreTake(_mutex, portMAX_DELAY);
+            for(const auto& [key, point] : _points){
+                if(!point->isEnabled() || !point->isDue(now)) continue;
+                if(_only_reachable && !point->isReachable(now)) continue;
+                _schedule.push_back({point->priority(now), point->expectedDuration(), point});
+            }
+            xSemaphoreGive(_mutex);
+            scheduleRound();
+        }
+    }
 
     auto nearest_point = nearestPoint();
     
@@ -440,7 +1006,9 @@ void DistanceMeter::tick(TickType_t diff){
 
     // check if this device is in near proximity
     distance_log_t log_measurement;
+    xSemaphoreTake(_mutex, portMAX_DELAY);
     err = nearest_point->getDistanceFromLog(log_measurement);
+    xSemaphoreGive(_mutex);
     if(err == ESP_OK){
         auto nearest_distance = nearestDeviceDistanceFunction(log_measurement, now);
         if(nearest_distance >= _distance_threshold_cm){
@@ -16,12 +16,14 @@
 #include "esp_wifi_types.h"
 #include "esp_err.h"
 #include "freertos/FreeRTOS.h"
-#include "freertos/event_groups.h"
+#include "freertos/semphr.h"
 #include "esp_event.h"
+#include "esp_timer.h"
 #include <vector>
 #include <memory>
 #include <cstring>
 #include "esp_mac.h"
+#include "point_health.hpp"
 
 #include <set>
 #include <unordered_map>
@@ -35,6 +37,7 @@ ESP_EVENT_DECLARE_BASE(DM_EVENT);
 typedef enum {
     DM_MEASUREMENT_DONE,
     DM_NEAREST_DEVICE_CHANGE,
+    DM_POINT_HEALTH_CHANGE,
 } dm_event_t;
 
 typedef struct {
@@ -43,14 +46,30 @@ typedef struct {
     TickType_t timestamp_ms;
 } dm_nearest_device_change_t;
 
+/**
+ * @brief Health configuration of all points (backoff, probe interval and dead failures from Kconfig)
+ */
+extern const health_config_t dm_point_health_config;
+
+typedef struct {
+    uint32_t point_id;
+    dm_point_health_t old_health;
+    dm_point_health_t new_health;
+    uint8_t failures; /**< number of consecutive failed measurements */
+} dm_point_health_change_t;
+
+/**
+ * @brief Result of one FTM session (passed from WiFi event handler to processing in DistanceMeter event loop)
+ */
 typedef struct{
-    uint8_t peer_mac[6];
-    wifi_ftm_status_t status;
-    uint32_t rtt_raw;
-    uint32_t rtt_est;
-    uint32_t dist_est;
-    std::vector<wifi_ftm_report_entry_t> ftm_report_data;
-} ftm_result_t;
+    uint32_t point_id; /**< id of measured DistancePoint */
+    bool success; /**< false if the session failed, timed out or could not be started */
+    uint32_t dist_est; /**< raw distance estimate (cm) */
+    int8_t rssi; /**< mean RSSI of FTM frames */
+    uint32_t duration_us; /**< time from start of the session to its result */
+    bool channel_switch; /**< session was on other channel than the previous one */
+    TickType_t timestamp; /**< time of the result */
+} ftm_session_result_t;
 
 typedef struct{
     uint32_t distance_cm;
@@ -62,12 +81,63 @@ typedef struct{
     TickType_t timestamp;
 } distance_log_t;
 
+/**
+ * @brief Model of distance measurement aging
+ * 
+ * Mobile device moves after the measurement, so the longer ago a distance was measured,
+ * the less it says about the current distance.
+ */
+typedef struct{
+    float sigma_cm; /**< standard deviation of fresh measurement */
+    float speed_cm_s; /**< expected speed of mobile device, distance may change by this much per second */
+    TickType_t horizon; /**< measurements older than this are not used at all */
+} distance_aging_t;
+
+/**
+ * @brief Time since the distance was measured
+ */
+TickType_t distance_log_age(const distance_log_t& log, TickType_t now);
+
+/**
+ * @brief Check if measurement is older than aging horizon
+ */
+bool distance_log_expired(const distance_log_t& log, TickType_t now, const distance_aging_t& aging);
+
+/**
+ * @brief Standard deviation of current distance (measurement error combined with possible movement since the measurement)
+ */
+float distance_log_sigma(const distance_log_t& log, TickType_t now, const distance_aging_t& aging);
+
+/**
+ * @brief Upper bound of current distance (measured distance extended by possible movement since the measurement)
+ */
+uint32_t distance_log_upper_bound(const distance_log_t& log, TickType_t now, const distance_aging_t& aging);
+
 typedef struct{
     uint32_t point_id;
     distance_measurement_t measurement;
     bool valid;
 } dm_measurement_data_t;
 
+/**
+ * @brief Counters of finished FTM sessions and channel switches between them
+ * 
+ * Excess is the duration of a successful session over the usual duration of its point without channel switch
+ * (DistancePoint::sameChannelDuration()). Cost of one channel switch is estimated as difference of mean excess
+ * of sessions with and without switch.
+ */
+typedef struct{
+    uint32_t rounds; /**< planned rounds */
+    uint32_t sessions; /**< finished sessions */
+    uint32_t channel_switches; /**< sessions on other channel than the previous session */
+    uint32_t switch_samples; /**< successful sessions with channel switch */
+    int64_t switch_excess_us; /**< total excess of successful sessions with channel switch */
+    uint32_t same_channel_samples; /**< successful sessions on the channel of the previous session */
+    int64_t same_channel_excess_us; /**< total excess of successful sessions without channel switch */
+    uint32_t dwell_limited; /**< rounds shortened by home channel dwell limit */
+    uint32_t dropped_results; /**< session results that could not be posted to the event loop (lost) */
+} dm_session_stats_t;
+
 /**
  * @brief Represents a point to which we can measure distance
  * 
@@ -91,31 +161,33 @@ class DistancePoint {
             }
         
         /**
-         * @brief Initialize WiFi FTM distance measurement
+         * @brief Start WiFi FTM session with this point (does not wait for result)
          * 
-         * default event loop needs to be created before calling this function
+         * result is reported by WIFI_EVENT_FTM_REPORT and handled by DistanceMeter
          * 
-         * @return esp_err_t returns ESP_OK if succeeds
+         * @return esp_err_t returns ESP_OK if the session was started
          */
-        static esp_err_t initDistanceMeasurement();
+        esp_err_t startMeasurement();
 
         /**
-         * @brief Start distance measurement and wait for result
+         * @brief Process result of FTM session started by startMeasurement()
          * 
-         * applies distance correction and filtering
+         * applies distance correction and filtering, updates log and scheduling state
          * 
+         * @param result result of the session
          * @param measurement resulting measurement
-         * @return esp_err_t returns ESP_OK if succeeds 
+         * @return esp_err_t returns ESP_OK if the session succeeded
          */
-        esp_err_t measureDistance(distance_measurement_t &measurement);
+        esp_err_t finishMeasurement(const ftm_session_result_t &result, distance_measurement_t &measurement);
 
         /**
-         * @brief Raw distance measurement using WiFi FTM
+         * @brief Time after which a running FTM session is considered failed
+         * 
+         * derived from frame count and burst period (@ref setFrameCount(), @ref setBurstPeriod())
          * 
-         * @param ftmi_conf WiFi FTM configuration
-         * @return ftm_result_t raw measurement results
+         * @return uint32_t timeout in milliseconds
          */
-        static ftm_result_t measureRawDistance(wifi_ftm_initiator_cfg_t* ftmi_conf);
+        uint32_t sessionTimeout();
 
         const uint8_t* getMac() { return _mac; }
         const std::string getMacStr() { return _macstr; }
@@ -146,34 +218,92 @@ class DistancePoint {
         esp_err_t setBurstPeriod(uint16_t burst_period);
 
         /**
-         * @brief number of measurements kept in log (history)
+         * @brief Enable or disable periodic measurements of this point in DistanceMeter::tick()
+         * 
+         * @param enabled false if the point should be skipped (e.g. it is on a distant floor and unreachable)
          */
-        static constexpr size_t log_size = 5;
-    private:
+        void setEnabled(bool enabled) { _enabled = enabled; }
+        bool isEnabled() { return _enabled; }
+
         /**
-         * @brief Handles events for WiFi FTM results
+         * @brief Set how useful the distance to this point is for localization (scales scheduling priority)
+         * 
+         * @param usefulness from 0 (not useful) to 1 (e.g. anchor used in the last position fix)
          */
-        static void event_handler(void* arg, esp_event_base_t event_base, 
-            int32_t event_id, void* event_data);
-        
+        void setUsefulness(float usefulness) { _usefulness = usefulness; }
+        float getUsefulness() { return _usefulness; }
+
+        /**
+         * @brief Scheduling priority of next measurement, points with higher priority are measured first
+         * 
+         * Priority grows with expected change of distance since the last attempt (time and rate of change)
+         * relative to the distance, so close and moving points are measured more often. It is scaled by
+         * usefulness. Points never measured have infinite priority. Failing points are not penalized here,
+         * they are left out by isDue() until their backoff elapses.
+         * 
+         * @param now current time
+         * @return float priority
+         */
+        float priority(TickType_t now);
+
+        /**
+         * @brief Expected duration of one measurement (running average, nominal session duration if not measured yet)
+         * 
+         * @return uint32_t duration in microseconds
+         */
+        uint32_t expectedDuration();
+
         /**
-         * @brief bit signaling FTM success (results are passed through @ref _s_ftm_report)
-         * used in waiting for FTM result - xEventGroupWaitBits()
+         * @brief Duration of successful measurements without channel switch (running average, 0 if unknown)
+         * 
+         * @return uint32_t duration in microseconds
          */
-        static const int FTM_REPORT_BIT = BIT0;
+        uint32_t sameChannelDuration() { return _same_channel_duration_us; }
+
         /**
-         * @brief bit signaling FTM failure - no results are passed
-         * used in waiting for FTM result - xEventGroupWaitBits()
+         * @brief Health of the point (see @ref dm_point_health_t)
          */
-        static const int FTM_FAILURE_BIT = BIT1;
+        dm_point_health_t getHealth() { return _health.health(); }
+
         /**
-         * @brief event group used for waiting for FTM result (used in xEventGroupWaitBits())
+         * @brief Check if the point can be measured (backoff or probe interval after failures elapsed)
+         * 
+         * @param now current time
+         * @return true if the point can be scheduled
          */
-        static EventGroupHandle_t _s_ftm_event_group;
+        bool isDue(TickType_t now) { return _health.isDue(now); }
+
         /**
-         * @brief static variable to pass result from event_handler() to individual instances
+         * @brief Number of consecutive failed measurements
+         */
+        uint8_t getFailures() { return _health.failures(); }
+
+        /**
+         * @brief Record that the point was found by WiFi scan as FTM responder
+         * 
+         * @param now current time
+         */
+        void setSeen(TickType_t now) { _last_seen = now; _seen = true; }
+
+        /**
+         * @brief Check if the point was seen by WiFi scan within reachability TTL (DISTANCE_METER_REACHABLE_TTL_MS)
+         * 
+         * @param now current time
+         * @return true if the point is considered reachable
          */
-        static wifi_event_ftm_report_t _s_ftm_report;
+        bool isReachable(TickType_t now);
+
+        /**
+         * @brief number of measurements kept in log (history)
+         */
+        static constexpr size_t log_size = 5;
+    private:
+        /**
+         * @brief Expected duration of FTM session from frame count and burst period
+         * 
+         * @return uint32_t duration in milliseconds
+         */
+        uint32_t nominalDuration();
 
         /**
          * @brief Apply correction to measured distance
@@ -202,6 +332,46 @@ class DistancePoint {
          * @brief delay between bursts of FTM frames in 100ms (allowed values 0=no preference/2-255)
          */
         uint16_t _burst_period = 0;
+        /**
+         * @brief point is measured in DistanceMeter::tick()
+         */
+        bool _enabled = true;
+        /**
+         * @brief usefulness for localization, see setUsefulness()
+         */
+        float _usefulness = 1;
+        /**
+         * @brief measurement was attempted at least once (@ref _last_attempt is valid)
+         */
+        bool _attempted = false;
+        /**
+         * @brief time of the last measurement attempt
+         */
+        TickType_t _last_attempt = 0;
+        /**
+         * @brief health, backoff and probation updated by finishMeasurement()
+         */
+        PointHealth _health {dm_point_health_config};
+        /**
+         * @brief point was found by WiFi scan (@ref _last_seen is valid)
+         */
+        bool _seen = false;
+        /**
+         * @brief time of the last WiFi scan that found the point
+         */
+        TickType_t _last_seen = 0;
+        /**
+         * @brief smoothed rate of change of distance (cm/s)
+         */
+        float _rate_cm_s = 0;
+        /**
+         * @brief smoothed duration of measurement (us)
+         */
+        uint32_t _duration_us = 0;
+        /**
+         * @brief smoothed duration of successful measurements without channel switch (us)
+         */
+        uint32_t _same_channel_duration_us = 0;
         size_t _filter_max_size;
         std::deque<distance_measurement_t> _filter_data;
         /**
@@ -216,6 +386,51 @@ class DistancePoint {
         distance_log_t _distance_log[log_size];
 };
 
+/**
+ * @brief Open addressing hash table from WiFi MAC address to point id
+ * 
+ * MACs are packed into 48-bit keys, so lookups of scan results do not format or compare strings.
+ */
+class MacTable{
+    public:
+        /**
+         * @brief Insert or replace id of @p mac
+         * 
+         * @param mac WiFi MAC address
+         * @param id id of the point
+         */
+        void insert(const uint8_t mac[6], uint32_t id);
+
+        /**
+         * @brief Find id of @p mac
+         * 
+         * @param mac WiFi MAC address
+         * @return uint32_t id of the point, UINT32_MAX if @p mac is not in the table
+         */
+        uint32_t find(const uint8_t mac[6]) const;
+
+        size_t size() const { return _count; }
+    private:
+        typedef struct{
+            uint64_t key; /**< packed MAC, @ref empty_key if the slot is free */
+            uint32_t id;
+        } entry_t;
+        static constexpr uint64_t empty_key = UINT64_MAX;
+
+        static uint64_t key(const uint8_t mac[6]);
+        /**
+         * @brief Slot of @p key or the free slot where it would be inserted
+         */
+        size_t slot(uint64_t key) const;
+        /**
+         * @brief Double the capacity and insert all entries again
+         */
+        void grow();
+
+        std::vector<entry_t> _entries; /**< slots, size is a power of 2 */
+        size_t _count = 0;
+};
+
 /**
  * @brief Manages measuring distances to instances of DistancePoint
  * 
@@ -224,6 +439,7 @@ class DistanceMeter{
     public:
         DistanceMeter(bool wifi_initialized, bool only_reachable = false);
         DistanceMeter(bool wifi_initialized, esp_event_loop_handle_t event_loop_handle, bool only_reachable = false);
+        ~DistanceMeter();
 
         /**
          * @brief Create DistancePoint that will be managed by DistanceMeter
@@ -252,10 +468,53 @@ class DistanceMeter{
          * @return std::shared_ptr<DistancePoint> return shared_ptr of the point or nullptr if point is not found
          */
         std::shared_ptr<DistancePoint> getPoint(uint32_t id);
+        /**
+         * @brief Get measurement of a point from its log, safe to call from any task
+         * 
+         * log of the point is updated in the event loop of DistanceMeter
+         * 
+         * @param id id of the Distance point
+         * @param measurement output
+         * @param offset from 0=latest to DistancePoint::log_size = oldest
+         * @return esp_err_t ESP_ERR_NOT_FOUND if point is not found, otherwise as DistancePoint::getDistanceFromLog()
+         */
+        esp_err_t getDistanceFromLog(uint32_t id, distance_log_t &measurement, size_t offset = 0);
+
+        /**
+         * @brief Measure distance to point out of schedule and wait for the result
+         * 
+         * session of the point is started before other queued sessions (after the running one),
+         * DM_MEASUREMENT_DONE is posted as for scheduled measurements. Must not be called from the event loop
+         * of DistanceMeter (results are processed there).
+         * 
+         * @param id id of the point
+         * @param measurement resulting measurement
+         * @return esp_err_t returns ESP_OK if succeeds, ESP_ERR_INVALID_STATE if other task is already waiting,
+         *                   ESP_ERR_TIMEOUT if the result did not come in time
+         */
+        esp_err_t measureDistance(uint32_t id, distance_measurement_t &measurement);
+
+        /**
+         * @brief Copy of FTM session and channel switch counters
+         */
+        dm_session_stats_t getSessionStats();
+
+        /**
+         * @brief Estimated time of one channel switch (from @ref dm_session_stats_t)
+         * 
+         * @param stats session counters
+         * @return int64_t mean excess of sessions with switch minus mean excess of sessions without it (us), 0 if unknown
+         */
+        static int64_t channelSwitchCost(const dm_session_stats_t &stats);
 
         /**
          * @brief Function that should be called periodically, measures distances and generates events
          * 
+         * Does not wait for measurements. When the previous round is finished, a new round of enabled points
+         * is planned in order of DistancePoint::priority() until the expected airtime reaches the budget
+         * (DISTANCE_METER_TICK_BUDGET_MS), remaining points wait for next rounds. FTM sessions of the round
+         * run one after another driven by WiFi events, results are posted as DM_MEASUREMENT_DONE.
+         * 
          * @param diff Time difference since last run
          */
         void tick(TickType_t diff);
@@ -300,19 +559,101 @@ class DistanceMeter{
         uint32_t _addPoint(const uint8_t mac[6], std::string macstr, uint8_t channel, uint32_t id);
 
         /**
-         * @brief Helper function that measures distance to given @p point , produces events
+         * @brief Register FTM event handlers and create session timer (called by constructors)
+         * 
+         * @return esp_err_t returns ESP_OK if succeeds
+         */
+        esp_err_t initSessions();
+
+        /**
+         * @brief Queue points in @ref _schedule from the highest priority until airtime budget is spent and start the round
+         * 
+         * queued points are grouped by channel (home or current channel first, then by the highest priority
+         * in the group), so every channel is tuned at most once per round. Time spent off home channel is limited by DISTANCE_METER_HOME_DWELL_MS.
+         */
+        void scheduleRound();
+
+        /**
+         * @brief Start session of next point in @ref _queue (called with @ref _mutex taken)
+         * 
+         * points whose session cannot be started are reported as failed (see postSessionResults())
+         */
+        void startNextSession();
+
+        /**
+         * @brief End active session with @p result, start the next one and queue the result for processing (called with @ref _mutex taken)
+         * 
+         * @param result result of the session (point id, duration and timestamp are filled in)
+         */
+        void finishSession(ftm_session_result_t &result);
+
+        /**
+         * @brief Post queued session results to @ref _event_loop_hdl for processing in measurementDone()
          * 
-         * @param point point to which the distance will be measured
-         * @return esp_err_t returns ESP_OK if the measurement is valid and event was posted
+         * Called after @ref _mutex is released, measurementDone() takes it too and would block the event loop
+         * while the post waits for space in its queue.
          */
-        esp_err_t measureDistance(std::shared_ptr<DistancePoint> point);
+        void postSessionResults();
 
         /**
-         * @brief Discover reachable points by performing WiFi Scan
+         * @brief Process session result and post DM_MEASUREMENT_DONE (runs in @ref _event_loop_hdl)
          * 
-         * @return std::vector<std::shared_ptr<DistancePoint>> reachable points that were found
+         * @param result result of the session
          */
-        std::vector<std::shared_ptr<DistancePoint>> reachablePoints();
+        void measurementDone(const ftm_session_result_t &result);
+
+        /**
+         * @brief Handles WIFI_EVENT_FTM_REPORT of active session (runs in default event loop)
+         */
+        static void ftmEventHandler(void* arg, esp_event_base_t event_base, 
+            int32_t event_id, void* event_data);
+
+        /**
+         * @brief Handles session results posted by postSessionResults()
+         */
+        static void sessionResultHandler(void* arg, esp_event_base_t event_base, 
+            int32_t event_id, void* event_data);
+
+        /**
+         * @brief Ends active session when it does not report in time (runs in esp_timer task)
+         */
+        static void sessionTimeoutCallback(void* arg);
+
+        /**
+         * @brief Start WiFi scan of channel with the oldest reachability information if it is due
+         * 
+         * Only channels of points are scanned, one channel per scan. Results are handled in scanDone().
+         * 
+         * @param now current time
+         * @return true if scan is running (FTM sessions have to wait until it is done)
+         */
+        bool refreshReachability(TickType_t now);
+
+        /**
+         * @brief Mark points found by finished scan as seen
+         * 
+         * Ignores scans that were not started by refreshReachability() (e.g. by wifi_connect), their records
+         * are left to their owner.
+         */
+        void scanDone();
+
+        /**
+         * @brief Abandon running scan if it did not finish in time
+         * 
+         * @param now current time
+         */
+        void checkScanTimeout(TickType_t now);
+
+        /**
+         * @brief Mark scan as finished and start session queued during the scan (called with @ref _mutex taken)
+         */
+        void endScan();
+
+        /**
+         * @brief Handles WIFI_EVENT_SCAN_DONE (runs in default event loop)
+         */
+        static void scanEventHandler(void* arg, esp_event_base_t event_base, 
+            int32_t event_id, void* event_data);
 
         /**
          * @brief Necessary wrapper for creating thread that performs object's method
@@ -335,7 +676,71 @@ class DistanceMeter{
          * @brief map for searching point id by WiFi MAC string
          */
         std::unordered_map<std::string, uint32_t> _points_mac_id;
+        /**
+         * @brief map for searching point id by binary WiFi MAC (used for scan results)
+         */
+        MacTable _points_mac;
+        typedef struct{
+            uint8_t channel;
+            bool scanned; /**< @ref last_scan is valid */
+            TickType_t last_scan; /**< time of the last scan of the channel */
+        } channel_scan_t;
+        /**
+         * @brief channels of points with time of their last scan (only_reachable mode)
+         */
+        std::vector<channel_scan_t> _scan_channels;
+        /**
+         * @brief buffer for scan results (kept to reuse allocation)
+         */
+        std::vector<wifi_ap_record_t> _ap_records;
+        bool _scanning = false; /**< scan started by refreshReachability() is running, guarded by @ref _mutex */
+        TickType_t _scan_start = 0; /**< time of start of the running scan */
+        esp_event_handler_instance_t _scan_handler = nullptr; /**< WIFI_EVENT_SCAN_DONE handler instance */
         esp_event_loop_handle_t _event_loop_hdl;
+        typedef struct{
+            float priority;
+            uint32_t duration_us; /**< expected duration of the measurement (read with @ref _mutex taken) */
+            std::shared_ptr<DistancePoint> point;
+        } scheduled_point_t;
+        /**
+         * @brief points considered for measurement in current tick (kept to reuse allocation)
+         */
+        std::vector<scheduled_point_t> _schedule;
+        typedef struct{
+            uint8_t channel;
+            float priority; /**< the highest priority of planned points on the channel */
+        } channel_priority_t;
+        /**
+         * @brief order of channel groups in current round (kept to reuse allocation)
+         */
+        std::vector<channel_priority_t> _channel_priority;
+        /**
+         * @brief guards FTM session state (@ref _queue, @ref _active and its timing)
+         */
+        SemaphoreHandle_t _mutex;
+        /**
+         * @brief points of current round waiting for their FTM session
+         */
+        std::deque<std::shared_ptr<DistancePoint>> _queue;
+        /**
+         * @brief finished sessions waiting for postSessionResults()
+         */
+        std::deque<ftm_session_result_t> _results;
+        /**
+         * @brief point of running FTM session (nullptr if no session is running)
+         */
+        std::shared_ptr<DistancePoint> _active;
+        int64_t _active_start_us = 0; /**< esp_timer time of start of active session */
+        int64_t _active_deadline_us = 0; /**< esp_timer time when active session times out */
+        esp_timer_handle_t _session_timer = nullptr; /**< one-shot timer of active session timeout */
+        esp_event_handler_instance_t _ftm_handler = nullptr; /**< WIFI_EVENT_FTM_REPORT handler instance */
+        uint8_t _channel = 0; /**< channel of the last started session (0 = no session yet) */
+        bool _active_switched = false; /**< active session was started on other channel than the previous one */
+        dm_session_stats_t _session_stats {}; /**< guarded by @ref _mutex */
+        TaskHandle_t _waiting_task = nullptr; /**< task waiting in measureDistance() */
+        uint32_t _waiting_point = UINT32_MAX; /**< point measured for @ref _waiting_task */
+        esp_err_t _waiting_err = ESP_FAIL; /**< result for @ref _waiting_task */
+        distance_measurement_t _waiting_measurement {}; /**< measurement for @ref _waiting_task */
         /**
          * @brief Time threshold for determining closest point
          */
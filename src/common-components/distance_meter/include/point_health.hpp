@@ -0,0 +1,102 @@
+/**
+ * @file point_health.hpp
+ * @author Daniel Kurek (daniel.kurek.dev@gmail.com)
+ * @brief Health of a distance point from results of its FTM sessions (backoff, dead, probation)
+ * @version 0.1
+ * @date 2024-05-20
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#ifndef POINT_HEALTH_H_
+#define POINT_HEALTH_H_
+
+#include <inttypes.h>
+#include "freertos/FreeRTOS.h"
+
+/**
+ * @brief Health of DistancePoint derived from results of its measurements
+ */
+typedef enum {
+    DM_POINT_ALIVE, /**< last measurement succeeded */
+    DM_POINT_BACKOFF, /**< failed recently, retried after exponential backoff */
+    DM_POINT_DEAD, /**< failed too many times in a row, re-probed only once per probe interval */
+    DM_POINT_PROBATION, /**< dead point answered a re-probe, becomes alive after more successes */
+} dm_point_health_t;
+
+typedef struct{
+    TickType_t backoff_base; /**< delay after the first failure, doubled by every next failure */
+    TickType_t backoff_max; /**< upper bound of backoff */
+    float jitter; /**< delays are randomized by this fraction so that failing points do not retry in lockstep */
+    uint8_t dead_failures; /**< consecutive failures after which point is dead */
+    TickType_t probe_interval; /**< dead point is re-probed once per this interval */
+    uint8_t probation_successes; /**< successes after re-probe needed to become alive again */
+} health_config_t;
+
+/**
+ * @brief Health state machine of one point
+ *
+ * ALIVE -> BACKOFF on failure (delay doubles with every failure up to backoff_max),
+ * -> DEAD after dead_failures consecutive failures (re-probed once per probe_interval),
+ * DEAD -> PROBATION on success, PROBATION -> ALIVE after probation_successes successes,
+ * PROBATION -> DEAD on failure. BACKOFF -> ALIVE on success.
+ */
+class PointHealth {
+    public:
+        /**
+         * @param config configuration, has to outlive this object
+         */
+        PointHealth(const health_config_t &config) : _config(&config) {}
+
+        /**
+         * @brief Update health, backoff and probation after a measurement
+         *
+         * @param success result of the measurement
+         * @param now time of the result
+         * @param random uniformly distributed random number (e.g. esp_random()) used for jitter of the delay
+         */
+        void update(bool success, TickType_t now, uint32_t random);
+
+        /**
+         * @brief Check if the point can be measured (backoff or probe interval after failures elapsed)
+         *
+         * @param now current time
+         * @return true if the point can be scheduled
+         */
+        bool isDue(TickType_t now) const { return _retry_delay == 0 || now - _last_failure >= _retry_delay; }
+
+        dm_point_health_t health() const { return _health; }
+
+        /**
+         * @brief Number of consecutive failed measurements
+         */
+        uint8_t failures() const { return _failures; }
+
+        /**
+         * @brief Time after the last failure when the point can be measured again (0 = immediately)
+         */
+        TickType_t retryDelay() const { return _retry_delay; }
+    private:
+        /**
+         * @brief Randomize @p delay by +-jitter
+         */
+        TickType_t jittered(TickType_t delay, uint32_t random) const;
+
+        /**
+         * @brief Delay after @p failures consecutive failures before the point is dead (without jitter)
+         */
+        TickType_t backoff(uint8_t failures) const;
+
+        const health_config_t *_config;
+        dm_point_health_t _health = DM_POINT_ALIVE;
+        uint8_t _failures = 0;
+        /**
+         * @brief successful measurements since the point left DM_POINT_DEAD
+         */
+        uint8_t _probation_successes = 0;
+        TickType_t _last_failure = 0;
+        TickType_t _retry_delay = 0;
+};
+
+#endif
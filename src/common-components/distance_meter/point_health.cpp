@@ -0,0 +1,55 @@
+/**
+ * @file point_health.cpp
+ * @author Daniel Kurek (daniel.kurek.dev@gmail.com)
+ * @brief Implementation of @ref point_health.hpp
+ * @version 0.1
+ * @date 2024-05-20
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#include "point_health.hpp"
+#include <stdint.h>
+#include <algorithm>
+
+TickType_t PointHealth::jittered(TickType_t delay, uint32_t random) const{
+    const float fraction = (float) random / UINT32_MAX; // 0..1
+    return delay * (1 - _config->jitter + 2 * _config->jitter * fraction);
+}
+
+TickType_t PointHealth::backoff(uint8_t failures) const{
+    const uint8_t doublings = std::min<uint8_t>(failures - 1, 31);
+    // compared before shifting, base << doublings would wrap around for long backoffs
+    if(_config->backoff_base > (_config->backoff_max >> doublings)){
+        return _config->backoff_max;
+    }
+    return _config->backoff_base << doublings;
+}
+
+void PointHealth::update(bool success, TickType_t now, uint32_t random){
+    if(success){
+        _failures = 0;
+        _retry_delay = 0;
+        if(_health == DM_POINT_DEAD){
+            _health = DM_POINT_PROBATION;
+            _probation_successes = 1;
+        } else if(_health == DM_POINT_PROBATION){
+            _probation_successes++;
+        }
+        if(_health != DM_POINT_PROBATION || _probation_successes >= _config->probation_successes){
+            _health = DM_POINT_ALIVE;
+        }
+        return;
+    }
+
+    _last_failure = now;
+    if(_failures < UINT8_MAX) _failures++;
+    if(_health == DM_POINT_DEAD || _health == DM_POINT_PROBATION || _failures >= _config->dead_failures){
+        // failure during probation means the point is still unreliable
+        _health = DM_POINT_DEAD;
+        _retry_delay = jittered(_config->probe_interval, random);
+    } else{
+        _health = DM_POINT_BACKOFF;
+        _retry_delay = jittered(backoff(_failures), random);
+    }
+}
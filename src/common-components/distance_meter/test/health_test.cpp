@@ -0,0 +1,206 @@
+/**
+ * @file health_test.cpp
+ * @author Daniel Kurek (daniel.kurek.dev@gmail.com)
+ * @brief PointHealth: backoff, dead points, re-probing and probation with FTM sessions that fail for chosen points
+ * @version 0.1
+ * @date 2024-05-20
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#include "test_utils.hpp"
+#include "point_health.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <set>
+#include <vector>
+
+using namespace dm_test;
+
+/**
+ * @brief Configuration used by DistancePoint (with default Kconfig)
+ */
+constexpr health_config_t health_config {
+    .backoff_base = pdMS_TO_TICKS(1000),
+    .backoff_max = pdMS_TO_TICKS(16000),
+    .jitter = 0.25,
+    .dead_failures = 6,
+    .probe_interval = pdMS_TO_TICKS(60000),
+    .probation_successes = 2,
+};
+
+/**
+ * @brief Period of DistanceMeter::tick() in the simulation
+ */
+constexpr TickType_t tick_period = pdMS_TO_TICKS(10);
+
+/**
+ * @brief Source of FTM session results, sessions with dropped points fail
+ */
+struct fake_ftm_t{
+    std::set<size_t> dropped;
+
+    bool session(size_t point) const { return !dropped.contains(point); }
+};
+
+/**
+ * @brief Health of a point and its measurement attempts
+ */
+struct point_t{
+    PointHealth health {health_config};
+    std::vector<TickType_t> attempts;
+    std::vector<dm_point_health_t> states; /**< health after each attempt */
+};
+
+/**
+ * @brief Every tick, measure all due points (as DistanceMeter::tick() without budget) until @p end
+ */
+static void run(std::vector<point_t>& points, const fake_ftm_t& ftm, std::mt19937& rng, TickType_t& now, TickType_t end){
+    for(; now < end; now += tick_period){
+        for(size_t i = 0; i < points.size(); i++){
+            if(!points[i].health.isDue(now)) continue;
+            points[i].health.update(ftm.session(i), now, rng());
+            points[i].attempts.push_back(now);
+            points[i].states.push_back(points[i].health.health());
+        }
+    }
+}
+
+/**
+ * @brief Check that @p interval is @p delay within jitter (and the tick of the scheduler)
+ */
+static bool jittered(TickType_t interval, TickType_t delay){
+    return interval >= delay * (1 - health_config.jitter) && interval <= delay * (1 + health_config.jitter) + tick_period;
+}
+
+/**
+ * @brief Dropped point backs off with doubling delays, dies after dead_failures and is re-probed once per probe interval
+ */
+static void test_backoff(){
+    std::mt19937 rng(1);
+    std::vector<point_t> points(3);
+    fake_ftm_t ftm;
+    ftm.dropped = {1};
+    TickType_t now = 0;
+    run(points, ftm, rng, now, pdMS_TO_TICKS(40000));
+
+    // others are not affected
+    for(size_t i : {0, 2}){
+        CHECK(points[i].attempts.size() == pdMS_TO_TICKS(40000) / tick_period);
+        CHECK(points[i].health.health() == DM_POINT_ALIVE);
+    }
+
+    const point_t& dropped = points[1];
+    CHECK(dropped.attempts.size() == health_config.dead_failures);
+    if(dropped.attempts.size() != health_config.dead_failures){
+        return;
+    }
+    CHECK(dropped.attempts[0] == 0);
+    for(size_t i = 0; i + 1 < health_config.dead_failures; i++){
+        CHECK(dropped.states[i] == DM_POINT_BACKOFF);
+        CHECK(jittered(dropped.attempts[i+1] - dropped.attempts[i], health_config.backoff_base << i));
+    }
+    CHECK(dropped.states.back() == DM_POINT_DEAD);
+    CHECK(dropped.health.failures() == health_config.dead_failures);
+
+    // dead point is probed once per probe interval
+    run(points, ftm, rng, now, pdMS_TO_TICKS(300000));
+    CHECK(dropped.attempts.size() >= health_config.dead_failures + 3);
+    for(size_t i = health_config.dead_failures; i < dropped.attempts.size(); i++){
+        CHECK(dropped.states[i] == DM_POINT_DEAD);
+        CHECK(jittered(dropped.attempts[i] - dropped.attempts[i-1], health_config.probe_interval));
+    }
+}
+
+/**
+ * @brief Re-probed point is on probation, 2 successes make it alive, a failure makes it dead again
+ */
+static void test_probation(){
+    std::mt19937 rng(2);
+    std::vector<point_t> points(1);
+    fake_ftm_t ftm;
+    ftm.dropped = {0};
+    TickType_t now = 0;
+    run(points, ftm, rng, now, pdMS_TO_TICKS(40000));
+    point_t& point = points[0];
+    CHECK(point.health.health() == DM_POINT_DEAD);
+
+    // answers the probe, fails right after it
+    ftm.dropped.clear();
+    size_t probe = point.attempts.size();
+    while(point.attempts.size() == probe){
+        run(points, ftm, rng, now, now + tick_period);
+    }
+    CHECK(point.states[probe] == DM_POINT_PROBATION);
+    CHECK(point.health.isDue(now));
+    ftm.dropped = {0};
+    run(points, ftm, rng, now, now + tick_period);
+    CHECK(point.attempts.size() == probe + 2);
+    CHECK(point.states.back() == DM_POINT_DEAD);
+    CHECK(!point.health.isDue(now));
+    CHECK(point.health.retryDelay() >= health_config.probe_interval * (1 - health_config.jitter));
+
+    // answers the next probe and the next session
+    ftm.dropped.clear();
+    probe = point.attempts.size();
+    while(point.attempts.size() == probe){
+        run(points, ftm, rng, now, now + tick_period);
+    }
+    CHECK(jittered(point.attempts[probe] - point.attempts[probe-1], health_config.probe_interval));
+    CHECK(point.states[probe] == DM_POINT_PROBATION);
+    run(points, ftm, rng, now, now + tick_period);
+    CHECK(point.attempts.size() == probe + 2);
+    CHECK(point.states.back() == DM_POINT_ALIVE);
+    CHECK(point.health.failures() == 0);
+
+    // alive point backs off from the base delay again
+    ftm.dropped = {0};
+    run(points, ftm, rng, now, now + tick_period);
+    CHECK(point.states.back() == DM_POINT_BACKOFF);
+    CHECK(jittered(point.health.retryDelay(), health_config.backoff_base));
+}
+
+/**
+ * @brief Backoff stays at backoff_max however many failures there were, also when base << failures does not fit TickType_t
+ */
+static void test_backoff_limit(){
+    std::mt19937 rng(3);
+    // 65537 << 16 wraps around to 65536 in 32 bits
+    for(TickType_t base : {pdMS_TO_TICKS(1000), pdMS_TO_TICKS(65537), pdMS_TO_TICKS(600000)}){
+        const health_config_t config {
+            .backoff_base = base,
+            .backoff_max = pdMS_TO_TICKS(600000),
+            .jitter = 0.25,
+            .dead_failures = 255,
+            .probe_interval = pdMS_TO_TICKS(3600000),
+            .probation_successes = 2,
+        };
+        PointHealth health(config);
+        TickType_t now = 0;
+        for(uint32_t failures = 1; failures < config.dead_failures; failures++){
+            health.update(false, now, rng());
+            CHECK(health.health() == DM_POINT_BACKOFF);
+            const uint64_t expected = std::min<uint64_t>((uint64_t) base << std::min<uint32_t>(failures - 1, 40), config.backoff_max);
+            CHECK(health.retryDelay() >= expected * (1 - config.jitter) && health.retryDelay() <= expected * (1 + config.jitter));
+            now += health.retryDelay();
+            CHECK(health.isDue(now));
+        }
+        health.update(false, now, rng());
+        CHECK(health.health() == DM_POINT_DEAD);
+    }
+
+    // bounds of jitter
+    PointHealth health(health_config);
+    health.update(false, 0, 0);
+    CHECK(health.retryDelay() == health_config.backoff_base * 3 / 4);
+    health.update(false, 0, UINT32_MAX);
+    CHECK(health.retryDelay() == health_config.backoff_base * 2 * 5 / 4);
+}
+
+int main(){
+    test_backoff();
+    test_probation();
+    test_backoff_limit();
+    return result("health_test");
+}
@@ -0,0 +1,20 @@
+/**
+ * @file FreeRTOS.h
+ * @author Daniel Kurek (daniel.kurek.dev@gmail.com)
+ * @brief Tick type of FreeRTOS on ESP32 for host tests (ticks are milliseconds)
+ * @version 0.1
+ * @date 2024-05-20
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#ifndef HOST_FREERTOS_H_
+#define HOST_FREERTOS_H_
+
+#include <stdint.h>
+
+typedef uint32_t TickType_t;
+
+#define pdMS_TO_TICKS(ms) ((TickType_t) (ms))
+
+#endif
@@ -0,0 +1,39 @@
+/**
+ * @file test_utils.hpp
+ * @author Daniel Kurek (daniel.kurek.dev@gmail.com)
+ * @brief Minimal checks shared by host tests of distance_meter
+ * @version 0.1
+ * @date 2024-05-20
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#ifndef DM_TEST_UTILS_HPP_
+#define DM_TEST_UTILS_HPP_
+
+#include <cstdio>
+
+namespace dm_test {
+    inline int failures = 0;
+
+    /**
+     * @brief Exit code of the test, summary is printed
+     */
+    inline int result(const char *name){
+        if(failures > 0){
+            std::printf("%s: %d check(s) FAILED\n", name, failures);
+            return 1;
+        }
+        std::printf("%s: OK\n", name);
+        return 0;
+    }
+}
+
+#define CHECK(cond) do { \
+        if(!(cond)){ \
+            std::printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            dm_test::failures++; \
+        } \
+    } while(0)
+
+#endif
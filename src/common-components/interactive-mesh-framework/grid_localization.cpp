@@ -0,0 +1,163 @@
+/**
+ * @file grid_localization.cpp
+ * @author Daniel Kurek (daniel.kurek.dev@gmail.com)
+ * @brief Implementation of @ref grid_localization.hpp
+ * @version 0.1
+ * @date 2024-05-06
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "grid_localization.hpp"
+#include "mlat_localization.hpp"
+#include "logger.h"
+#include <cmath>
+#include <algorithm>
+#include <limits>
+
+using namespace imf;
+using namespace mlat;
+
+static const char* TAG = "GRID_LOC";
+
+constexpr float distance_scale = 1.0/100.0; // cm to m
+
+constexpr int pos_scale = 100;
+
+constexpr uint16_t unknown_uncertainty = std::numeric_limits<uint16_t>::max();
+
+constexpr grid_config_t grid_config {
+    .cell_size = CONFIG_IMF_GRID_CELL_SIZE_CM * distance_scale,
+    .coarse_factor = 4,
+    .margin = 5.0,
+    .distance_sigma = CONFIG_IMF_MLAT_DISTANCE_SIGMA_CM * distance_scale,
+    .outlier_distance = CONFIG_IMF_MLAT_ROBUST_INLIER_THRESHOLD_CM * distance_scale,
+    .max_entries = CONFIG_IMF_GRID_MAX_TABLE_KB * 1024 / sizeof(uint16_t),
+};
+
+GridLocalization::GridLocalization(std::shared_ptr<Device> this_device, std::vector<std::shared_ptr<Device>> stations)
+    : _this_device(this_device), _stations(stations), _grid(grid_config), _publisher(this_device){
+    location_local_t unknown{0,0,0,0,0};
+    unknown.uncertainty = unknown_uncertainty;
+    _grid_locations.assign(_stations.size(), unknown);
+    _grid_index.assign(_stations.size(), -1);
+    _positions.reserve(_stations.size());
+    _distances.reserve(_stations.size());
+    // distance events of every station fit, so notify() does not allocate in the event loop
+    _trigger.reserve(_stations.size());
+}
+
+bool GridLocalization::start(){
+    auto ret = xTaskCreatePinnedToCore(taskWrapper, "GridLocalization", 1024*8, this, tskIDLE_PRIORITY+2, &_xHandle, 1);
+    if(ret != pdPASS){
+        ESP_LOGE(TAG, "Could not create Location task");
+        return false;
+    }
+    return true;
+}
+
+void GridLocalization::stop(){
+    if(_xHandle != NULL){
+        vTaskDelete(_xHandle);
+        _xHandle = NULL;
+    }
+}
+
+bool GridLocalization::updateGrid(){
+    const uint32_t version = Device::stationLocationVersion();
+    if(_grid_complete && version == _grid_version){
+        return _grid.built();
+    }
+    _grid_version = version;
+    _grid_complete = true;
+    bool changed = false;
+    for(size_t i = 0; i < _stations.size(); i++){
+        location_local_t location;
+        if(_stations[i]->getLocation(location) != ESP_OK || location.uncertainty >= std::numeric_limits<uint16_t>::max()/2){
+            location = {0,0,0,0,0};
+            location.uncertainty = unknown_uncertainty;
+            _grid_complete = false;
+        }
+        location_local_t& used = _grid_locations[i];
+        const bool known = location.uncertainty != unknown_uncertainty;
+        const bool used_known = used.uncertainty != unknown_uncertainty;
+        // only position matters for distance table, not its uncertainty
+        if(known != used_known || location.local_north != used.local_north || location.local_east != used.local_east){
+            used = location;
+            changed = true;
+        }
+    }
+    if(!changed){
+        return _grid.built();
+    }
+
+    _positions.clear();
+    for(size_t i = 0; i < _stations.size(); i++){
+        if(_grid_locations[i].uncertainty == unknown_uncertainty){
+            _grid_index[i] = -1;
+            continue;
+        }
+        _grid_index[i] = _positions.size();
+        position_t pos;
+        MlatLocalization::locationToPos(_grid_locations[i], pos.x, pos.y);
+        _positions.push_back(pos);
+    }
+    if(!_grid.build(_positions)){
+        LOGGER_I(TAG, "grid not built, %d stations with location (at most %d)", _positions.size(), LikelihoodGrid::max_stations);
+        return false;
+    }
+    LOGGER_I(TAG, "grid built for %d stations, %dx%d cells of %f m", _positions.size(), _grid.cols(), _grid.rows(), _grid.cell_size());
+    return true;
+}
+
+void GridLocalization::tick(TickType_t diff){
+    if(!updateGrid()){
+        TICK_LOG(TAG, "no station locations");
+        return;
+    }
+    _distances.clear();
+    for(size_t i = 0; i < _stations.size(); i++){
+        distance_log_t dist_log;
+        if(_grid_index[i] < 0){
+            continue;
+        }
+        if(_stations[i]->lastDistance(dist_log) != ESP_OK){
+            TICK_LOG(TAG, "skip id %" PRIu32 ", no distance", _stations[i]->id);
+            continue;
+        }
+        TICK_LOG(TAG, "id %" PRIu32 " distance %" PRIu32, _stations[i]->id, dist_log.measurement.distance_cm);
+        _distances.push_back({(uint16_t)_grid_index[i], (float)dist_log.measurement.distance_cm * distance_scale});
+    }
+
+    track_t estimate = _grid.locate(_distances);
+    if(!estimate.valid){
+        TICK_LOG(TAG, "no distances");
+        return;
+    }
+    TICK_LOG(TAG, "resulting pos x=%f,y=%f (%d distances)", estimate.pos.x, estimate.pos.y, _distances.size());
+
+    location_local_t new_location{0,0,0,0,0};
+    // altitude and floor are not estimated, keep the last ones
+    _this_device->getLocation(new_location);
+    MlatLocalization::posToLocation(estimate.pos.x, estimate.pos.y, new_location);
+    const float uncertainty = std::sqrt(std::max(estimate.covariance.xx + estimate.covariance.yy, 0.0f)) * pos_scale;
+    new_location.uncertainty = (uint16_t) std::min(uncertainty, (float) std::numeric_limits<uint16_t>::max());
+    _publisher.publish(new_location);
+}
+
+void GridLocalization::distanceUpdated(uint32_t station_id, const distance_measurement_t &measurement){
+    _trigger.notify(station_id);
+}
+
+void GridLocalization::task(){
+    TickType_t last_tick = xTaskGetTickCount();
+    while(true){
+        // sleep until enough stations have new distances (or idle timeout)
+        _trigger.wait(last_tick);
+        const TickType_t now = xTaskGetTickCount();
+        tick(now - last_tick);
+        last_tick = now;
+    }
+    vTaskDelete(_xHandle);
+}
@@ -0,0 +1,88 @@
+#ifndef GRID_LOCALIZATION_H_
+#define GRID_LOCALIZATION_H_
+
+#include <inttypes.h>
+#include <vector>
+#include <unordered_map>
+#include <memory>
+#include "location_defs.h"
+#include "esp_err.h"
+#include "freertos/semphr.h"
+
+#include "imf-device.hpp"
+#include "localization.hpp"
+#include "localization_trigger.hpp"
+#include "location_publisher.hpp"
+#include "mlat.hpp"
+#include "likelihood_grid.hpp"
+
+namespace imf{
+    /**
+     * @brief Localization using precomputed likelihood grid (mlat::LikelihoodGrid)
+     *
+     * Distances from venue grid cells to stations are computed when station locations are known
+     * (and again when they change). Each tick then only scores grid cells by the last distances.
+     */
+    class GridLocalization : public Localization{
+        public:
+            /**
+             * @brief Construct a new Grid Localization object
+             *
+             * @param this_device local device
+             * @param stations all possible stations which can be used as anchors
+             */
+            GridLocalization(std::shared_ptr<imf::Device> this_device, std::vector<std::shared_ptr<imf::Device>> stations);
+            /**
+             * @copydoc Localization::start
+             */
+            bool start();
+            /**
+             * @copydoc Localization::stop
+             */
+            void stop();
+            /**
+             * @copydoc Localization::tick
+             */
+            void tick(TickType_t diff);
+            /**
+             * @copydoc Localization::distanceUpdated
+             *
+             * Wakes localization task when enough stations have new distances.
+             */
+            void distanceUpdated(uint32_t station_id, const distance_measurement_t &measurement);
+        private:
+            std::shared_ptr<imf::Device> _this_device;
+            std::vector<std::shared_ptr<imf::Device>> _stations;
+            std::vector<location_local_t> _grid_locations; /**< station locations used to build @ref _grid (uncertainty is max if unknown) */
+            uint32_t _grid_version = 0; /**< Device::stationLocationVersion() of @ref _grid_locations */
+            bool _grid_complete = false; /**< all station locations in @ref _grid_locations are known */
+            std::vector<int32_t> _grid_index; /**< index of each station in @ref _grid, -1 if the station is not in grid */
+            std::vector<mlat::position_t> _positions; /**< positions of stations in @ref _grid */
+            std::vector<mlat::grid_distance_t> _distances; /**< distances of current tick (reused to avoid allocations) */
+            mlat::LikelihoodGrid _grid;
+            TaskHandle_t _xHandle = NULL;
+            LocalizationTrigger _trigger; /**< wakes task() when new distances arrive */
+            LocationPublisher _publisher; /**< limits how often location of @ref _this_device is sent to the network */
+
+            /**
+             * @brief Rebuild grid if any station location changed since last build
+             *
+             * @return true if grid can be used
+             */
+            bool updateGrid();
+
+            /**
+             * @brief Task for continuous localization
+             */
+            void task();
+
+            /**
+             * @brief Necessary wrapper for creating thread that performs object's method
+             * @param param pointer to GridLocalization (usually @p this )
+             */
+            static void taskWrapper(void* param){
+                static_cast<GridLocalization *>(param)->task();
+            }
+    };
+}
+#endif
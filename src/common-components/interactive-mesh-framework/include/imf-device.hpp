@@ -15,7 +15,9 @@
 #include <string>
 #include "location_defs.h"
 #include <cstdint>
+#include <atomic>
 #include "nvs_flash.h"
+#include "freertos/semphr.h"
 
 #include "color/color.h"
 #include "distance_meter.hpp"
@@ -71,11 +73,29 @@ namespace imf{
             /**
              * @brief Get device's Location
              * 
+             * Location is requested over serial only until it is known, then it is returned from memory
+             * (it is updated by locationChanged()).
+             * 
              * @param[out] location_out location of the device, only valid if ESP_OK is returned
              * @return esp_err_t ESP_OK if location value is known and is valid
              */
             esp_err_t getLocation(location_local_t &location_out);
 
+            /**
+             * @brief Update cached location from serial notification of "loc" field
+             * 
+             * @param loc_value new value of "loc" field
+             * @return esp_err_t ESP_OK if value was parsed
+             */
+            esp_err_t locationChanged(const std::string &loc_value);
+
+            /**
+             * @brief Version of cached station locations, incremented when location of any station changes
+             * 
+             * Allows localization to keep its own copy of station locations and refresh it only when needed.
+             */
+            static uint32_t stationLocationVersion() { return _station_location_version.load(); }
+
             /**
              * @brief Set device's Level
              * 
@@ -108,6 +128,22 @@ namespace imf{
              */
             esp_err_t lastDistance(distance_log_t &distance_log);
 
+            /**
+             * @brief Enable or disable periodic distance measurement to this device
+             * 
+             * @param enabled false to stop measuring (e.g. device is known to be unreachable)
+             * @return esp_err_t ESP_OK if the device has distance point
+             */
+            esp_err_t setDistanceMeasurement(bool enabled);
+
+            /**
+             * @brief Set how useful distance to this device is for localization (scales its measurement priority)
+             * 
+             * @param usefulness from 0 (not useful) to 1 (used in the last position fix)
+             * @return esp_err_t ESP_OK if the device has distance point
+             */
+            esp_err_t setDistanceUsefulness(float usefulness);
+
             const uint32_t id; /**< device id */
             const DeviceType type; /**< device type */
             const uint16_t ble_mesh_addr; /**< Bluetooth mesh address */
@@ -184,7 +220,19 @@ namespace imf{
              * @return std::string MAC address in string format ("xx:xx:xx:xx:xx:xx") or empty string
              */
             static std::string _getMAC();
+
+            /**
+             * @brief Store location to cache and increment @ref _station_location_version if location of station changed
+             * 
+             * @param location new location
+             */
+            void _cacheLocation(const location_local_t &location);
+
             bool _local_commands; /**< omit address when sending serial commands */
+            SemaphoreHandle_t _location_mutex; /**< synchronizes access to @ref _location */
+            location_local_t _location = {0,0,0,0,0}; /**< cached location, only valid if @ref _location_known */
+            bool _location_known = false; /**< location was received at least once */
+            static std::atomic<uint32_t> _station_location_version; /**< incremented on every change of cached station location */
             std::shared_ptr<DistancePoint> _point; /**< DistancePoint instance of this device*/
             static std::shared_ptr<com::SerialCommCli> _serial; /**< @ref SerialComm used to communicate with Bluetooth mesh module*/
             static std::shared_ptr<DistanceMeter> _dm; /**< @ref DistanceMeter used for managing _point */
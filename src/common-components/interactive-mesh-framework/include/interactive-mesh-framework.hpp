@@ -22,6 +22,7 @@
 
 #include "imf-device.hpp"
 #include "localization.hpp"
+#include "station_survey.hpp"
 
 namespace imf{
     /**
@@ -186,6 +187,14 @@ namespace imf{
              * @brief Stop continuous localization 
              */
             void stopLocalization();
+
+            /**
+             * @brief Get timing and counters of localization (also served as JSON by web config on /api/v1/status)
+             * 
+             * @param[out] stats copy of localization statistics
+             * @return esp_err_t ESP_OK if stats were copied, ESP_ERR_NOT_SUPPORTED if localization does not collect them
+             */
+            esp_err_t getLocalizationStats(localization_stats_t &stats);
             
             /**
              * @brief Get constant iterator over added devices
@@ -242,6 +251,41 @@ namespace imf{
              * @brief Initialize localization (needs to called after all devices are added)
              */
             void _init_localization();
+
+            /**
+             * @brief Forward distance measurements from DistanceMeter to localization
+             * 
+             * @param handler_args pointer to IMF instance
+             */
+            static void _dm_event_handler(void* handler_args, esp_event_base_t base, int32_t id, void* event_data);
+
+            /**
+             * @brief Update cached location of the device whose "loc" field changed
+             * 
+             * @param handler_args pointer to IMF instance
+             * @param field changed field (with address of the device, or without it for local device)
+             * @param value new location
+             */
+            static void _loc_field_handler(void *handler_args, const std::string& field, const std::string& value);
+
+            /**
+             * @brief Pass row of station distance matrix to @ref _survey
+             * 
+             * @param handler_args pointer to IMF instance
+             * @param field changed field (with address of the station that measured the distances)
+             * @param value encoded row
+             */
+            static void _dist_field_handler(void *handler_args, const std::string& field, const std::string& value);
+
+            /**
+             * @brief Status of the application for web config (localization statistics)
+             * 
+             * @param ctx pointer to IMF instance
+             * @param buf output buffer
+             * @param buf_size size of @p buf
+             * @return int length of JSON, negative on error
+             */
+            static int _web_status(void *ctx, char *buf, size_t buf_size);
             std::shared_ptr<DistanceMeter> _dm; /**< DistanceMeter for measuring distances to devices */
             std::vector<config_option_t> _options; /**< added options to @ref web_config.h*/
             esp_event_loop_handle_t _event_loop_hdl; /**< separate event loop for DistanceMeter */
@@ -253,6 +297,7 @@ namespace imf{
             uint32_t _next_id = 1; 
             nvs_handle_t _options_handle; /** NVS handle for web_config settings */
             std::shared_ptr<Localization> _localization; /** Localization module */
+            std::shared_ptr<StationSurvey> _survey; /** Cooperative survey of station locations (only on stations) */
             int16_t current_state = 0; /** Current application state*/
             TaskHandle_t _xUpdateHandle; /** handle for UpdateTask thread*/
     };
@@ -12,6 +12,19 @@
 #define LOCALIZATION_HPP_
 
 #include "freertos/FreeRTOS.h"
+#include "esp_err.h"
+#include "distance_meter.hpp"
+#include "localization_stats.hpp"
+#include "logger.h"
+
+/**
+ * @brief Per-tick details (anchors, intermediate positions) are logged only when enabled, LocalizationStats logs a summary
+ */
+#if CONFIG_IMF_MLAT_TICK_LOG
+#define TICK_LOG(tag, format, ...) LOGGER_I(tag, format, ##__VA_ARGS__)
+#else
+#define TICK_LOG(tag, format, ...) LOGGER_D(tag, format, ##__VA_ARGS__)
+#endif
 
 namespace imf{
     class Localization{
@@ -34,6 +47,22 @@ namespace imf{
              * @param diff time difference since last run
              */
             virtual void tick(TickType_t diff) = 0;
+
+            /**
+             * @brief Notify localization about new distance measurement (called from event loop of DistanceMeter)
+             * 
+             * @param station_id id of the station that the distance was measured to
+             * @param measurement new distance measurement
+             */
+            virtual void distanceUpdated(uint32_t station_id, const distance_measurement_t &measurement) {}
+
+            /**
+             * @brief Get timing and counters of localization ticks
+             * 
+             * @param[out] stats copy of statistics
+             * @return esp_err_t ESP_OK if stats were copied, ESP_ERR_NOT_SUPPORTED if localization does not collect them
+             */
+            virtual esp_err_t getStats(localization_stats_t &stats) { return ESP_ERR_NOT_SUPPORTED; }
     };
 }
 
@@ -0,0 +1,137 @@
+/**
+ * @file localization_stats.hpp
+ * @author Daniel Kurek (daniel.kurek.dev@gmail.com)
+ * @brief Counters and timing of localization ticks
+ * @version 0.1
+ * @date 2024-05-18
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#ifndef LOCALIZATION_STATS_HPP_
+#define LOCALIZATION_STATS_HPP_
+
+#include <inttypes.h>
+#include <cstddef>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+namespace imf{
+    /**
+     * @brief How position was determined in a tick
+     */
+    enum class LocalizationBranch : uint8_t{
+        Multilateration = 0, /**< 3 or more anchors */
+        TwoAnchors, /**< mirror position resolved by track */
+        OneAnchor, /**< point of circle closest to track */
+        Predicted, /**< no anchors, position predicted from track */
+        NoFix, /**< no anchors and no track */
+    };
+    constexpr size_t localization_branch_count = 5;
+
+    /**
+     * @brief Why a station was not used as anchor in a tick
+     */
+    enum class SkipReason : uint8_t{
+        NoLocation = 0, /**< location of the station is not known */
+        HighUncertainty, /**< location of the station is too uncertain */
+        OtherFloor, /**< station is on a non-adjacent floor */
+        NoDistance, /**< station was never measured */
+        TooOld, /**< distance is older than aging horizon */
+        OutOfRange, /**< station is outside of search radius */
+        Unselected, /**< not selected for its geometry */
+        Outlier, /**< distance rejected as inconsistent with others */
+    };
+    constexpr size_t skip_reason_count = 8;
+
+    /**
+     * @brief Upper edges of residual histogram bins (cm), the last bin counts larger residuals
+     */
+    constexpr uint16_t residual_bin_edges_cm[] = {10, 25, 50, 100, 200, 400, 800};
+    constexpr size_t residual_bin_count = sizeof(residual_bin_edges_cm) / sizeof(residual_bin_edges_cm[0]) + 1;
+
+    typedef struct{
+        uint32_t ticks; /**< number of finished ticks */
+        uint32_t last_us; /**< duration of the last tick */
+        uint32_t max_us; /**< longest tick */
+        uint64_t total_us; /**< sum of tick durations (mean is total_us / ticks) */
+        uint32_t anchors_last; /**< anchors used in the last tick */
+        uint64_t anchors_total; /**< sum of anchors used in all ticks */
+        uint32_t branches[localization_branch_count]; /**< ticks per @ref LocalizationBranch */
+        uint32_t skipped[skip_reason_count]; /**< skipped stations per @ref SkipReason */
+        uint32_t residuals[residual_bin_count]; /**< histogram of RMS distance residuals of multilateration */
+    } localization_stats_t;
+
+    /**
+     * @brief Lightweight statistics of localization ticks
+     *
+     * begin(), skip(), residual() and end() are called only from the localization task and update
+     * counters of the current tick without locking. end() merges them into totals under a mutex, so
+     * stats() can be read from other tasks (web interface, application). A one line summary is logged
+     * once per IMF_LOCALIZATION_STATS_INTERVAL_MS instead of per-tick details.
+     */
+    class LocalizationStats{
+        public:
+            /**
+             * @brief Construct a new Localization Stats object
+             *
+             * @param tag log tag of the summary
+             */
+            LocalizationStats(const char *tag);
+            ~LocalizationStats();
+
+            /**
+             * @brief Start timing of a tick
+             */
+            void begin();
+
+            /**
+             * @brief Count skipped station(s) in current tick
+             */
+            void skip(SkipReason reason, uint32_t count = 1) { _current.skipped[(size_t)reason] += count; }
+
+            /**
+             * @brief Add RMS distance residual of multilateration in current tick
+             *
+             * @param residual residual (m)
+             */
+            void residual(float residual);
+
+            /**
+             * @brief Finish timing of a tick and merge its counters into totals
+             *
+             * @param branch how the position was determined
+             * @param anchors number of used anchors
+             */
+            void end(LocalizationBranch branch, size_t anchors);
+
+            /**
+             * @brief Copy of totals
+             */
+            localization_stats_t stats();
+
+            /**
+             * @brief Clear totals
+             */
+            void reset();
+
+            /**
+             * @brief Format stats as JSON object
+             *
+             * @param stats formatted stats
+             * @param buf output buffer
+             * @param buf_size size of @p buf
+             * @return int length of the JSON (as snprintf), negative on error
+             */
+            static int toJson(const localization_stats_t &stats, char *buf, size_t buf_size);
+        private:
+            const char *_tag;
+            SemaphoreHandle_t _mutex; /**< guards @ref _total */
+            localization_stats_t _current; /**< counters of current tick (localization task only) */
+            localization_stats_t _total;
+            int64_t _begin_us = 0; /**< esp_timer time of begin() */
+            TickType_t _last_report = 0; /**< time of the last logged summary */
+    };
+}
+
+#endif
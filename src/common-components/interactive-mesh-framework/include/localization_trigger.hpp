@@ -0,0 +1,98 @@
+/**
+ * @file localization_trigger.hpp
+ * @author Daniel Kurek (daniel.kurek.dev@gmail.com)
+ * @brief Wakes localization task when new distances arrive
+ * @version 0.1
+ * @date 2024-05-08
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#ifndef LOCALIZATION_TRIGGER_HPP_
+#define LOCALIZATION_TRIGGER_HPP_
+
+#include <inttypes.h>
+#include <cstddef>
+#include <vector>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+
+namespace imf{
+    typedef struct{
+        TickType_t window; /**< distances arriving within this time after the first one are processed together */
+        TickType_t idle_timeout; /**< localization runs at least once per this time even without new distances */
+        uint8_t min_changes; /**< number of stations with new distance needed to run localization before @ref idle_timeout */
+    } trigger_config_t;
+
+    /**
+     * @brief Event-driven trigger of localization task
+     *
+     * DistanceMeter posts DM_MEASUREMENT_DONE for each distance. Localization forwards these by notify()
+     * and its task blocks in wait() instead of polling, so the position is recomputed shortly after
+     * enough stations were measured and not at all while nothing changes.
+     */
+    class LocalizationTrigger{
+        public:
+            /**
+             * @brief Construct a new Localization Trigger object
+             *
+             * @param config coalescing window and thresholds
+             */
+            LocalizationTrigger(const trigger_config_t &config);
+            /**
+             * @brief Construct a new Localization Trigger object configured by Kconfig (IMF_LOCALIZATION_*)
+             */
+            LocalizationTrigger();
+            ~LocalizationTrigger();
+
+            /**
+             * @brief Reserve space for changes of all stations, so that notify() does not allocate
+             *
+             * @param stations number of stations that can report distances
+             */
+            void reserve(size_t stations);
+
+            /**
+             * @brief Record new distance of the station and wake waiting task (called from event loop of DistanceMeter)
+             *
+             * @param station_id id of the station that the distance was measured to
+             */
+            void notify(uint32_t station_id);
+
+            /**
+             * @brief Wake task blocked in wait() without waiting for the coalescing window (e.g. for incremental update)
+             */
+            void wake();
+
+            /**
+             * @brief Block calling task until localization should run
+             *
+             * Returns when at least @ref trigger_config_t::min_changes stations have new distances and
+             * @ref trigger_config_t::window elapsed since the first of them, or when
+             * @ref trigger_config_t::idle_timeout elapsed since @p last_run.
+             *
+             * @param last_run tick count of the last localization run
+             * @return size_t number of stations with new distance since the last wait()
+             */
+            size_t wait(TickType_t last_run);
+
+            /**
+             * @brief Block calling task until localization should run or wake() was called
+             *
+             * @param last_run tick count of the last localization run
+             * @param[out] woken true if returned because of wake(), localization should not run yet (changes are kept)
+             * @return size_t number of stations with new distance since the last wait(), 0 if @p woken
+             */
+            size_t wait(TickType_t last_run, bool &woken);
+        private:
+            trigger_config_t _config;
+            SemaphoreHandle_t _mutex; /**< synchronizes notify() and wait() */
+            TaskHandle_t _task = NULL; /**< task blocked in wait() */
+            std::vector<uint32_t> _changed; /**< ids of stations with new distance */
+            TickType_t _first_change = 0; /**< tick count of the first change in @ref _changed */
+            bool _woken = false; /**< wake() was called since the last wait() */
+    };
+}
+
+#endif
@@ -0,0 +1,89 @@
+/**
+ * @file location_publisher.hpp
+ * @author Daniel Kurek (daniel.kurek.dev@gmail.com)
+ * @brief Deadband and rate limiting of published location
+ * @version 0.1
+ * @date 2024-05-10
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#ifndef LOCATION_PUBLISHER_HPP_
+#define LOCATION_PUBLISHER_HPP_
+
+#include <inttypes.h>
+#include <memory>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_err.h"
+#include "location_defs.h"
+#include "imf-device.hpp"
+
+namespace imf{
+    typedef struct{
+        uint16_t min_distance_cm; /**< smaller movement is not published (deadband) */
+        uint16_t min_uncertainty_change_cm; /**< smaller change of uncertainty is not published */
+        uint16_t force_distance_cm; /**< larger movement is published immediately, even before @ref min_interval */
+        TickType_t min_interval; /**< publish at most once per this time (unless movement exceeds @ref force_distance_cm) */
+        TickType_t max_interval; /**< publish at least once per this time, even if location did not change */
+    } publish_config_t;
+
+    typedef struct{
+        uint32_t published; /**< locations sent to the device */
+        uint32_t forced; /**< locations sent before @ref publish_config_t::min_interval because of large movement */
+        uint32_t suppressed_deadband; /**< locations not sent because they did not change enough */
+        uint32_t suppressed_rate; /**< locations not sent because of @ref publish_config_t::min_interval */
+    } publish_stats_t;
+
+    /**
+     * @brief Publishes location of a device only when it changed enough
+     *
+     * Every Device::setLocation() is a serial PUT followed by a Bluetooth mesh message to the whole network,
+     * so localization publishes through this policy instead of calling it on every fix.
+     */
+    class LocationPublisher{
+        public:
+            /**
+             * @brief Construct a new Location Publisher object
+             *
+             * @param device device whose location is published
+             * @param config publish policy
+             */
+            LocationPublisher(std::shared_ptr<Device> device, const publish_config_t &config);
+            /**
+             * @brief Construct a new Location Publisher object with policy for type of the device (Kconfig IMF_PUBLISH_*)
+             *
+             * @param device device whose location is published
+             */
+            LocationPublisher(std::shared_ptr<Device> device);
+            ~LocationPublisher();
+
+            /**
+             * @brief Publish location if the policy allows it
+             *
+             * @param location new location of the device
+             * @return esp_err_t ESP_OK if location was published, ESP_ERR_NOT_FINISHED if it was suppressed, error of Device::setLocation() otherwise
+             */
+            esp_err_t publish(const location_local_t &location);
+
+            /**
+             * @brief Counters of published and suppressed locations
+             */
+            publish_stats_t stats();
+
+            /**
+             * @brief Default publish policy for given device type
+             */
+            static publish_config_t defaultConfig(DeviceType type);
+        private:
+            std::shared_ptr<Device> _device;
+            publish_config_t _config;
+            SemaphoreHandle_t _mutex; /**< publish() is called from localization task and event loop */
+            location_local_t _last = {0,0,0,0,0}; /**< last published location */
+            TickType_t _last_time = 0; /**< time of last publish */
+            bool _published = false; /**< @ref _last is valid */
+            publish_stats_t _stats = {0,0,0,0};
+    };
+}
+
+#endif
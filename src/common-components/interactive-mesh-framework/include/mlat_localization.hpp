@@ -6,11 +6,18 @@
 #include <unordered_map>
 #include <utility>
 #include <memory>
+#include <array>
+#include <span>
 #include "location_defs.h"
 #include "esp_err.h"
+#include "freertos/semphr.h"
 
 #include "imf-device.hpp"
 #include "localization.hpp"
+#include "localization_trigger.hpp"
+#include "location_publisher.hpp"
+#include "station_index.hpp"
+#include "mlat.hpp"
 
 namespace imf{
     class MlatLocalization : public Localization{
@@ -34,6 +41,18 @@ namespace imf{
              * @copydoc Localization::tick
              */
             void tick(TickType_t diff);
+            /**
+             * @copydoc Localization::distanceUpdated
+             * 
+             * Runs in the event loop, so it only records the distance. If the station is one of anchors
+             * used by last tick(), localization task is woken to update position incrementally
+             * (updateIncremental()), otherwise it is woken when enough stations have new distances.
+             */
+            void distanceUpdated(uint32_t station_id, const distance_measurement_t &measurement);
+            /**
+             * @copydoc Localization::getStats
+             */
+            esp_err_t getStats(localization_stats_t &stats);
 
             /**
              * @brief Convert location to x,y coordinate
@@ -52,10 +71,166 @@ namespace imf{
              * @param[out] location output location
              */
             static void posToLocation(const float x, const float y, location_local_t &location);
+
+            /**
+             * @brief Convert location to 3D position (altitude is z coordinate)
+             * 
+             * @param[in] location input location
+             * @param[out] pos output position
+             */
+            static void locationToPos(const location_local_t &location, mlat::position3d_t &pos);
+
+            /**
+             * @brief Convert 3D position to location
+             * 
+             * @param[in] pos position (z coordinate is altitude)
+             * @param[in] floor floor number
+             * @param[out] location output location
+             */
+            static void posToLocation(const mlat::position3d_t &pos, uint8_t floor, location_local_t &location);
         private:
             std::shared_ptr<imf::Device> _this_device;
             std::unordered_map<uint32_t, std::shared_ptr<imf::Device>> _stations;
             TaskHandle_t _xHandle = NULL;
+            LocalizationTrigger _trigger; /**< wakes task() when new distances arrive */
+            LocationPublisher _publisher; /**< limits how often location of @ref _this_device is sent to the network */
+            LocalizationStats _stats; /**< timing and counters of ticks */
+            typedef struct{
+                uint32_t id; /**< station id */
+                mlat::anchor_t anchor; /**< horizontal position of the station and horizontal distance to it */
+                mlat::anchor3d_t anchor3d; /**< position of the station and measured distance to it */
+                uint8_t floor; /**< floor of the station */
+                mlat::anchor_cm_t anchor_cm; /**< @ref anchor on centimetre grid from station location and distance in cm (for fixed-point solving) */
+                int16_t altitude_cm; /**< altitude of the station in cm */
+                float weight; /**< weight of the distance in least squares, 1 for fresh measurement, lower for older ones */
+            } station_anchor_t;
+
+            typedef struct{
+                uint32_t id; /**< station id */
+                std::shared_ptr<imf::Device> station; /**< station device */
+                location_local_t location; /**< station location, only valid if @ref known */
+                mlat::position3d_t pos; /**< station position converted from @ref location */
+                bool known; /**< location of the station is known */
+            } station_entry_t;
+
+            std::vector<station_entry_t> _station_table; /**< snapshot of station locations, tick() does not query devices */
+            uint32_t _station_table_version = 0; /**< Device::stationLocationVersion() of @ref _station_table */
+            bool _station_table_complete = false; /**< all station locations in @ref _station_table are known */
+            StationIndex _station_index; /**< spatial index of @ref _station_table entries with known location */
+            std::vector<location_local_t> _index_locations; /**< locations passed to @ref _station_index (reused between builds) */
+            std::vector<bool> _index_known; /**< usable locations in @ref _index_locations (reused between builds) */
+            std::vector<size_t> _candidates; /**< indices of @ref _station_table entries considered in current tick */
+            std::vector<size_t> _previous_candidates; /**< @ref _candidates of the last tick (sorted) */
+            int32_t _search_radius_cm; /**< radius around last position in which stations are considered, 0 for all stations */
+
+            mlat::MLATSolver _solver; /**< keeps factorization of station geometry between ticks */
+            mlat::MLATSolver3D _solver3d; /**< keeps factorization of 3D station geometry between ticks */
+            std::vector<station_anchor_t> _anchors; /**< anchors of current tick (reused to avoid allocations) */
+            mlat::IncrementalMLAT _incremental; /**< anchors of last tick, updated by distanceUpdated() */
+            std::array<uint32_t, mlat::max_anchors> _incremental_ids; /**< station ids of anchors in @ref _incremental */
+            std::array<float, mlat::max_anchors> _incremental_z; /**< altitudes of anchors in @ref _incremental */
+            std::array<float, mlat::max_anchors> _incremental_weights; /**< weights of anchors in @ref _incremental (from last tick, 1 after update) */
+            std::array<float, mlat::max_anchors> _incremental_distances; /**< new distances of anchors in @ref _incremental recorded by distanceUpdated() */
+            uint32_t _incremental_pending = 0; /**< bit mask of anchors with new distance in @ref _incremental_distances */
+            mlat::PositionTracker _tracker; /**< fuses fixes into smooth track (starting point of refinement and prediction) */
+            TickType_t _track_time = 0; /**< time of last update of @ref _tracker */
+            float _altitude = 0; /**< altitude of this device used for projection of distances */
+            bool _altitude_valid = false; /**< true if @ref _altitude was estimated */
+            uint8_t _floor = 0; /**< floor of this device */
+            bool _floor_valid = false; /**< true if @ref _floor is known, stations on distant floors are skipped */
+            uint32_t _ticks_since_full_scan = 0; /**< ticks since distances to all stations were measured */
+            SemaphoreHandle_t _mutex; /**< synchronizes localization task and distanceUpdated() */
+
+            /**
+             * @brief Refresh @ref _station_table if station locations changed (or some are not known yet)
+             */
+            void refreshStationTable();
+
+            /**
+             * @brief Fill @ref _candidates with stations around last position (all stations if position is not known)
+             * 
+             * Stations that left the search area since the last tick are not measured any more.
+             */
+            void selectCandidates();
+
+            /**
+             * @brief Widen search radius when too few anchors were found, shrink it back when there are plenty of them
+             * 
+             * @param anchors number of usable anchors found within the search radius
+             */
+            void updateSearchRadius(size_t anchors);
+
+            /**
+             * @brief Refine least squares solution (if enabled), call without @ref _mutex taken
+             * 
+             * @ref _mutex is taken only to predict the warm start, so distanceUpdated() is not blocked
+             * by the iterations.
+             * 
+             * @param anchors anchors of multilateration
+             * @param weights weights of anchors (see station_anchor_t::weight), empty for equal weights
+             * @param solution least squares solution
+             * @return mlat::solution_t resulting solution
+             */
+            mlat::solution_t refineSolution(std::span<const mlat::anchor_t> anchors, std::span<const float> weights, mlat::solution_t solution);
+
+            /**
+             * @brief Fuse fix into track of this device (call with @ref _mutex taken)
+             * 
+             * @param solution position fix with covariance
+             * @return mlat::track_t tracked position that should be published
+             */
+            mlat::track_t trackSolution(const mlat::solution_t& solution);
+
+            /**
+             * @brief Predict current position from the track (call with @ref _mutex taken)
+             * 
+             * @param[out] pos predicted position
+             * @return bool true if track is recent enough for prediction
+             */
+            bool predictPosition(mlat::position_t &pos);
+
+            /**
+             * @brief Resolve position from 1 or 2 anchors using the track
+             * 
+             * Two anchors give two mirror positions, the one closer to predicted position is used.
+             * If the circles do not intersect, the best fit near predicted position is used.
+             * One anchor gives the point of its circle closest to predicted position. 
+             * Without track any of the possible positions is returned and it is not tracked.
+             * 
+             * @param anchors 1 or 2 anchors
+             * @return mlat::track_t resulting position
+             */
+            mlat::track_t solveAmbiguous(std::span<const mlat::anchor_t> anchors);
+
+            /**
+             * @brief Keep only anchors with good geometry around last position and measure only them
+             * 
+             * Anchors are selected by mlat::MLAT::select_anchors(), distance measurements of other 
+             * stations are disabled. All stations are measured when position is not known yet 
+             * and periodically, so that selection can change as this device moves.
+             * 
+             * @param[in,out] anchors anchors of current tick, unselected anchors are removed
+             */
+            void selectAnchors(std::vector<station_anchor_t>& anchors);
+
+            /**
+             * @brief Estimate altitude and floor of this device (@ref _altitude, @ref _floor)
+             * 
+             * Altitude is solved in 3D if stations are not in one horizontal plane, otherwise last 
+             * altitude is kept. Result is snapped to floors of the @p anchors .
+             * 
+             * @param anchors anchors of current tick (at least one)
+             */
+            void updateAltitude(std::span<const station_anchor_t> anchors);
+
+            /**
+             * @brief Update position with distances recorded by distanceUpdated() (runs in localization task)
+             * 
+             * Anchors rejected as outliers by last tick() are not in @ref _incremental, so they are never
+             * updated. New distance that disagrees with current position more than outlier threshold is
+             * left for next tick(). Anchors keep their weights from last tick().
+             */
+            void updateIncremental();
 
             /**
              * @brief Distance between devices
@@ -0,0 +1,100 @@
+#ifndef PARTICLE_LOCALIZATION_H_
+#define PARTICLE_LOCALIZATION_H_
+
+#include <inttypes.h>
+#include <vector>
+#include <memory>
+#include "location_defs.h"
+#include "esp_err.h"
+#include "freertos/semphr.h"
+
+#include "imf-device.hpp"
+#include "localization.hpp"
+#include "localization_trigger.hpp"
+#include "location_publisher.hpp"
+#include "mlat.hpp"
+#include "particle_filter.hpp"
+
+namespace imf{
+    /**
+     * @brief Localization using particle filter (mlat::ParticleFilter)
+     *
+     * Keeps multiple hypotheses of position, so it can handle situations that multilateration
+     * cannot resolve (e.g. only two reachable stations). Number of particles is set at compile time
+     * (CONFIG_IMF_PARTICLE_COUNT), so memory and computation time are bounded.
+     */
+    class ParticleLocalization : public Localization{
+        public:
+            /**
+             * @brief Construct a new Particle Localization object
+             *
+             * @param this_device local device
+             * @param stations all possible stations which can be used as anchors
+             */
+            ParticleLocalization(std::shared_ptr<imf::Device> this_device, std::vector<std::shared_ptr<imf::Device>> stations);
+            /**
+             * @copydoc Localization::start
+             */
+            bool start();
+            /**
+             * @copydoc Localization::stop
+             */
+            void stop();
+            /**
+             * @copydoc Localization::tick
+             *
+             * Particles are moved according to @p diff and weighted by distances measured since last tick.
+             */
+            void tick(TickType_t diff);
+            /**
+             * @copydoc Localization::distanceUpdated
+             *
+             * Wakes localization task when enough stations have new distances.
+             */
+            void distanceUpdated(uint32_t station_id, const distance_measurement_t &measurement);
+
+            /**
+             * @brief Number of particles
+             */
+            static constexpr size_t particle_count = CONFIG_IMF_PARTICLE_COUNT;
+        private:
+            typedef struct{
+                uint32_t id; /**< station id */
+                std::shared_ptr<imf::Device> station; /**< station device */
+                mlat::position_t pos; /**< station position, only valid if @ref known */
+                TickType_t used_timestamp; /**< timestamp of last distance of the station used by the filter */
+                bool known; /**< location of the station is known (with low uncertainty) */
+            } station_entry_t;
+
+            std::shared_ptr<imf::Device> _this_device;
+            std::vector<station_entry_t> _station_table; /**< snapshot of station locations, tick() does not query devices */
+            uint32_t _station_table_version = 0; /**< Device::stationLocationVersion() of @ref _station_table */
+            bool _station_table_complete = false; /**< all station locations in @ref _station_table are known */
+            mlat::position_t _stations_min; /**< corner of bounding box of known stations with minimal coordinates */
+            mlat::position_t _stations_max; /**< corner of bounding box of known stations with maximal coordinates */
+            std::vector<mlat::anchor_t> _anchors; /**< anchors of current tick (reused to avoid allocations) */
+            mlat::ParticleFilter<particle_count> _filter;
+            TaskHandle_t _xHandle = NULL;
+            LocalizationTrigger _trigger; /**< wakes task() when new distances arrive */
+            LocationPublisher _publisher; /**< limits how often location of @ref _this_device is sent to the network */
+
+            /**
+             * @brief Refresh @ref _station_table if station locations changed (or some are not known yet)
+             */
+            void refreshStationTable();
+
+            /**
+             * @brief Task for continuous localization
+             */
+            void task();
+
+            /**
+             * @brief Necessary wrapper for creating thread that performs object's method
+             * @param param pointer to ParticleLocalization (usually @p this )
+             */
+            static void taskWrapper(void* param){
+                static_cast<ParticleLocalization *>(param)->task();
+            }
+    };
+}
+#endif
@@ -0,0 +1,80 @@
+/**
+ * @file station_index.hpp
+ * @author Daniel Kurek (daniel.kurek.dev@gmail.com)
+ * @brief Uniform grid index of station locations
+ * @version 0.1
+ * @date 2024-05-16
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#ifndef STATION_INDEX_HPP_
+#define STATION_INDEX_HPP_
+
+#include <inttypes.h>
+#include <cstddef>
+#include <vector>
+#include <span>
+#include "location_defs.h"
+
+namespace imf{
+    /**
+     * @brief Finds stations within a radius without visiting all of them
+     *
+     * Stations are bucketed into square cells over bounding box of their locations (local north/east in cm).
+     * Cells are stored as one array sorted by cell (offsets in @ref _cell_start), so a query only visits
+     * cells overlapping the searched circle.
+     */
+    class StationIndex{
+        public:
+            /**
+             * @brief Construct a new Station Index object
+             *
+             * @param cell_size_cm requested size of cell, increased when there would be more than @p max_cells cells
+             * @param max_cells upper bound of number of cells (bounds memory)
+             */
+            StationIndex(int32_t cell_size_cm, size_t max_cells);
+
+            /**
+             * @brief Build index of locations
+             *
+             * @param locations locations of stations, index in this span is returned by query()
+             * @param known locations that are indexed (same size as @p locations)
+             */
+            void build(std::span<const location_local_t> locations, const std::vector<bool> &known);
+
+            /**
+             * @brief Find stations within radius
+             *
+             * @param north_cm local north of centre
+             * @param east_cm local east of centre
+             * @param radius_cm search radius
+             * @param[out] out indices of found stations are appended (in increasing order of cells, not sorted)
+             * @return size_t number of found stations
+             */
+            size_t query(int32_t north_cm, int32_t east_cm, int32_t radius_cm, std::vector<size_t> &out) const;
+
+            /**
+             * @brief Number of indexed stations
+             */
+            size_t size() const { return _items.size(); }
+        private:
+            typedef struct{
+                size_t station; /**< index of station in locations passed to build() */
+                int32_t north; /**< local north (cm) */
+                int32_t east; /**< local east (cm) */
+            } item_t;
+
+            int32_t _requested_cell_cm;
+            size_t _max_cells;
+            int32_t _cell_cm = 1; /**< size of cell after build() */
+            int32_t _origin_north = 0; /**< north of cell (0,0) corner */
+            int32_t _origin_east = 0; /**< east of cell (0,0) corner */
+            int32_t _cols = 0; /**< cells along north axis */
+            int32_t _rows = 0; /**< cells along east axis */
+            std::vector<uint32_t> _cell_start; /**< offset of first item of each cell in @ref _items, one extra entry at the end */
+            std::vector<item_t> _items; /**< stations sorted by cell */
+    };
+}
+
+#endif
@@ -0,0 +1,97 @@
+/**
+ * @file station_survey.hpp
+ * @author Daniel Kurek (daniel.kurek.dev@gmail.com)
+ * @brief Cooperative self-survey of station locations
+ * @version 0.1
+ * @date 2024-05-14
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#ifndef STATION_SURVEY_HPP_
+#define STATION_SURVEY_HPP_
+
+#include <inttypes.h>
+#include <memory>
+#include <vector>
+#include <string>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "imf-device.hpp"
+#include "location_publisher.hpp"
+#include "survey.hpp"
+
+namespace imf{
+    /**
+     * @brief Places all stations at once from their mutual distances
+     *
+     * Every station publishes its row of the distance matrix (distances it measured to other stations)
+     * as the "dist" field to all devices and collects rows of the other stations. When the rows connect
+     * all stations, the whole layout is solved in one batch by mlat::SurveySolver and this station
+     * publishes its own location. Stations with configured location (uncertainty 0) are used as fixed.
+     *
+     * Row is sent as list of `<addr>=<distance>` pairs separated by `,`, where `<addr>` is Bluetooth mesh
+     * address of measured station and `<distance>` is distance in cm, both as 4 hex digits.
+     */
+    class StationSurvey{
+        public:
+            /**
+             * @brief Construct a new Station Survey object
+             *
+             * @param this_device local station
+             * @param stations other stations
+             */
+            StationSurvey(std::shared_ptr<Device> this_device, std::vector<std::shared_ptr<Device>> stations);
+            ~StationSurvey();
+
+            /**
+             * @brief Publish own distances and solve layout when data changed
+             *
+             * @param diff time since the last tick
+             * @return true if location of this station is fixed or was determined by the survey
+             */
+            bool tick(TickType_t diff);
+
+            /**
+             * @brief Store row of distance matrix received from another station
+             *
+             * @param addr Bluetooth mesh address of the station that measured the distances
+             * @param value encoded row
+             * @return esp_err_t ESP_OK if the row was stored, ESP_ERR_NOT_FOUND for unknown station, ESP_FAIL if it could not be parsed
+             */
+            esp_err_t rowReceived(uint16_t addr, const std::string &value);
+        private:
+            /**
+             * @brief Index of station in @ref _stations, -1 if unknown
+             */
+            int stationIndex(uint16_t addr) const;
+
+            /**
+             * @brief Update own row from DistanceMeter log and send it once per row interval
+             */
+            void publishRow();
+
+            /**
+             * @brief Solve layout from collected rows and publish location of this station
+             *
+             * @param rows copy of distance matrix (cm)
+             * @return true if layout was solved
+             */
+            bool solve(const std::vector<std::vector<uint16_t>> &rows);
+
+            std::shared_ptr<Device> _this_device;
+            std::vector<std::shared_ptr<Device>> _stations; /**< all stations sorted by Bluetooth mesh address, so that every station solves the same layout */
+            size_t _self = 0; /**< index of this station in @ref _stations */
+            SemaphoreHandle_t _mutex; /**< rows are received from serial read task */
+            std::vector<std::vector<uint16_t>> _rows; /**< distance matrix (cm), 0 if not measured */
+            uint32_t _rows_version = 0; /**< incremented whenever a row changes */
+            uint32_t _solved_version = 0; /**< @ref _rows_version of the last solved layout */
+            TickType_t _last_publish = 0;
+            bool _published = false; /**< own row was sent at least once */
+            bool _solved = false; /**< location of this station was determined by the survey */
+            mlat::SurveySolver _solver;
+            LocationPublisher _publisher;
+    };
+}
+
+#endif
@@ -22,6 +22,8 @@
 #include "esp_check.h"
 
 #include "mlat_localization.hpp"
+#include "particle_localization.hpp"
+#include "grid_localization.hpp"
 
 #define EVENT_LOOP_QUEUE_SIZE 16
 
@@ -43,6 +45,7 @@ using namespace com;
 std::shared_ptr<SerialCommCli> Device::_serial = std::make_shared<SerialCommCli>(UART_NUM_1, SERIAL_TX_GPIO, SERIAL_RX_GPIO, 1000 / portTICK_PERIOD_MS);
 std::shared_ptr<DistanceMeter> Device::_dm = nullptr;
 std::shared_ptr<Device> Device::this_device = nullptr;
+std::atomic<uint32_t> Device::_station_location_version = 0;
 
 /**
  * @brief Parser for Location option in web_config
@@ -62,6 +65,7 @@ static esp_err_t loc_pos_opt_parse(const char *value, int16_t &north, int16_t &e
 
 Device::Device(uint32_t _id, DeviceType _type, std::string _wifi_mac_str, uint8_t _wifi_channel, uint16_t _ble_mesh_addr, bool local_commands)
     : id(_id), type(_type), ble_mesh_addr(_ble_mesh_addr), fixed_location(false), _local_commands(local_commands){
+    _location_mutex = xSemaphoreCreateMutex();
     // Only measure distances to stations
     if(_type == DeviceType::Station){
         if(_dm != nullptr){
@@ -90,6 +94,7 @@ Device::Device(uint32_t _id, DeviceType _type, std::string _wifi_mac_str, uint8_
 Device::Device(uint32_t _id, DeviceType _type, std::string _wifi_mac_str, uint8_t _wifi_channel, uint16_t _ble_mesh_addr, 
     rgb_t rgb, location_local_t location, int16_t level, uint32_t distance_cm, int8_t rssi)
     : id(_id), type(_type), ble_mesh_addr(_ble_mesh_addr), _local_commands(false){
+    _location_mutex = xSemaphoreCreateMutex();
     setRgb(rgb);
     setLocation(location);
     setLevel(level);
@@ -288,6 +293,7 @@ esp_err_t Device::setLocation(const location_local_t &location){
     }
     
     debug_location = location;
+    _cacheLocation(location);
     return ESP_OK;
 }
 #else
@@ -306,6 +312,7 @@ esp_err_t Device::setLocation(const location_local_t &location){
         response = _serial->PutField(ble_mesh_addr, "loc", loc_value);
     }
     ESP_LOGI(TAG, "set loc response %s", response.c_str());
+    _cacheLocation(location);
     return ESP_OK;
 }
 #endif
@@ -317,6 +324,14 @@ esp_err_t Device::getLocation(location_local_t &location_out){
 }
 #else
 esp_err_t Device::getLocation(location_local_t &location_out){
+    xSemaphoreTake(_location_mutex, portMAX_DELAY);
+    const bool known = _location_known;
+    location_out = _location;
+    xSemaphoreGive(_location_mutex);
+    if(known){
+        return ESP_OK;
+    }
+
     std::string loc_val;
     if(_local_commands){
         loc_val = _serial->GetField("loc");
@@ -328,11 +343,39 @@ esp_err_t Device::getLocation(location_local_t &location_out){
         ESP_LOGE(TAG, "Failed to convert simple Location response to value: %s", loc_val.c_str());
         return ESP_FAIL;
     }
-
+    _cacheLocation(location_out);
     return ESP_OK;
 }
 #endif
 
+esp_err_t Device::locationChanged(const std::string &loc_value){
+    location_local_t location;
+    esp_err_t err = simple_str_to_loc(loc_value.c_str(), &location);
+    if(err != ESP_OK){
+        ESP_LOGE(TAG, "Failed to convert simple Location notification to value: %s", loc_value.c_str());
+        return ESP_FAIL;
+    }
+    _cacheLocation(location);
+    return ESP_OK;
+}
+
+void Device::_cacheLocation(const location_local_t &location){
+    xSemaphoreTake(_location_mutex, portMAX_DELAY);
+    const bool changed = !_location_known
+        || _location.local_north != location.local_north
+        || _location.local_east != location.local_east
+        || _location.local_altitude != location.local_altitude
+        || _location.floor_number != location.floor_number
+        || _location.uncertainty != location.uncertainty;
+    _location = location;
+    _location_known = true;
+    xSemaphoreGive(_location_mutex);
+    // only stations are used as anchors, moving devices would invalidate anchor tables all the time
+    if(changed && type == DeviceType::Station){
+        _station_location_version++;
+    }
+}
+
 #if CONFIG_IMF_DEBUG_STATIC_DEVICES
 esp_err_t Device::setLevel(int16_t level){
     ESP_LOGI(TAG, "setLevel device=%" PRIu32": %" PRId16, id, level);
@@ -409,10 +452,10 @@ esp_err_t Device::measureDistance(distance_measurement_t &measurement){
 }
 #else
 esp_err_t Device::measureDistance(distance_measurement_t &measurement){
-    if(type == DeviceType::Mobile || _point == nullptr){
+    if(type == DeviceType::Mobile || _point == nullptr || _dm == nullptr){
         return ESP_FAIL;
     }
-    return _point->measureDistance(measurement);
+    return _dm->measureDistance(_point->getID(), measurement);
 }
 #endif
 
@@ -425,11 +468,23 @@ esp_err_t Device::lastDistance(distance_log_t &distance_log){
 }
 #else
 esp_err_t Device::lastDistance(distance_log_t &distance_log){
-    if(!_point) return ESP_FAIL;
-    return _point->getDistanceFromLog(distance_log);
+    if(!_point || !_dm) return ESP_FAIL;
+    return _dm->getDistanceFromLog(_point->getID(), distance_log);
 }
 #endif
 
+esp_err_t Device::setDistanceMeasurement(bool enabled){
+    if(!_point) return ESP_FAIL;
+    _point->setEnabled(enabled);
+    return ESP_OK;
+}
+
+esp_err_t Device::setDistanceUsefulness(float usefulness){
+    if(!_point) return ESP_FAIL;
+    _point->setUsefulness(usefulness);
+    return ESP_OK;
+}
+
 std::string Device::_getMAC(){
     uint8_t mac_addr[8]; // only 6 bytes will be used
     esp_read_mac(mac_addr, ESP_MAC_WIFI_SOFTAP);
@@ -497,7 +552,7 @@ IMF::IMF(const std::vector<button_gpio_config_t> &buttons, bool default_states){
         EVENT_LOOP_QUEUE_SIZE, // queue_size
         "IMF-loop",            // task_name
         tskIDLE_PRIORITY,      // task_priority
-        1024*4,                // task_stack_size
+        1024*8,                // task_stack_size (localization is updated from DM events)
         tskNO_AFFINITY         // task_core_id
     };
     
@@ -553,8 +608,12 @@ IMF::IMF(const std::vector<button_gpio_config_t> &buttons, bool default_states){
     Device::setDM(_dm);
 
     auto serial = Device::getSerialCli();
-    if(serial)
+    if(serial){
+        // keep cached locations of devices up to date without polling
+        serial->registerFieldHandler("loc", _loc_field_handler, this);
+        serial->registerFieldHandler("dist", _dist_field_handler, this);
         serial->startReadTask();
+    }
     
     if(default_states){
         addDefaultStates();
@@ -589,7 +648,67 @@ void IMF::_init_localization(){
             stations.push_back(device);
         }
     }
+#if CONFIG_IMF_LOCALIZATION_PARTICLE
+    _localization = std::make_shared<ParticleLocalization>(Device::this_device, stations);
+#elif CONFIG_IMF_LOCALIZATION_GRID
+    _localization = std::make_shared<GridLocalization>(Device::this_device, stations);
+#else
     _localization = std::make_shared<MlatLocalization>(Device::this_device, stations);
+#endif
+#if CONFIG_IMF_STATION_SURVEY
+    if(Device::this_device && Device::this_device->type == DeviceType::Station){
+        _survey = std::make_shared<StationSurvey>(Device::this_device, stations);
+    }
+#endif
+    esp_err_t err = _dm->registerEventHandle(_dm_event_handler, this);
+    if(err != ESP_OK){
+        LOGGER_E(TAG, "Could not register localization DM event handler");
+    }
+}
+
+void IMF::_dm_event_handler(void* handler_args, esp_event_base_t base, int32_t id, void* event_data){
+    IMF *imf = static_cast<IMF *>(handler_args);
+    if(base != DM_EVENT || id != DM_MEASUREMENT_DONE || !imf->_localization){
+        return;
+    }
+    dm_measurement_data_t *data = (dm_measurement_data_t *) event_data;
+    if(data->valid){
+        imf->_localization->distanceUpdated(data->point_id, data->measurement);
+    }
+}
+
+void IMF::_loc_field_handler(void *handler_args, const std::string& field, const std::string& value){
+    IMF *imf = static_cast<IMF *>(handler_args);
+    std::string field_name;
+    uint16_t addr = 0;
+    FieldParseErr err = ParseField(field, field_name, addr);
+    if(err == FieldParseErr::no_addr){
+        if(Device::this_device){
+            Device::this_device->locationChanged(value);
+        }
+        return;
+    }
+    if(err != FieldParseErr::ok){
+        return;
+    }
+    if(Device::this_device && Device::this_device->ble_mesh_addr == addr){
+        Device::this_device->locationChanged(value);
+    }
+    for(auto && [id, device] : imf->_devices){
+        if(device && device->ble_mesh_addr == addr){
+            device->locationChanged(value);
+        }
+    }
+}
+
+void IMF::_dist_field_handler(void *handler_args, const std::string& field, const std::string& value){
+    IMF *imf = static_cast<IMF *>(handler_args);
+    std::string field_name;
+    uint16_t addr = 0;
+    if(!imf->_survey || ParseField(field, field_name, addr) != FieldParseErr::ok){
+        return;
+    }
+    imf->_survey->rowReceived(addr, value);
 }
 
 esp_err_t IMF::start() { 
@@ -751,6 +870,9 @@ void IMF::addDefaultStates(){
     if(Device::this_device && Device::this_device->type == DeviceType::Station){
         auto dmTick = safeSharedTickCall<DistanceMeter>(_dm);
         auto topologyTick = [this](TickType_t diff) { 
+            // survey places all stations at once, single station localization is used until it succeeds
+            if(this->_survey && this->_survey->tick(diff))
+                return;
             if(this->_localization && Device::this_device && Device::this_device->fixed_location == false) 
                 this->_localization->tick(diff); 
         };
@@ -778,6 +900,7 @@ void IMF::startWebConfig(){
         LOGGER_E(TAG, "Could not set custom web config options! Err: %d", err);
         return;
     }
+    web_config_set_status_function(_web_status, this);
     board_set_rgb(&internal_rgb_conf, (rgb_t){120,0,60}); // light pink
     web_config_start();
 }
@@ -796,4 +919,25 @@ void IMF::stopLocalization(){
     if(_localization){
         _localization->stop();
     }
+}
+
+esp_err_t IMF::getLocalizationStats(localization_stats_t &stats){
+    if(_localization){
+        return _localization->getStats(stats);
+    }
+    return ESP_FAIL;
+}
+
+int IMF::_web_status(void *ctx, char *buf, size_t buf_size){
+    IMF *imf = static_cast<IMF *>(ctx);
+    localization_stats_t stats;
+    if(imf->getLocalizationStats(stats) != ESP_OK){
+        return snprintf(buf, buf_size, "{}");
+    }
+    int len = snprintf(buf, buf_size, "{\"localization\":");
+    if(len < 0 || (size_t)len >= buf_size) return -1;
+    int stats_len = LocalizationStats::toJson(stats, buf + len, buf_size - len);
+    if(stats_len < 0 || (size_t)(len + stats_len) >= buf_size - 1) return -1;
+    len += stats_len;
+    return len + snprintf(buf + len, buf_size - len, "}");
 }
\ No newline at end of file
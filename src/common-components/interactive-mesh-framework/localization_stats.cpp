@@ -0,0 +1,115 @@
+/**
+ * @file localization_stats.cpp
+ * @author Daniel Kurek (daniel.kurek.dev@gmail.com)
+ * @brief Implementation of @ref localization_stats.hpp
+ * @version 0.1
+ * @date 2024-05-18
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "localization_stats.hpp"
+#include "esp_timer.h"
+#include "logger.h"
+#include <algorithm>
+#include <cstdio>
+
+using namespace imf;
+
+constexpr TickType_t report_interval = pdMS_TO_TICKS(CONFIG_IMF_LOCALIZATION_STATS_INTERVAL_MS);
+
+LocalizationStats::LocalizationStats(const char *tag) : _tag(tag), _current{}, _total{}{
+    _mutex = xSemaphoreCreateMutex();
+}
+
+LocalizationStats::~LocalizationStats(){
+    vSemaphoreDelete(_mutex);
+}
+
+void LocalizationStats::begin(){
+    _current = {};
+    _begin_us = esp_timer_get_time();
+}
+
+void LocalizationStats::residual(float residual){
+    const float residual_cm = residual * 100;
+    size_t bin = 0;
+    while(bin < residual_bin_count - 1 && residual_cm >= residual_bin_edges_cm[bin]){
+        bin++;
+    }
+    _current.residuals[bin]++;
+}
+
+void LocalizationStats::end(LocalizationBranch branch, size_t anchors){
+    const uint32_t duration = (uint32_t)(esp_timer_get_time() - _begin_us);
+    const TickType_t now = xTaskGetTickCount();
+
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    _total.ticks++;
+    _total.last_us = duration;
+    _total.max_us = std::max(_total.max_us, duration);
+    _total.total_us += duration;
+    _total.anchors_last = anchors;
+    _total.anchors_total += anchors;
+    _total.branches[(size_t)branch]++;
+    for(size_t i = 0; i < skip_reason_count; i++){
+        _total.skipped[i] += _current.skipped[i];
+    }
+    for(size_t i = 0; i < residual_bin_count; i++){
+        _total.residuals[i] += _current.residuals[i];
+    }
+    const bool report = now - _last_report >= report_interval;
+    const localization_stats_t total = _total;
+    xSemaphoreGive(_mutex);
+
+    if(report){
+        _last_report = now;
+        LOGGER_I(_tag, "stats: ticks %" PRIu32 ", mean %" PRIu32 " us, max %" PRIu32 " us, anchors %.1f, "
+            "branches %" PRIu32 "/%" PRIu32 "/%" PRIu32 "/%" PRIu32 "/%" PRIu32,
+            total.ticks, (uint32_t)(total.total_us / total.ticks), total.max_us, (float)total.anchors_total / total.ticks,
+            total.branches[0], total.branches[1], total.branches[2], total.branches[3], total.branches[4]);
+    }
+}
+
+localization_stats_t LocalizationStats::stats(){
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    const localization_stats_t stats = _total;
+    xSemaphoreGive(_mutex);
+    return stats;
+}
+
+void LocalizationStats::reset(){
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    _total = {};
+    xSemaphoreGive(_mutex);
+}
+
+/**
+ * @brief Append JSON array of counters to buffer
+ */
+static int append_array(char *buf, size_t buf_size, int len, const char *key, const uint32_t *values, size_t count){
+    if(len < 0 || (size_t)len >= buf_size) return len;
+    len += snprintf(buf + len, buf_size - len, ",\"%s\":[", key);
+    for(size_t i = 0; i < count && (size_t)len < buf_size; i++){
+        len += snprintf(buf + len, buf_size - len, i == 0 ? "%" PRIu32 : ",%" PRIu32, values[i]);
+    }
+    if((size_t)len < buf_size){
+        len += snprintf(buf + len, buf_size - len, "]");
+    }
+    return len;
+}
+
+int LocalizationStats::toJson(const localization_stats_t &stats, char *buf, size_t buf_size){
+    int len = snprintf(buf, buf_size, "{\"ticks\":%" PRIu32 ",\"last_us\":%" PRIu32 ",\"max_us\":%" PRIu32 ",\"total_us\":%" PRIu64
+        ",\"anchors_last\":%" PRIu32 ",\"anchors_total\":%" PRIu64,
+        stats.ticks, stats.last_us, stats.max_us, stats.total_us, stats.anchors_last, stats.anchors_total);
+    // order of @ref LocalizationBranch, @ref SkipReason and @ref residual_bin_edges_cm
+    len = append_array(buf, buf_size, len, "branches", stats.branches, localization_branch_count);
+    len = append_array(buf, buf_size, len, "skipped", stats.skipped, skip_reason_count);
+    len = append_array(buf, buf_size, len, "residuals", stats.residuals, residual_bin_count);
+    if(len >= 0 && (size_t)len < buf_size){
+        len += snprintf(buf + len, buf_size - len, "}");
+    }
+    return len;
+}
@@ -0,0 +1,104 @@
+/**
+ * @file localization_trigger.cpp
+ * @author Daniel Kurek (daniel.kurek.dev@gmail.com)
+ * @brief Implementation of @ref localization_trigger.hpp
+ * @version 0.1
+ * @date 2024-05-08
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "localization_trigger.hpp"
+#include <algorithm>
+
+using namespace imf;
+
+constexpr trigger_config_t default_config {
+    .window = pdMS_TO_TICKS(CONFIG_IMF_LOCALIZATION_WINDOW_MS),
+    .idle_timeout = pdMS_TO_TICKS(CONFIG_IMF_LOCALIZATION_IDLE_MS),
+    .min_changes = CONFIG_IMF_LOCALIZATION_MIN_CHANGES,
+};
+
+LocalizationTrigger::LocalizationTrigger(const trigger_config_t &config) : _config(config){
+    _mutex = xSemaphoreCreateMutex();
+}
+
+LocalizationTrigger::LocalizationTrigger() : LocalizationTrigger(default_config) {}
+
+LocalizationTrigger::~LocalizationTrigger(){
+    vSemaphoreDelete(_mutex);
+}
+
+void LocalizationTrigger::reserve(size_t stations){
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    _changed.reserve(stations);
+    xSemaphoreGive(_mutex);
+}
+
+void LocalizationTrigger::notify(uint32_t station_id){
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    if(_changed.empty()){
+        _first_change = xTaskGetTickCount();
+    }
+    if(std::find(_changed.begin(), _changed.end(), station_id) == _changed.end()){
+        _changed.push_back(station_id);
+    }
+    TaskHandle_t task = _task;
+    xSemaphoreGive(_mutex);
+    if(task != NULL){
+        xTaskNotifyGive(task);
+    }
+}
+
+void LocalizationTrigger::wake(){
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    _woken = true;
+    TaskHandle_t task = _task;
+    xSemaphoreGive(_mutex);
+    if(task != NULL){
+        xTaskNotifyGive(task);
+    }
+}
+
+size_t LocalizationTrigger::wait(TickType_t last_run){
+    bool woken;
+    size_t changed;
+    do{
+        changed = wait(last_run, woken);
+    } while(woken);
+    return changed;
+}
+
+size_t LocalizationTrigger::wait(TickType_t last_run, bool &woken){
+    woken = false;
+    while(true){
+        xSemaphoreTake(_mutex, portMAX_DELAY);
+        _task = xTaskGetCurrentTaskHandle();
+        const TickType_t now = xTaskGetTickCount();
+        const size_t changed = _changed.size();
+        const TickType_t idle_elapsed = now - last_run;
+        const TickType_t window_elapsed = now - _first_change;
+        const bool enough = changed > 0 && changed >= _config.min_changes;
+        if((enough && window_elapsed >= _config.window) || idle_elapsed >= _config.idle_timeout){
+            _changed.clear();
+            // full run supersedes the wake
+            _woken = false;
+            xSemaphoreGive(_mutex);
+            return changed;
+        }
+        if(_woken){
+            _woken = false;
+            woken = true;
+            xSemaphoreGive(_mutex);
+            return 0;
+        }
+        // sleep until the window closes, idle timeout expires or another distance arrives
+        TickType_t timeout = _config.idle_timeout - idle_elapsed;
+        if(enough){
+            timeout = std::min(timeout, _config.window - window_elapsed);
+        }
+        xSemaphoreGive(_mutex);
+        ulTaskNotifyTake(pdTRUE, timeout);
+    }
+}
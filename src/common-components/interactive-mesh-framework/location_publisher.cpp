@@ -0,0 +1,108 @@
+/**
+ * @file location_publisher.cpp
+ * @author Daniel Kurek (daniel.kurek.dev@gmail.com)
+ * @brief Implementation of @ref location_publisher.hpp
+ * @version 0.1
+ * @date 2024-05-10
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "location_publisher.hpp"
+#include "logger.h"
+#include <cmath>
+#include <cstdlib>
+
+using namespace imf;
+
+static const char* TAG = "LOC_PUB";
+
+constexpr publish_config_t mobile_config {
+    .min_distance_cm = CONFIG_IMF_PUBLISH_MIN_DISTANCE_CM,
+    .min_uncertainty_change_cm = CONFIG_IMF_PUBLISH_MIN_UNCERTAINTY_CHANGE_CM,
+    .force_distance_cm = CONFIG_IMF_PUBLISH_FORCE_DISTANCE_CM,
+    .min_interval = pdMS_TO_TICKS(CONFIG_IMF_PUBLISH_MIN_INTERVAL_MS),
+    .max_interval = pdMS_TO_TICKS(CONFIG_IMF_PUBLISH_MAX_INTERVAL_MS),
+};
+
+/**
+ * @brief Stations do not move, their location only needs to be refreshed (e.g. after self-survey)
+ */
+constexpr publish_config_t station_config {
+    .min_distance_cm = 10,
+    .min_uncertainty_change_cm = 10,
+    .force_distance_cm = 100,
+    .min_interval = pdMS_TO_TICKS(10000),
+    .max_interval = pdMS_TO_TICKS(300000),
+};
+
+publish_config_t LocationPublisher::defaultConfig(DeviceType type){
+    return type == DeviceType::Station ? station_config : mobile_config;
+}
+
+LocationPublisher::LocationPublisher(std::shared_ptr<Device> device, const publish_config_t &config) : _device(device), _config(config){
+    _mutex = xSemaphoreCreateMutex();
+}
+
+LocationPublisher::LocationPublisher(std::shared_ptr<Device> device)
+    : LocationPublisher(device, defaultConfig(device ? device->type : DeviceType::Mobile)) {}
+
+LocationPublisher::~LocationPublisher(){
+    vSemaphoreDelete(_mutex);
+}
+
+esp_err_t LocationPublisher::publish(const location_local_t &location){
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    const TickType_t now = xTaskGetTickCount();
+    const TickType_t elapsed = now - _last_time;
+    const float moved = std::hypot((float)location.local_north - _last.local_north,
+                                   (float)location.local_east - _last.local_east,
+                                   (float)location.local_altitude - _last.local_altitude);
+    const int uncertainty_change = std::abs((int)location.uncertainty - (int)_last.uncertainty);
+
+    bool send;
+    bool forced = false;
+    if(!_published || location.floor_number != _last.floor_number){
+        send = true;
+    } else if(moved >= _config.force_distance_cm){
+        // significant movement is never delayed
+        send = true;
+        forced = elapsed < _config.min_interval;
+    } else if(elapsed < _config.min_interval){
+        send = false;
+        _stats.suppressed_rate++;
+    } else if(elapsed >= _config.max_interval){
+        send = true;
+    } else {
+        send = moved >= _config.min_distance_cm || uncertainty_change >= _config.min_uncertainty_change_cm;
+        if(!send){
+            _stats.suppressed_deadband++;
+        }
+    }
+
+    if(!send){
+        xSemaphoreGive(_mutex);
+        return ESP_ERR_NOT_FINISHED;
+    }
+    _last = location;
+    _last_time = now;
+    _published = true;
+    _stats.published++;
+    if(forced){
+        _stats.forced++;
+    }
+    const publish_stats_t stats = _stats;
+    xSemaphoreGive(_mutex);
+
+    LOGGER_I(TAG, "publish location (moved %f cm), published %" PRIu32 ", suppressed %" PRIu32 " (deadband) %" PRIu32 " (rate)",
+        moved, stats.published, stats.suppressed_deadband, stats.suppressed_rate);
+    return _device->setLocation(location);
+}
+
+publish_stats_t LocationPublisher::stats(){
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    const publish_stats_t stats = _stats;
+    xSemaphoreGive(_mutex);
+    return stats;
+}
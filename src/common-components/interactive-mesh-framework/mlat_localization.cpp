@@ -17,6 +17,11 @@
 #include <cstdint>
 #include "logger.h"
 #include <algorithm>
+#include <array>
+#include <span>
+#include <bit>
+#include <limits>
+#include <numbers>
 
 using namespace imf;
 using namespace mlat;
@@ -28,12 +33,206 @@ static const char* TAG = "MLAT_LOC";
 constexpr int pos_scale = 100;
 
 constexpr size_t closest_anchors_limit = 5;
+static_assert(closest_anchors_limit <= mlat::max_anchors, "closest anchors have to fit into heap-free solver");
+
+constexpr float floor_height = CONFIG_IMF_MLAT_FLOOR_HEIGHT_CM * distance_scale;
+
+/**
+ * @brief Expected standard deviation of measured distances (scales position covariance)
+ */
+constexpr float distance_sigma = CONFIG_IMF_MLAT_DISTANCE_SIGMA_CM * distance_scale;
+
+/**
+ * @brief Minimal difference of station altitudes for solving altitude of this device
+ */
+constexpr float min_vertical_spread = 1.0; // m
+
+constexpr refine_config_t refine_config {
+    .max_iterations = CONFIG_IMF_MLAT_REFINE_MAX_ITERATIONS,
+    .tolerance = 0.01, // 1 cm
+    .lambda = 1e-3,
+};
+
+constexpr selection_config_t selection_config {
+    .max_anchors = closest_anchors_limit,
+    .min_anchors = 4, // one redundant anchor for outlier rejection
+    .gdop_target = 1.5,
+    .distance_weight = 0.1, // 1/m, distance error doubles at 10 m
+};
+
+/**
+ * @brief Every n-th tick measures all stations, so that distances of unselected stations do not get too old
+ */
+constexpr uint32_t full_scan_interval = 10;
+
+/**
+ * @brief Stations considered by GDOP selection (bits of anchor_selection_t::selected), the closest ones are used
+ */
+constexpr size_t selection_candidates = 32;
+
+/**
+ * @brief Spatial index is used only for larger venues, smaller ones consider all stations every tick
+ */
+constexpr size_t index_min_stations = 32;
+
+/**
+ * @brief Initial radius around last position in which stations are considered
+ */
+constexpr int32_t search_radius_cm = CONFIG_IMF_MLAT_SEARCH_RADIUS_CM;
+
+/**
+ * @brief Search radius is doubled up to this value, then all stations are considered
+ */
+constexpr int32_t max_search_radius_cm = 16 * search_radius_cm;
+
+/**
+ * @brief Upper bound of cells of the spatial index (4 B each), cells grow beyond search_radius_cm in larger venues
+ */
+constexpr size_t index_max_cells = 1024;
+
+/**
+ * @brief Track older than this is not used for prediction, next fix restarts it
+ */
+constexpr float max_prediction_time = 10.0; // s
+
+constexpr tracker_config_t tracker_config {
+    .acceleration_sigma = 0.2, // walking person, tuned on recorded path of mobile device 0011
+    .initial_speed_sigma = 1.5,
+    .gate = 13.8, // chi-square 99.9 % for 2 degrees of freedom
+    .max_rejections = 3,
+};
+
+/**
+ * @brief Variance of position along the circle of a single anchor (per unit variance of distances)
+ */
+constexpr float undetermined_variance = 1e4;
+
+/**
+ * @brief Best fit of two circles that do not intersect (independent of refine_config that can disable refinement)
+ */
+constexpr refine_config_t fit_config {
+    .max_iterations = 20,
+    .tolerance = 0.01, // 1 cm
+    .lambda = 1e-3,
+};
+
+constexpr robust_config_t robust_config {
+    .max_iterations = CONFIG_IMF_MLAT_ROBUST_MAX_ITERATIONS,
+    .inlier_threshold = CONFIG_IMF_MLAT_ROBUST_INLIER_THRESHOLD_CM * distance_scale,
+    .consensus = 0.8,
+};
+
+/**
+ * @brief Older distances get lower weight in least squares, distances past horizon are not used
+ */
+constexpr distance_aging_t distance_aging {
+    .sigma_cm = CONFIG_IMF_MLAT_DISTANCE_SIGMA_CM,
+    .speed_cm_s = CONFIG_IMF_MLAT_AGING_SPEED_CM_S,
+    .horizon = pdMS_TO_TICKS(CONFIG_IMF_MLAT_AGING_HORIZON_MS),
+};
+
+/**
+ * @brief Usefulness of anchors for DistanceMeter scheduling, anchors used in the last fix have usefulness 1
+ */
+constexpr float spare_usefulness = 0.5; // usable anchor that is not among the closest anchors
+constexpr float outlier_usefulness = 0.25; // anchor rejected as inconsistent with others
 
 MlatLocalization::MlatLocalization(std::shared_ptr<Device> this_device, std::vector<std::shared_ptr<Device>> stations)
-    : _this_device(this_device){
+    : _this_device(this_device), _publisher(this_device), _stats(TAG), _station_index(search_radius_cm, index_max_cells),
+      _search_radius_cm(search_radius_cm), _tracker(tracker_config){
     for(size_t i = 0; i < stations.size(); i++){
         _stations.emplace(stations[i]->id, stations[i]);
     }
+    // every station can become an anchor, reserve space so that tick() does not allocate
+    _anchors.reserve(_stations.size());
+    _station_table.reserve(_stations.size());
+    _candidates.reserve(_stations.size());
+    _previous_candidates.reserve(_stations.size());
+    _index_locations.reserve(_stations.size());
+    _index_known.reserve(_stations.size());
+    // distance events of every station fit, so notify() does not allocate in the event loop
+    _trigger.reserve(_stations.size());
+    for(auto && [id,station] : _stations){
+        _station_table.push_back({id, station, {0,0,0,0,0}, {0,0,0}, false});
+    }
+    _mutex = xSemaphoreCreateMutex();
+}
+
+void MlatLocalization::refreshStationTable(){
+    const uint32_t version = Device::stationLocationVersion();
+    if(_station_table_complete && version == _station_table_version){
+        return;
+    }
+    // locations are cached by devices, serial requests are sent only for unknown ones
+    bool complete = true;
+    for(auto && entry : _station_table){
+        entry.known = entry.station->getLocation(entry.location) == ESP_OK;
+        if(!entry.known){
+            complete = false;
+            continue;
+        }
+        locationToPos(entry.location, entry.pos);
+    }
+    _station_table_version = version;
+    _station_table_complete = complete;
+
+    if(_station_table.size() >= index_min_stations){
+        _index_locations.clear();
+        _index_known.clear();
+        for(auto && entry : _station_table){
+            // stations with unusable location are skipped by tick() anyway
+            _index_locations.push_back(entry.location);
+            _index_known.push_back(entry.known && entry.location.uncertainty < std::numeric_limits<uint16_t>::max()/2);
+        }
+        _station_index.build(_index_locations, _index_known);
+        LOGGER_I(TAG, "station index built for %d stations", _station_index.size());
+    }
+}
+
+void MlatLocalization::selectCandidates(){
+    position_t last_pos;
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    const bool last_pos_valid = predictPosition(last_pos);
+    xSemaphoreGive(_mutex);
+
+    _candidates.clear();
+    if(!last_pos_valid || _search_radius_cm == 0 || _station_index.size() == 0){
+        for(size_t i = 0; i < _station_table.size(); i++){
+            _candidates.push_back(i);
+        }
+    } else{
+        _station_index.query(last_pos.x * pos_scale, last_pos.y * pos_scale, _search_radius_cm, _candidates);
+        std::sort(_candidates.begin(), _candidates.end());
+        TICK_LOG(TAG, "%d of %d stations within %" PRId32 " cm", _candidates.size(), _station_table.size(), _search_radius_cm);
+    }
+
+    // only stations in the search area are measured
+    auto candidate = _candidates.begin();
+    for(auto && index : _previous_candidates){
+        while(candidate != _candidates.end() && *candidate < index){
+            candidate++;
+        }
+        if(candidate == _candidates.end() || *candidate != index){
+            _station_table[index].station->setDistanceMeasurement(false);
+        }
+    }
+    _previous_candidates.assign(_candidates.begin(), _candidates.end());
+}
+
+void MlatLocalization::updateSearchRadius(size_t anchors){
+    if(_station_index.size() == 0){
+        return;
+    }
+    if(anchors < selection_config.min_anchors && _search_radius_cm != 0){
+        _search_radius_cm *= 2;
+        if(_search_radius_cm > max_search_radius_cm){
+            _search_radius_cm = 0;
+        }
+        LOGGER_I(TAG, "%d anchors, search radius widened to %" PRId32 " cm", anchors, _search_radius_cm);
+    } else if(anchors > 2 * selection_config.max_anchors && _search_radius_cm != search_radius_cm){
+        _search_radius_cm = _search_radius_cm == 0 ? max_search_radius_cm : std::max(_search_radius_cm / 2, search_radius_cm);
+        LOGGER_I(TAG, "%d anchors, search radius shrunk to %" PRId32 " cm", anchors, _search_radius_cm);
+    }
 }
 bool MlatLocalization::start(){
     auto ret = xTaskCreatePinnedToCore(taskWrapper, "MlatLocalization", 1024*20, this, tskIDLE_PRIORITY+2, &_xHandle, 1);
@@ -60,96 +259,637 @@ void MlatLocalization::posToLocation(const float x, const float y, location_loca
     location.local_east  = y * pos_scale;
 }
 
+void MlatLocalization::locationToPos(const location_local_t &location, position3d_t &pos){
+    locationToPos(location, pos.x, pos.y);
+    pos.z = (float) location.local_altitude / pos_scale;
+}
+
+void MlatLocalization::posToLocation(const position3d_t &pos, uint8_t floor, location_local_t &location){
+    posToLocation(pos.x, pos.y, location);
+    location.local_altitude = pos.z * pos_scale;
+    location.floor_number = floor;
+}
+
+#if CONFIG_IMF_MLAT_FIXED_POINT
+/**
+ * @brief Least squares solution on centimetre grid using only integer arithmetic (mlat::LinearMLAT)
+ * 
+ * @param anchors_cm anchors on centimetre grid (inputs of the solution)
+ * @param anchors the same anchors in metres (only for covariance of the solution)
+ */
+static solution_t solve_fixed_point(std::span<const anchor_cm_t> anchors_cm, std::span<const anchor_t> anchors){
+    auto result = LinearMLAT<int16_t>::solve(anchors_cm);
+    solution_t solution{};
+    solution.pos.x = (float) result.pos.x / pos_scale;
+    solution.pos.y = (float) result.pos.y / pos_scale;
+    solution.error = (float) result.error / pos_scale;
+    solution.valid = result.valid;
+    if(solution.valid){
+        solution.covariance = MLAT::covariance(anchors, solution.pos);
+    }
+    return solution;
+}
+#endif
+
+/**
+ * @brief Order stations by position (stable order of anchors maps to the same cached factorization)
+ */
+static bool position_less(const position3d_t& a, const position3d_t& b){
+    if(a.x != b.x) return a.x < b.x;
+    if(a.y != b.y) return a.y < b.y;
+    return a.z < b.z;
+}
+
 static inline float distance_2d(const position_t pos1, const position_t pos2){
   return sqrt(  pow(pos1.x - pos2.x, 2) 
               + pow(pos1.y - pos2.y, 2));
 }
 
+/**
+ * @brief Covariance of solution position (in m^2)
+ * 
+ * Position covariance is scaled by expected variance of distances, 
+ * or by variance of distance residuals if they are larger.
+ */
+static covariance_t solution_covariance(const solution_t& solution){
+    const float sigma = std::max(distance_sigma, solution.residual);
+    const float variance = sigma * sigma;
+    return {solution.covariance.xx * variance, solution.covariance.xy * variance, solution.covariance.yy * variance};
+}
+
+/**
+ * @brief Uncertainty in cm (standard deviation of position) given covariance in m^2
+ */
+static uint16_t covariance_uncertainty(const covariance_t& covariance){
+    const float variance = covariance.xx + covariance.yy;
+    const float uncertainty = std::sqrt(std::max(variance, 0.0f)) * pos_scale;
+    constexpr float uncertainty_max = std::numeric_limits<uint16_t>::max();
+    if(!(uncertainty < uncertainty_max)){
+        // position is not determined by the anchors
+        return std::numeric_limits<uint16_t>::max();
+    }
+    return (uint16_t) uncertainty;
+}
+
+solution_t MlatLocalization::refineSolution(std::span<const anchor_t> anchors, std::span<const float> weights, solution_t solution){
+    if(refine_config.max_iterations > 0){
+        // warm start from predicted position unless the new least squares estimate fits better
+        position_t initial = solution.pos;
+        position_t predicted;
+        xSemaphoreTake(_mutex, portMAX_DELAY);
+        const bool predicted_valid = predictPosition(predicted);
+        xSemaphoreGive(_mutex);
+        if(predicted_valid && MLAT::cost(anchors, weights, predicted) < MLAT::cost(anchors, weights, initial)){
+            initial = predicted;
+        }
+        solution = MLAT::refine(anchors, weights, initial, refine_config);
+        TICK_LOG(TAG, "refined pos x=%f,y=%f,residual=%f,iterations=%" PRIu16, solution.pos.x, solution.pos.y, 
+            solution.residual, solution.iterations);
+    } else if(!weights.empty() && solution.valid){
+        // old distances still make the position less certain
+        solution.covariance = MLAT::covariance(anchors, weights, solution.pos);
+    }
+    return solution;
+}
+
+/**
+ * @brief Time between ticks in seconds
+ */
+static inline float elapsed_seconds(TickType_t from, TickType_t to){
+    return (float)((to - from) * portTICK_PERIOD_MS) / 1000.0f;
+}
+
+track_t MlatLocalization::trackSolution(const solution_t& solution){
+    const TickType_t now = xTaskGetTickCount();
+    const float dt = elapsed_seconds(_track_time, now);
+    if(dt > max_prediction_time){
+        // track is too old to predict anything
+        _tracker.reset();
+    }
+    track_t track = _tracker.update(solution.pos, solution_covariance(solution), dt);
+    _track_time = now;
+    if(track.rejected){
+        LOGGER_I(TAG, "fix x=%f,y=%f rejected by tracker", solution.pos.x, solution.pos.y);
+    }
+    TICK_LOG(TAG, "tracked pos x=%f,y=%f,v=(%f,%f)", track.pos.x, track.pos.y, track.velocity.x, track.velocity.y);
+    return track;
+}
+
+bool MlatLocalization::predictPosition(position_t &pos){
+    if(!_tracker.initialized()){
+        return false;
+    }
+    const float dt = elapsed_seconds(_track_time, xTaskGetTickCount());
+    if(dt > max_prediction_time){
+        return false;
+    }
+    pos = _tracker.predict(dt).pos;
+    return true;
+}
+
+/**
+ * @brief Covariance (per unit variance of distances) of a point on the circle of a single anchor
+ * 
+ * Distance determines only the radial direction, position along the circle is unknown.
+ */
+static covariance_t single_anchor_covariance(const anchor_t& anchor, position_t pos){
+    const float dx = pos.x - anchor.pos.x;
+    const float dy = pos.y - anchor.pos.y;
+    const float dist = std::sqrt(dx*dx + dy*dy);
+    if(dist < 1e-3f){
+        return {undetermined_variance, 0, undetermined_variance};
+    }
+    const float ux = dx / dist;
+    const float uy = dy / dist;
+    // radial variance 1, tangential variance undetermined_variance
+    return {ux*ux + uy*uy*undetermined_variance, 
+            ux*uy*(1 - undetermined_variance), 
+            uy*uy + ux*ux*undetermined_variance};
+}
+
+track_t MlatLocalization::solveAmbiguous(std::span<const anchor_t> anchors){
+    solution_t solution{};
+    position_t predicted;
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    const bool predicted_valid = predictPosition(predicted);
+    xSemaphoreGive(_mutex);
+    if(!predicted_valid){
+        // no motion history, pick any of possible positions
+        if(anchors.size() == 2){
+            double_solution_t solutions = MLAT::solve_two_anchors(anchors[0], anchors[1]);
+            solution.pos = solutions.pos1;
+            if(!solutions.valid){
+                // circles do not intersect, start from point between anchors in ratio of distances
+                const float ratio = anchors[0].distance / std::max(anchors[0].distance + anchors[1].distance, 1e-3f);
+                const position_t between {anchors[0].pos.x + (anchors[1].pos.x - anchors[0].pos.x) * ratio,
+                                          anchors[0].pos.y + (anchors[1].pos.y - anchors[0].pos.y) * ratio};
+                solution.pos = MLAT::refine(anchors, between, fit_config).pos;
+            }
+            solution.covariance = MLAT::covariance(anchors, solution.pos);
+        } else {
+            solution.pos = MLAT::solve_single_anchor(anchors[0], 0.0);
+            solution.covariance = single_anchor_covariance(anchors[0], solution.pos);
+        }
+        // position is not tracked, it could be the wrong mirror point
+        track_t track{};
+        track.pos = solution.pos;
+        track.covariance = solution_covariance(solution);
+        track.valid = true;
+        return track;
+    }
+
+    if(anchors.size() == 2){
+        double_solution_t solutions = MLAT::solve_two_anchors(anchors[0], anchors[1]);
+        if(solutions.valid){
+            // mirror point closer to predicted position
+            solution.pos = distance_2d(solutions.pos1, predicted) <= distance_2d(solutions.pos2, predicted) 
+                ? solutions.pos1 : solutions.pos2;
+        } else {
+            // circles do not intersect (measurement error), find best fit near predicted position
+            solution.pos = MLAT::refine(anchors, predicted, fit_config).pos;
+        }
+        solution.covariance = MLAT::covariance(anchors, solution.pos);
+        if(!std::isfinite(solution.covariance.xx) || !std::isfinite(solution.covariance.yy)){
+            // position lies on the line through anchors, only distance along it is known
+            solution.covariance = {undetermined_variance, 0, undetermined_variance};
+        }
+    } else {
+        // point of the circle closest to predicted position
+        const float angle = std::atan2(predicted.y - anchors[0].pos.y, predicted.x - anchors[0].pos.x);
+        solution.pos = MLAT::solve_single_anchor(anchors[0], angle * 180.0f / std::numbers::pi_v<float>);
+        solution.covariance = single_anchor_covariance(anchors[0], solution.pos);
+    }
+    solution.valid = true;
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    track_t track = trackSolution(solution);
+    xSemaphoreGive(_mutex);
+    return track;
+}
+
+void MlatLocalization::distanceUpdated(uint32_t station_id, const distance_measurement_t &measurement){
+    _trigger.notify(station_id);
+    if(xSemaphoreTake(_mutex, 100 / portTICK_PERIOD_MS) != pdTRUE){
+        return;
+    }
+    bool incremental = false;
+    const size_t count = _incremental.anchors().size();
+    for(size_t i = 0; i < count; i++){
+        if(_incremental_ids[i] == station_id){
+            _incremental_distances[i] = (float)measurement.distance_cm * distance_scale;
+            _incremental_pending |= 1u << i;
+            incremental = true;
+            break;
+        }
+    }
+    xSemaphoreGive(_mutex);
+    if(incremental){
+        // solving is left to localization task, event loop of DistanceMeter is not blocked
+        _trigger.wake();
+    }
+}
+
+void MlatLocalization::updateIncremental(){
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    const uint32_t pending = _incremental_pending;
+    const std::array<float, max_anchors> distances = _incremental_distances;
+    _incremental_pending = 0;
+    position_t reference;
+    const bool predicted = predictPosition(reference);
+    xSemaphoreGive(_mutex);
+    solution_t solution = _incremental.solution();
+    if(pending == 0 || !solution.valid){
+        return;
+    }
+    if(!predicted){
+        reference = solution.pos;
+    }
+
+    // _incremental is changed only by this task (tick() and here)
+    bool updated = false;
+    const float altitude = _altitude;
+    const uint8_t floor = _floor;
+    auto anchors = _incremental.anchors();
+    for(size_t i = 0; i < anchors.size(); i++){
+        if(!(pending & (1u << i))) continue;
+        const anchor3d_t anchor3d {{anchors[i].pos.x, anchors[i].pos.y, _incremental_z[i]}, distances[i]};
+        const float distance = MLAT::project(anchor3d, altitude).distance;
+        // same criterion as outlier rejection of tick(), suspicious distance waits for the full solve
+        const float residual = std::abs(distance_2d(reference, anchors[i].pos) - distance);
+        if(residual > robust_config.inlier_threshold){
+            TICK_LOG(TAG, "incremental distance of station %" PRIu32 " rejected (d=%f, residual %f)", _incremental_ids[i], distance, residual);
+            continue;
+        }
+        solution = _incremental.update(i, distance);
+        _incremental_weights[i] = 1;
+        updated = true;
+    }
+    if(!updated){
+        return;
+    }
+
+    std::span<const float> weights(_incremental_weights.data(), anchors.size());
+    solution = refineSolution(anchors, weights, solution);
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    track_t track = trackSolution(solution);
+    xSemaphoreGive(_mutex);
+    TICK_LOG(TAG, "incremental pos x=%f,y=%f", solution.pos.x, solution.pos.y);
+    location_local_t new_location{0,0,0,0,0};
+    posToLocation({track.pos.x, track.pos.y, altitude}, floor, new_location);
+    new_location.uncertainty = covariance_uncertainty(track.covariance);
+    _publisher.publish(new_location);
+}
+
+void MlatLocalization::updateAltitude(std::span<const station_anchor_t> anchors){
+    uint8_t min_floor = UINT8_MAX;
+    uint8_t max_floor = 0;
+    float min_z = std::numeric_limits<float>::max();
+    float max_z = std::numeric_limits<float>::lowest();
+    const station_anchor_t* closest = &anchors[0];
+    for(auto && station : anchors){
+        min_floor = std::min(min_floor, station.floor);
+        max_floor = std::max(max_floor, station.floor);
+        min_z = std::min(min_z, station.anchor3d.pos.z);
+        max_z = std::max(max_z, station.anchor3d.pos.z);
+        if(station.anchor3d.distance < closest->anchor3d.distance){
+            closest = &station;
+        }
+    }
+
+    // without vertical information keep last altitude (or altitude of the closest station)
+    position3d_t pos {0, 0, _altitude_valid ? _altitude : closest->anchor3d.pos.z};
+    if(anchors.size() >= anchor_traits<anchor3d_t>::min_anchors && max_z - min_z >= min_vertical_spread){
+        std::array<station_anchor_t, max_anchors> closest_buffer;
+        auto closest_end = std::partial_sort_copy(anchors.begin(), anchors.end(), closest_buffer.begin(), closest_buffer.end(), 
+                                  [](const station_anchor_t& a, const station_anchor_t& b)
+                                  {
+                                      return a.anchor3d.distance < b.anchor3d.distance;
+                                  });
+        std::sort(closest_buffer.begin() + 1, closest_end, [](const station_anchor_t& a, const station_anchor_t& b)
+                                  {
+                                      return position_less(a.anchor3d.pos, b.anchor3d.pos);
+                                  });
+        std::array<anchor3d_t, max_anchors> anchors_buffer;
+        const size_t count = closest_end - closest_buffer.begin();
+        for(size_t i = 0; i < count; i++){
+            anchors_buffer[i] = closest_buffer[i].anchor3d;
+        }
+        solution3d_t solution = _solver3d.solve(std::span<const anchor3d_t>(anchors_buffer.data(), count));
+        if(solution.valid){
+            TICK_LOG(TAG, "3D pos x=%f,y=%f,z=%f,err=%f", solution.pos.x, solution.pos.y, solution.pos.z, solution.error);
+            pos.z = solution.pos.z;
+        }
+    }
+    // device cannot be on a floor without any reachable station
+    const uint8_t floor = MLAT::snap_to_floor(pos, floor_height, min_floor, max_floor);
+    TICK_LOG(TAG, "altitude z=%f, floor %" PRIu8, pos.z, floor);
+
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    _altitude = pos.z;
+    _altitude_valid = true;
+    _floor = floor;
+    _floor_valid = true;
+    xSemaphoreGive(_mutex);
+}
+
+void MlatLocalization::selectAnchors(std::vector<station_anchor_t>& anchors){
+    position_t last_pos;
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    const bool last_pos_valid = predictPosition(last_pos);
+    xSemaphoreGive(_mutex);
+
+    _ticks_since_full_scan++;
+    const bool full_scan = _ticks_since_full_scan >= full_scan_interval;
+    if(!last_pos_valid || full_scan || anchors.size() <= selection_config.min_anchors){
+        // without position (or with only a few stations) all stations are worth measuring
+        for(auto && station : anchors){
+            _stations.at(station.id)->setDistanceMeasurement(true);
+        }
+        if(full_scan){
+            _ticks_since_full_scan = 0;
+        }
+        return;
+    }
+
+    std::array<position_t, selection_candidates> positions;
+    const size_t count = std::min(anchors.size(), positions.size());
+    if(anchors.size() > count){
+        // selection mask has only 32 bits, choose from the stations closest to the last position
+        std::nth_element(anchors.begin(), anchors.begin() + count, anchors.end(), 
+                         [&last_pos](const station_anchor_t& a, const station_anchor_t& b)
+                         {
+                             return distance_2d({a.anchor3d.pos.x, a.anchor3d.pos.y}, last_pos) 
+                                  < distance_2d({b.anchor3d.pos.x, b.anchor3d.pos.y}, last_pos);
+                         });
+    }
+    for(size_t i = 0; i < count; i++){
+        positions[i] = {anchors[i].anchor3d.pos.x, anchors[i].anchor3d.pos.y};
+    }
+    anchor_selection_t selection = MLAT::select_anchors(std::span<const position_t>(positions.data(), count), last_pos, selection_config);
+    TICK_LOG(TAG, "selected %d of %d anchors, GDOP %f", std::popcount(selection.selected), anchors.size(), selection.gdop);
+
+    // only selected stations are measured until the next full scan
+    size_t kept = 0;
+    for(size_t i = 0; i < anchors.size(); i++){
+        const bool selected = i < count && (selection.selected & (1u << i));
+        _stations.at(anchors[i].id)->setDistanceMeasurement(selected);
+        if(selected){
+            anchors[kept++] = anchors[i];
+        }
+    }
+    anchors.resize(kept);
+}
+
 void MlatLocalization::tick(TickType_t diff){
     location_local_t new_location{0,0,0,0,0};
-    std::vector<anchor_t> anchors;
-    for(auto && [id,station] : _stations){
-        location_local_t location;
+    std::vector<station_anchor_t>& anchors = _anchors;
+    anchors.clear();
+    size_t skipped_floors = 0;
+    const TickType_t now = xTaskGetTickCount();
+    _stats.begin();
+    refreshStationTable();
+    selectCandidates();
+    _stats.skip(SkipReason::OutOfRange, _station_table.size() - _candidates.size());
+    for(auto && index : _candidates){
+        station_entry_t& entry = _station_table[index];
+        const uint32_t id = entry.id;
+        const std::shared_ptr<Device>& station = entry.station;
+        const location_local_t& location = entry.location;
         distance_log_t dist_log;
         esp_err_t err;
         
-        err = station->getLocation(location);
-        if(err != ESP_OK){
-            LOGGER_I(TAG, "skip id %" PRIu32 ", no location", id);
+        if(!entry.known){
+            TICK_LOG(TAG, "skip id %" PRIu32 ", no location", id);
+            _stats.skip(SkipReason::NoLocation);
             continue;
         }
         if(location.uncertainty >= std::numeric_limits<uint16_t>::max()/2){
-            LOGGER_I(TAG, "skip id %" PRIu32 ", high uncertainty");
+            TICK_LOG(TAG, "skip id %" PRIu32 ", high uncertainty", id);
+            _stats.skip(SkipReason::HighUncertainty);
+            continue;
+        }
+
+        if(_floor_valid && abs((int) location.floor_number - (int) _floor) > 1){
+            // station on a non-adjacent floor is unreachable, do not waste FTM sessions on it
+            TICK_LOG(TAG, "skip id %" PRIu32 ", floor %" PRIu8, id, location.floor_number);
+            _stats.skip(SkipReason::OtherFloor);
+            station->setDistanceMeasurement(false);
+            skipped_floors++;
             continue;
         }
 
         err = station->lastDistance(dist_log);
         if(err != ESP_OK){
-            LOGGER_I(TAG, "skip id %" PRIu32 ", no distance", id);
+            TICK_LOG(TAG, "skip id %" PRIu32 ", no distance", id);
+            _stats.skip(SkipReason::NoDistance);
+            // station was never measured, measure it so that it can be selected
+            station->setDistanceMeasurement(true);
+            station->setDistanceUsefulness(1);
+            continue;
+        }
+
+        if(distance_log_expired(dist_log, now, distance_aging)){
+            TICK_LOG(TAG, "skip id %" PRIu32 ", distance too old", id);
+            _stats.skip(SkipReason::TooOld);
+            // measure it again so that it can be used
+            station->setDistanceMeasurement(true);
+            station->setDistanceUsefulness(1);
             continue;
         }
+        const float sigma = distance_log_sigma(dist_log, now, distance_aging);
+        const float weight = (distance_aging.sigma_cm * distance_aging.sigma_cm) / (sigma * sigma);
 
         float distance = (float)dist_log.measurement.distance_cm * distance_scale;
-        float x,y;
-        locationToPos(location, x, y);
-        LOGGER_I(TAG, "id %" PRIu32 " distance %" PRIu32 "(%f, RSSI %" PRId8 ") pos=x%f,y%f", id, dist_log.measurement.distance_cm, 
-            distance, dist_log.measurement.rssi, x, y);
-        anchors.emplace_back((position_t){x,y}, distance);
+        const position3d_t& pos = entry.pos;
+        TICK_LOG(TAG, "id %" PRIu32 " distance %" PRIu32 "(%f, RSSI %" PRId8 ", weight %f) pos=x%f,y%f,z%f,floor%" PRIu8, id, dist_log.measurement.distance_cm, 
+            distance, dist_log.measurement.rssi, weight, pos.x, pos.y, pos.z, location.floor_number);
+        const int16_t distance_cm = (int16_t) std::min<uint32_t>(dist_log.measurement.distance_cm, std::numeric_limits<int16_t>::max());
+        const anchor_cm_t anchor_cm {{location.local_north, location.local_east}, distance_cm};
+        anchors.push_back({id, (anchor_t){}, (anchor3d_t){pos, distance}, location.floor_number, anchor_cm, location.local_altitude, weight});
     }
 
-    LOGGER_I(TAG, "Anchors (%d):", anchors.size());
-    for(auto && anchor : anchors){
-        LOGGER_I(TAG, "-> x=%f,y=%f,d=%f", anchor.pos.x, anchor.pos.y, anchor.distance);
+    updateSearchRadius(anchors.size());
+    if(anchors.empty() && skipped_floors > 0){
+        // floor changed too much (or was wrong), measure all stations again in next tick
+        _floor_valid = false;
+    }
+    const size_t available_anchors = anchors.size();
+    selectAnchors(anchors);
+    _stats.skip(SkipReason::Unselected, available_anchors - anchors.size());
+    if(!anchors.empty()){
+        updateAltitude(anchors);
+        // solve horizontal position with distances projected to altitude of this device
+        const int16_t altitude_cm = std::lround(_altitude * pos_scale);
+        for(auto && station : anchors){
+            station.anchor = MLAT::project(station.anchor3d, _altitude);
+            station.anchor_cm.distance = LinearMLAT<int16_t>::project(station.anchor_cm.distance, station.altitude_cm - altitude_cm);
+        }
+    }
+
+    TICK_LOG(TAG, "Anchors (%d):", anchors.size());
+    for(auto && station : anchors){
+        TICK_LOG(TAG, "-> x=%f,y=%f,d=%f", station.anchor.pos.x, station.anchor.pos.y, station.anchor.distance);
+    }
+
+    if(anchors.size() < 3){
+        // anchors of last tick are no longer usable for incremental updates
+        xSemaphoreTake(_mutex, portMAX_DELAY);
+        _incremental.reset({});
+        _incremental_pending = 0;
+        xSemaphoreGive(_mutex);
     }
 
     // perform multilateration according to number of anchors
+    LocalizationBranch branch = LocalizationBranch::NoFix;
+    size_t used_anchors = 0;
     if(anchors.size() >= 3){
+        for(auto && station : anchors){
+            _stations.at(station.id)->setDistanceUsefulness(spare_usefulness);
+        }
         // use only x closest distances (closer distances are generally more accurate)
-        std::sort(anchors.begin(), anchors.end(), [](anchor_t a, anchor_t b)
+        std::array<station_anchor_t, closest_anchors_limit> closest_buffer;
+        auto closest_end = std::partial_sort_copy(anchors.begin(), anchors.end(), closest_buffer.begin(), closest_buffer.end(), 
+                                  [](const station_anchor_t& a, const station_anchor_t& b)
                                   {
-                                      return a.distance < b.distance;
+                                      return a.anchor.distance < b.anchor.distance;
                                   });
-        std::vector<anchor_t> closest_anchors;
-        for(auto && anchor : anchors){
-            closest_anchors.push_back(anchor);
-            if(closest_anchors.size() >= closest_anchors_limit){
-                break;
+        // closest anchor stays as the reference, others are ordered by position so that
+        // the same set of stations maps to the same cached factorization in _solver
+        std::sort(closest_buffer.begin() + 1, closest_end, [](const station_anchor_t& a, const station_anchor_t& b)
+                                  {
+                                      return position_less(a.anchor3d.pos, b.anchor3d.pos);
+                                  });
+        std::array<anchor_t, closest_anchors_limit> closest_anchors_buffer;
+        std::array<float, closest_anchors_limit> closest_weights_buffer;
+        size_t closest_count = closest_end - closest_buffer.begin();
+        for(size_t i = 0; i < closest_count; i++){
+            closest_anchors_buffer[i] = closest_buffer[i].anchor;
+            closest_weights_buffer[i] = closest_buffer[i].weight;
+        }
+        if(robust_config.max_iterations > 0 && closest_count > 3){
+            // drop anchors with distances inconsistent with the rest (e.g. NLOS measurements)
+            robust_solution_t robust = MLAT::solve_robust(std::span<const anchor_t>(closest_anchors_buffer.data(), closest_count), robust_config);
+            // least squares needs at least 3 anchors, otherwise keep all of them
+            if(closest_count - std::popcount(robust.rejected) >= 3){
+                size_t kept = 0;
+                for(size_t i = 0; i < closest_count; i++){
+                    if(robust.rejected & (1u << i)){
+                        _stats.skip(SkipReason::Outlier);
+                        _stations.at(closest_buffer[i].id)->setDistanceUsefulness(outlier_usefulness);
+                        TICK_LOG(TAG, "rejected anchor id %" PRIu32 " (d=%f)", closest_buffer[i].id, closest_buffer[i].anchor.distance);
+                        continue;
+                    }
+                    closest_buffer[kept] = closest_buffer[i];
+                    closest_anchors_buffer[kept] = closest_anchors_buffer[i];
+                    closest_weights_buffer[kept] = closest_weights_buffer[i];
+                    kept++;
+                }
+                closest_count = kept;
             }
         }
-        LOGGER_I(TAG, "Closest anchors (%d):", closest_anchors.size());
+        for(size_t i = 0; i < closest_count; i++){
+            _stations.at(closest_buffer[i].id)->setDistanceUsefulness(1);
+        }
+        std::span<const anchor_t> closest_anchors(closest_anchors_buffer.data(), closest_count);
+        std::span<const float> closest_weights(closest_weights_buffer.data(), closest_count);
+        TICK_LOG(TAG, "Closest anchors (%d):", closest_anchors.size());
         for(auto && anchor : closest_anchors){
-            LOGGER_I(TAG, "-> x=%f,y=%f,d=%f", anchor.pos.x, anchor.pos.y, anchor.distance);
+            TICK_LOG(TAG, "-> x=%f,y=%f,d=%f", anchor.pos.x, anchor.pos.y, anchor.distance);
         }
-        solution_t solution = MLAT::solve(closest_anchors);
-        LOGGER_I(TAG, "resulting pos x=%f,y=%f,err=%f", solution.pos.x, solution.pos.y, solution.error);
-        posToLocation(solution.pos.x, solution.pos.y, new_location);
-        new_location.uncertainty = (uint16_t) abs(solution.error);
-    }
-    else if(anchors.size() == 2){
-        double_solution_t solutions = MLAT::solve_two_anchors(anchors[0], anchors[1]);
-        LOGGER_I(TAG, "resulting pos x=%f,y=%f", solutions.pos1.x, solutions.pos1.y);
-        posToLocation(solutions.pos1.x, solutions.pos1.y, new_location);
-        new_location.uncertainty = (uint16_t) distance_2d(solutions.pos1, solutions.pos2);
+#if CONFIG_IMF_MLAT_FIXED_POINT
+        // inputs come from the station table and distance log in cm, not from the float anchors
+        std::array<anchor_cm_t, closest_anchors_limit> closest_anchors_cm;
+        for(size_t i = 0; i < closest_count; i++){
+            closest_anchors_cm[i] = closest_buffer[i].anchor_cm;
+        }
+        solution_t solution = solve_fixed_point(std::span<const anchor_cm_t>(closest_anchors_cm.data(), closest_count), closest_anchors);
+        if(!solution.valid){
+            // collinear anchors, fall back to minimal norm solution
+            solution = _solver.solve(closest_anchors);
+        }
+#else
+        solution_t solution = _solver.solve(closest_anchors);
+#endif
+        TICK_LOG(TAG, "least squares pos x=%f,y=%f,err=%f,cov=(%f,%f,%f)", solution.pos.x, solution.pos.y, solution.error,
+            solution.covariance.xx, solution.covariance.xy, solution.covariance.yy);
+
+        xSemaphoreTake(_mutex, portMAX_DELAY);
+        // keep inlier anchors so that distanceUpdated() can update position without solving the whole system
+        _incremental_pending = 0;
+        if(_incremental.reset(closest_anchors)){
+            for(size_t i = 0; i < closest_count; i++){
+                _incremental_ids[i] = closest_buffer[i].id;
+                _incremental_z[i] = closest_buffer[i].anchor3d.pos.z;
+                _incremental_weights[i] = closest_buffer[i].weight;
+            }
+        }
+        xSemaphoreGive(_mutex);
+        // linear solution uses cached factorization of equally weighted anchors, age is accounted for in refinement
+        solution = refineSolution(closest_anchors, closest_weights, solution);
+        xSemaphoreTake(_mutex, portMAX_DELAY);
+        track_t track = trackSolution(solution);
+        xSemaphoreGive(_mutex);
+        if(solution.valid){
+            _stats.residual(std::sqrt(MLAT::cost(closest_anchors, solution.pos) / closest_count));
+        }
+        branch = LocalizationBranch::Multilateration;
+        used_anchors = closest_count;
+
+        posToLocation({track.pos.x, track.pos.y, _altitude}, _floor, new_location);
+        new_location.uncertainty = covariance_uncertainty(track.covariance);
     }
-    else if(anchors.size() == 1){
-        position_t pos = MLAT::solve_single_anchor(anchors[0], 0.0);
-        LOGGER_I(TAG, "resulting pos x=%f,y=%f", pos.x, pos.y);
-        posToLocation(pos.x, pos.y, new_location);
-        new_location.uncertainty = 0;
+    else if(anchors.size() == 2 || anchors.size() == 1){
+        std::array<anchor_t, 2> ambiguous_anchors;
+        for(size_t i = 0; i < anchors.size(); i++){
+            ambiguous_anchors[i] = anchors[i].anchor;
+            _stations.at(anchors[i].id)->setDistanceUsefulness(1);
+        }
+        track_t track = solveAmbiguous(std::span<const anchor_t>(ambiguous_anchors.data(), anchors.size()));
+        TICK_LOG(TAG, "resulting pos x=%f,y=%f (%d anchors)", track.pos.x, track.pos.y, anchors.size());
+        branch = anchors.size() == 2 ? LocalizationBranch::TwoAnchors : LocalizationBranch::OneAnchor;
+        used_anchors = anchors.size();
+        posToLocation({track.pos.x, track.pos.y, _altitude}, _floor, new_location);
+        new_location.uncertainty = covariance_uncertainty(track.covariance);
     }
     else{
-        new_location.local_north = 0;
-        new_location.local_east  = 0;
-        new_location.uncertainty = 0;
-        LOGGER_I(TAG, "no anchors, setting pos to x=0,y=0");
+        xSemaphoreTake(_mutex, portMAX_DELAY);
+        const float dt = elapsed_seconds(_track_time, xTaskGetTickCount());
+        track_t track = (_tracker.initialized() && dt <= max_prediction_time) ? _tracker.predict(dt) : track_t{};
+        xSemaphoreGive(_mutex);
+        if(track.valid){
+            // keep moving along the track, uncertainty grows with time
+            TICK_LOG(TAG, "no anchors, predicted pos x=%f,y=%f", track.pos.x, track.pos.y);
+            branch = LocalizationBranch::Predicted;
+            posToLocation({track.pos.x, track.pos.y, _altitude}, _floor, new_location);
+            new_location.uncertainty = covariance_uncertainty(track.covariance);
+        } else {
+            new_location.local_north = 0;
+            new_location.local_east  = 0;
+            new_location.uncertainty = 0;
+            TICK_LOG(TAG, "no anchors, setting pos to x=0,y=0");
+        }
     }
-    _this_device->setLocation(new_location);
+    _stats.end(branch, used_anchors);
+    _publisher.publish(new_location);
+}
+
+esp_err_t MlatLocalization::getStats(localization_stats_t &stats){
+    stats = _stats.stats();
+    return ESP_OK;
 }
 
 void MlatLocalization::task(){
+    TickType_t last_tick = xTaskGetTickCount();
     while(true){
-        tick(2000 / portTICK_PERIOD_MS);
-        vTaskDelay(2000 / portTICK_PERIOD_MS);
+        // sleep until enough stations have new distances (or idle timeout), distance of an anchor wakes it earlier
+        bool woken;
+        _trigger.wait(last_tick, woken);
+        if(woken){
+            updateIncremental();
+            continue;
+        }
+        const TickType_t now = xTaskGetTickCount();
+        tick(now - last_tick);
+        last_tick = now;
     }
     vTaskDelete(_xHandle);
 }
\ No newline at end of file
@@ -0,0 +1,160 @@
+/**
+ * @file particle_localization.cpp
+ * @author Daniel Kurek (daniel.kurek.dev@gmail.com)
+ * @brief Implementation of @ref particle_localization.hpp
+ * @version 0.1
+ * @date 2024-05-02
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "particle_localization.hpp"
+#include "mlat_localization.hpp"
+#include "logger.h"
+#include <cmath>
+#include <algorithm>
+#include <limits>
+
+using namespace imf;
+using namespace mlat;
+
+static const char* TAG = "PF_LOC";
+
+constexpr float distance_scale = 1.0/100.0; // cm to m
+
+constexpr int pos_scale = 100;
+
+constexpr particle_config_t particle_config {
+    .motion_sigma = 0.7, // walking person
+    .distance_sigma = CONFIG_IMF_MLAT_DISTANCE_SIGMA_CM * distance_scale,
+    .outlier_distance = CONFIG_IMF_MLAT_ROBUST_INLIER_THRESHOLD_CM * distance_scale,
+    .resample_threshold = 0.5,
+};
+
+/**
+ * @brief Particles are spread this far around stations when the filter starts
+ */
+constexpr float initial_margin = 5.0; // m
+
+ParticleLocalization::ParticleLocalization(std::shared_ptr<Device> this_device, std::vector<std::shared_ptr<Device>> stations)
+    : _this_device(this_device), _filter(particle_config, this_device ? this_device->id : 1), _publisher(this_device){
+    _station_table.reserve(stations.size());
+    for(auto && station : stations){
+        _station_table.push_back({station->id, station, {0,0}, 0, false});
+    }
+    // every station can become an anchor, reserve space so that tick() does not allocate
+    _anchors.reserve(_station_table.size());
+    // distance events of every station fit, so notify() does not allocate in the event loop
+    _trigger.reserve(_station_table.size());
+}
+
+bool ParticleLocalization::start(){
+    auto ret = xTaskCreatePinnedToCore(taskWrapper, "ParticleLocalization", 1024*8, this, tskIDLE_PRIORITY+2, &_xHandle, 1);
+    if(ret != pdPASS){
+        ESP_LOGE(TAG, "Could not create Location task");
+        return false;
+    }
+    return true;
+}
+
+void ParticleLocalization::stop(){
+    if(_xHandle != NULL){
+        vTaskDelete(_xHandle);
+        _xHandle = NULL;
+    }
+}
+
+void ParticleLocalization::refreshStationTable(){
+    const uint32_t version = Device::stationLocationVersion();
+    if(_station_table_complete && version == _station_table_version){
+        return;
+    }
+    // locations are cached by devices, serial requests are sent only for unknown ones
+    bool complete = true;
+    _stations_min = {std::numeric_limits<float>::max(), std::numeric_limits<float>::max()};
+    _stations_max = {std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest()};
+    for(auto && entry : _station_table){
+        location_local_t location;
+        entry.known = entry.station->getLocation(location) == ESP_OK
+                      && location.uncertainty < std::numeric_limits<uint16_t>::max()/2;
+        if(!entry.known){
+            complete = false;
+            continue;
+        }
+        MlatLocalization::locationToPos(location, entry.pos.x, entry.pos.y);
+        _stations_min = {std::min(_stations_min.x, entry.pos.x), std::min(_stations_min.y, entry.pos.y)};
+        _stations_max = {std::max(_stations_max.x, entry.pos.x), std::max(_stations_max.y, entry.pos.y)};
+    }
+    _station_table_version = version;
+    _station_table_complete = complete;
+}
+
+void ParticleLocalization::tick(TickType_t diff){
+    std::vector<anchor_t>& anchors = _anchors;
+    anchors.clear();
+    refreshStationTable();
+    for(auto && entry : _station_table){
+        distance_log_t dist_log;
+
+        if(!entry.known){
+            TICK_LOG(TAG, "skip id %" PRIu32 ", no location", entry.id);
+            continue;
+        }
+        if(entry.station->lastDistance(dist_log) != ESP_OK){
+            TICK_LOG(TAG, "skip id %" PRIu32 ", no distance", entry.id);
+            continue;
+        }
+        if(dist_log.timestamp == entry.used_timestamp){
+            // the filter already contains this measurement
+            continue;
+        }
+        entry.used_timestamp = dist_log.timestamp;
+        const float distance = (float)dist_log.measurement.distance_cm * distance_scale;
+        TICK_LOG(TAG, "id %" PRIu32 " distance %" PRIu32 " pos=x%f,y%f", entry.id, dist_log.measurement.distance_cm, entry.pos.x, entry.pos.y);
+        anchors.push_back({entry.pos, distance});
+    }
+
+    if(!_filter.initialized()){
+        if(anchors.empty()){
+            TICK_LOG(TAG, "no anchors, waiting for first distances");
+            return;
+        }
+        // device is somewhere around stations
+        _filter.initialize({_stations_min.x - initial_margin, _stations_min.y - initial_margin}, 
+                           {_stations_max.x + initial_margin, _stations_max.y + initial_margin});
+    } else {
+        _filter.predict((float)(diff * portTICK_PERIOD_MS) / 1000.0f);
+    }
+    if(!anchors.empty()){
+        _filter.update(anchors);
+    }
+
+    track_t estimate = _filter.estimate();
+    TICK_LOG(TAG, "resulting pos x=%f,y=%f (%d new distances, %f effective particles)", estimate.pos.x, estimate.pos.y,
+        anchors.size(), _filter.effective_size());
+
+    location_local_t new_location{0,0,0,0,0};
+    // altitude and floor are not estimated, keep the last ones
+    _this_device->getLocation(new_location);
+    MlatLocalization::posToLocation(estimate.pos.x, estimate.pos.y, new_location);
+    const float uncertainty = std::sqrt(std::max(estimate.covariance.xx + estimate.covariance.yy, 0.0f)) * pos_scale;
+    new_location.uncertainty = (uint16_t) std::min(uncertainty, (float) std::numeric_limits<uint16_t>::max());
+    _publisher.publish(new_location);
+}
+
+void ParticleLocalization::distanceUpdated(uint32_t station_id, const distance_measurement_t &measurement){
+    _trigger.notify(station_id);
+}
+
+void ParticleLocalization::task(){
+    TickType_t last_tick = xTaskGetTickCount();
+    while(true){
+        // sleep until enough stations have new distances (or idle timeout)
+        _trigger.wait(last_tick);
+        const TickType_t now = xTaskGetTickCount();
+        tick(now - last_tick);
+        last_tick = now;
+    }
+    vTaskDelete(_xHandle);
+}
@@ -0,0 +1,89 @@
+/**
+ * @file station_index.cpp
+ * @author Daniel Kurek (daniel.kurek.dev@gmail.com)
+ * @brief Implementation of @ref station_index.hpp
+ * @version 0.1
+ * @date 2024-05-16
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "station_index.hpp"
+#include <algorithm>
+#include <limits>
+
+using namespace imf;
+
+StationIndex::StationIndex(int32_t cell_size_cm, size_t max_cells)
+    : _requested_cell_cm(std::max<int32_t>(cell_size_cm, 1)), _max_cells(std::max<size_t>(max_cells, 1)) {}
+
+void StationIndex::build(std::span<const location_local_t> locations, const std::vector<bool> &known){
+    _items.clear();
+    _cell_start.clear();
+    int32_t min_north = std::numeric_limits<int32_t>::max(), min_east = std::numeric_limits<int32_t>::max();
+    int32_t max_north = std::numeric_limits<int32_t>::min(), max_east = std::numeric_limits<int32_t>::min();
+    for(size_t i = 0; i < locations.size(); i++){
+        if(i >= known.size() || !known[i]) continue;
+        const item_t item {i, locations[i].local_north, locations[i].local_east};
+        min_north = std::min(min_north, item.north);
+        min_east = std::min(min_east, item.east);
+        max_north = std::max(max_north, item.north);
+        max_east = std::max(max_east, item.east);
+        _items.push_back(item);
+    }
+    if(_items.empty()){
+        _cols = _rows = 0;
+        return;
+    }
+
+    // enlarge cells until the grid fits into the limit
+    _cell_cm = _requested_cell_cm;
+    while(true){
+        _cols = (max_north - min_north) / _cell_cm + 1;
+        _rows = (max_east - min_east) / _cell_cm + 1;
+        if((size_t)_cols * _rows <= _max_cells) break;
+        _cell_cm *= 2;
+    }
+    _origin_north = min_north;
+    _origin_east = min_east;
+
+    auto cell_of = [this](const item_t& item){
+        return (uint32_t)(((item.north - _origin_north) / _cell_cm) * _rows + (item.east - _origin_east) / _cell_cm);
+    };
+    std::sort(_items.begin(), _items.end(), [&cell_of](const item_t& a, const item_t& b){ return cell_of(a) < cell_of(b); });
+    _cell_start.assign((size_t)_cols * _rows + 1, 0);
+    for(auto && item : _items){
+        _cell_start[cell_of(item) + 1]++;
+    }
+    for(size_t c = 1; c < _cell_start.size(); c++){
+        _cell_start[c] += _cell_start[c - 1];
+    }
+}
+
+size_t StationIndex::query(int32_t north_cm, int32_t east_cm, int32_t radius_cm, std::vector<size_t> &out) const{
+    if(_items.empty() || radius_cm < 0){
+        return 0;
+    }
+    const int32_t col_begin = std::max<int32_t>((north_cm - radius_cm - _origin_north) / _cell_cm - 1, 0);
+    const int32_t col_end   = std::min<int32_t>((north_cm + radius_cm - _origin_north) / _cell_cm + 1, _cols - 1);
+    const int32_t row_begin = std::max<int32_t>((east_cm - radius_cm - _origin_east) / _cell_cm - 1, 0);
+    const int32_t row_end   = std::min<int32_t>((east_cm + radius_cm - _origin_east) / _cell_cm + 1, _rows - 1);
+    const int64_t radius_sq = (int64_t)radius_cm * radius_cm;
+    size_t found = 0;
+    for(int32_t col = col_begin; col <= col_end; col++){
+        for(int32_t row = row_begin; row <= row_end; row++){
+            const size_t cell = (size_t)col * _rows + row;
+            for(uint32_t i = _cell_start[cell]; i < _cell_start[cell + 1]; i++){
+                const item_t& item = _items[i];
+                const int64_t dn = item.north - north_cm;
+                const int64_t de = item.east - east_cm;
+                if(dn*dn + de*de <= radius_sq){
+                    out.push_back(item.station);
+                    found++;
+                }
+            }
+        }
+    }
+    return found;
+}
@@ -0,0 +1,250 @@
+/**
+ * @file station_survey.cpp
+ * @author Daniel Kurek (daniel.kurek.dev@gmail.com)
+ * @brief Implementation of @ref station_survey.hpp
+ * @version 0.1
+ * @date 2024-05-14
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "station_survey.hpp"
+#include "mlat_localization.hpp"
+#include "serial_comm_client.hpp"
+#include "logger.h"
+#include <algorithm>
+#include <cstdio>
+#include <iterator>
+#include <limits>
+
+using namespace imf;
+using namespace mlat;
+
+static const char* TAG = "SURVEY";
+
+#define SURVEY_FIELD "dist"
+
+constexpr float distance_scale = 1.0/100.0; // cm to m
+
+constexpr int pos_scale = 100;
+
+constexpr survey_config_t survey_config {
+    .max_sweeps = 50,
+    .tolerance = 0.01, // 1 cm
+    .refine = {
+        .max_iterations = 20,
+        .tolerance = 0.001,
+        .lambda = 1e-3,
+    },
+};
+
+/**
+ * @brief Own row is sent at most once per this interval
+ */
+constexpr TickType_t row_interval = pdMS_TO_TICKS(CONFIG_IMF_SURVEY_ROW_INTERVAL_MS);
+
+/**
+ * @brief Length of one `AAAA=DDDD,` entry of encoded row
+ */
+constexpr size_t row_entry_len = 4+1+4+1;
+
+/**
+ * @brief Mesh firmware relays rows of at most this many entries (BLE_MESH_DIST_ROW_MAX_ENTRIES)
+ */
+constexpr size_t max_row_entries = 40;
+
+StationSurvey::StationSurvey(std::shared_ptr<Device> this_device, std::vector<std::shared_ptr<Device>> stations)
+    : _this_device(this_device), _solver(0), _publisher(this_device){
+    _stations.push_back(this_device);
+    for(auto && station : stations){
+        if(station && station->ble_mesh_addr != this_device->ble_mesh_addr){
+            _stations.push_back(station);
+        }
+    }
+    std::sort(_stations.begin(), _stations.end(), [](const std::shared_ptr<Device>& a, const std::shared_ptr<Device>& b){
+        return a->ble_mesh_addr < b->ble_mesh_addr;
+    });
+    _self = stationIndex(this_device->ble_mesh_addr);
+    _rows.assign(_stations.size(), std::vector<uint16_t>(_stations.size(), 0));
+    _solver = SurveySolver(_stations.size());
+    _mutex = xSemaphoreCreateMutex();
+}
+
+StationSurvey::~StationSurvey(){
+    vSemaphoreDelete(_mutex);
+}
+
+int StationSurvey::stationIndex(uint16_t addr) const{
+    for(size_t i = 0; i < _stations.size(); i++){
+        if(_stations[i]->ble_mesh_addr == addr){
+            return i;
+        }
+    }
+    return -1;
+}
+
+esp_err_t StationSurvey::rowReceived(uint16_t addr, const std::string &value){
+    const int from = stationIndex(addr);
+    if(from < 0 || (size_t)from == _self){
+        return ESP_ERR_NOT_FOUND;
+    }
+    std::vector<uint16_t> row(_stations.size(), 0);
+    size_t pos = 0;
+    while(pos < value.length()){
+        size_t end = value.find(',', pos);
+        if(end == std::string::npos){
+            end = value.length();
+        }
+        uint16_t to_addr, distance_cm;
+        if(sscanf(value.substr(pos, end - pos).c_str(), "%4" SCNx16 "=%4" SCNx16, &to_addr, &distance_cm) != 2){
+            LOGGER_E(TAG, "Invalid distance row of 0x%04" PRIx16 ": %s", addr, value.c_str());
+            return ESP_FAIL;
+        }
+        const int to = stationIndex(to_addr);
+        if(to >= 0 && to != from){
+            row[to] = distance_cm;
+        }
+        pos = end + 1;
+    }
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    if(_rows[from] != row){
+        _rows[from] = row;
+        _rows_version++;
+    }
+    xSemaphoreGive(_mutex);
+    return ESP_OK;
+}
+
+void StationSurvey::publishRow(){
+    std::vector<uint16_t> row(_stations.size(), 0);
+    for(size_t i = 0; i < _stations.size(); i++){
+        distance_log_t dist_log;
+        if(i == _self || _stations[i]->lastDistance(dist_log) != ESP_OK){
+            continue;
+        }
+        // 0 is reserved for missing distance
+        row[i] = (uint16_t) std::clamp<uint32_t>(dist_log.measurement.distance_cm, 1, std::numeric_limits<uint16_t>::max());
+    }
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    if(_rows[_self] != row){
+        _rows[_self] = row;
+        _rows_version++;
+    }
+    xSemaphoreGive(_mutex);
+
+    const TickType_t now = xTaskGetTickCount();
+    if(_published && now - _last_publish < row_interval){
+        return;
+    }
+    // longest distances are left out of the sent row when it does not fit into a mesh message
+    std::vector<uint16_t> sent = row;
+    const size_t measured = row.size() - std::count(row.begin(), row.end(), 0);
+    if(measured > max_row_entries){
+        std::vector<uint16_t> distances;
+        distances.reserve(measured);
+        std::copy_if(row.begin(), row.end(), std::back_inserter(distances), [](uint16_t d){ return d > 0; });
+        std::nth_element(distances.begin(), distances.begin() + max_row_entries - 1, distances.end());
+        const uint16_t longest = distances[max_row_entries - 1];
+        // distances equal to the longest kept one fill the remaining entries
+        size_t longest_left = max_row_entries - std::count_if(distances.begin(), distances.end(),
+            [longest](uint16_t d){ return d < longest; });
+        for(auto && d : sent){
+            if(d > longest || (d == longest && longest_left == 0)){
+                d = 0;
+            } else if(d == longest){
+                longest_left--;
+            }
+        }
+    }
+    std::string value;
+    value.reserve(max_row_entries * row_entry_len);
+    for(size_t i = 0; i < sent.size(); i++){
+        if(sent[i] == 0){
+            continue;
+        }
+        char entry[row_entry_len + 1];
+        snprintf(entry, sizeof(entry), "%04" PRIx16 "=%04" PRIx16 ",", _stations[i]->ble_mesh_addr, sent[i]);
+        value += entry;
+    }
+    if(value.empty()){
+        return;
+    }
+    value.pop_back(); // trailing ','
+    auto serial = Device::getSerialCli();
+    if(serial && serial->PutField(0xffff, SURVEY_FIELD, value) == ESP_OK){
+        _last_publish = now;
+        _published = true;
+    }
+}
+
+bool StationSurvey::solve(const std::vector<std::vector<uint16_t>> &rows){
+    _solver.clear_distances();
+    for(size_t i = 0; i < rows.size(); i++){
+        for(size_t j = 0; j < rows[i].size(); j++){
+            if(rows[i][j] > 0){
+                _solver.add_distance(i, j, (float)rows[i][j] * distance_scale);
+            }
+        }
+    }
+    // stations with configured location (uncertainty 0) hold the layout in place
+    size_t fixed = 0;
+    for(size_t i = 0; i < _stations.size(); i++){
+        location_local_t location;
+        if(i != _self && _stations[i]->getLocation(location) == ESP_OK && location.uncertainty == 0){
+            position_t pos;
+            MlatLocalization::locationToPos(location, pos.x, pos.y);
+            _solver.fix(i, pos);
+            fixed++;
+        } else{
+            _solver.release(i);
+        }
+    }
+    if(!_solver.solvable()){
+        LOGGER_I(TAG, "survey not solvable yet (%d stations, %d fixed)", _stations.size(), fixed);
+        return false;
+    }
+    survey_solution_t solution = _solver.solve(survey_config);
+    if(!solution.valid){
+        return false;
+    }
+    if(solution.ambiguous){
+        LOGGER_I(TAG, "survey layout cannot be oriented, %d fixed stations (3 not on a line are needed)", fixed);
+        return false;
+    }
+    LOGGER_I(TAG, "survey solved %d stations (%d fixed), residual=%f, sweeps=%" PRIu16, _stations.size(), fixed,
+        solution.residual, solution.sweeps);
+    for(size_t i = 0; i < _stations.size(); i++){
+        LOGGER_I(TAG, "-> 0x%04" PRIx16 " x=%f,y=%f,residual=%f", _stations[i]->ble_mesh_addr,
+            solution.positions[i].x, solution.positions[i].y, solution.residuals[i]);
+    }
+
+    location_local_t new_location{0,0,0,0,0};
+    // altitude and floor are not surveyed, keep the last ones
+    _this_device->getLocation(new_location);
+    MlatLocalization::posToLocation(solution.positions[_self].x, solution.positions[_self].y, new_location);
+    // uncertainty 0 is reserved for configured location
+    const float uncertainty = solution.residuals[_self] * pos_scale;
+    new_location.uncertainty = (uint16_t) std::clamp(uncertainty, 1.0f, (float) std::numeric_limits<uint16_t>::max() - 1);
+    _publisher.publish(new_location);
+    return true;
+}
+
+bool StationSurvey::tick(TickType_t diff){
+    publishRow();
+    if(_this_device->fixed_location){
+        return true;
+    }
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    const bool changed = _rows_version != _solved_version;
+    std::vector<std::vector<uint16_t>> rows;
+    if(changed){
+        rows = _rows;
+        _solved_version = _rows_version;
+    }
+    xSemaphoreGive(_mutex);
+    if(changed && solve(rows)){
+        _solved = true;
+    }
+    return _solved;
+}
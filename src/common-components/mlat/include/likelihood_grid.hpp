@@ -0,0 +1,112 @@
+/**
+ * @file likelihood_grid.hpp
+ * @author Daniel Kurek (daniel.kurek.dev@gmail.com)
+ * @brief Localization from distances to static stations using precomputed distance table over venue grid
+ * @version 0.1
+ * @date 2024-05-06
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#ifndef LIKELIHOOD_GRID_H
+#define LIKELIHOOD_GRID_H
+
+#include <vector>
+#include <span>
+#include <cstdint>
+#include "mlat.hpp"
+
+namespace mlat {
+    typedef struct{
+        float cell_size; /**< requested size of grid cell (m), increased when the table would not fit into @ref max_entries */
+        uint8_t coarse_factor; /**< coarse cell spans coarse_factor x coarse_factor grid cells */
+        float margin; /**< grid covers bounding box of stations extended by this margin (m) */
+        float distance_sigma; /**< standard deviation of distance measurements (m) */
+        float outlier_distance; /**< residual above this value is considered NLOS/outlier, its penalty does not grow further (m) */
+        size_t max_entries; /**< upper bound of distance table entries (stations * cells), bounds memory */
+    } grid_config_t;
+
+    typedef struct{
+        uint16_t station; /**< index of station in positions passed to LikelihoodGrid::build() */
+        float distance; /**< measured distance to the station (m) */
+    } grid_distance_t;
+
+    /**
+     * @brief Localization on grid with precomputed distances to stations
+     *
+     * Stations do not move, so distance from every grid cell to every station is computed once
+     * by build() and stored as centimetres (uint16_t). locate() then only sums squared residuals
+     * looked up from the table: first over coarse cells of the whole venue, then over fine cells
+     * around the best coarse cell. Grid is limited to int16_t centimetre range of location_local_t.
+     */
+    class LikelihoodGrid {
+        public:
+            /**
+             * @brief Construct a new Likelihood Grid object
+             *
+             * @param config grid and measurement model
+             */
+            LikelihoodGrid(const grid_config_t& config);
+
+            /**
+             * @brief Compute distance tables for given stations
+             *
+             * @param stations positions of stations, index in this span identifies the station in locate()
+             * @return true if tables were built, false for more than @ref max_stations stations
+             */
+            bool build(std::span<const position_t> stations);
+
+            /**
+             * @brief Find position that best matches measured distances
+             *
+             * @param distances measured distances to stations, each station at most once
+             * @return track_t weighted mean of cells around the best cell and its covariance (velocity is not estimated), invalid if grid was not built or @p distances are empty
+             */
+            track_t locate(std::span<const grid_distance_t> distances);
+
+            /**
+             * @brief Maximal number of stations, costs of cells are sums of squared residuals in uint32_t
+             */
+            static constexpr size_t max_stations = 255;
+
+            /**
+             * @brief True if build() succeeded
+             */
+            bool built() const { return _stations > 0; }
+
+            /**
+             * @brief Size of grid cell after build() (m)
+             */
+            float cell_size() const { return _cell_cm / 100.0f; }
+
+            /**
+             * @brief Number of columns (x) and rows (y) of grid
+             */
+            size_t cols() const { return _cols; }
+            size_t rows() const { return _rows; }
+        private:
+            /**
+             * @brief Centre of grid cell in centimetres
+             */
+            position_t cell_center(size_t col, size_t row) const;
+
+            /**
+             * @brief Add capped squared residuals of one station to costs of table cells
+             */
+            static void accumulate(const uint16_t *table, uint32_t *cost, size_t count, int32_t distance, int32_t cap);
+
+            grid_config_t _config;
+            size_t _stations = 0; /**< number of stations in tables */
+            int32_t _cell_cm = 0; /**< size of grid cell (cm) */
+            position_t _origin{}; /**< corner of cell (0,0) (cm) */
+            size_t _cols = 0;
+            size_t _rows = 0;
+            size_t _coarse_cols = 0;
+            size_t _coarse_rows = 0;
+            std::vector<uint16_t> _table; /**< distances of grid cells to stations (cm), station-major, row-major */
+            std::vector<uint16_t> _coarse_table; /**< distances of coarse cell centres to stations (cm), station-major, row-major */
+            std::vector<uint32_t> _cost; /**< scratch buffer for coarse and window costs */
+    };
+}
+
+#endif /* LIKELIHOOD_GRID_H */
@@ -11,31 +11,342 @@
 #ifndef MLAT_H
 #define MLAT_H
 
-#include <vector>
+#include <array>
+#include <span>
+#include <cstdint>
+#include <cmath>
+#include <eigen3/Eigen/Dense>
 
 namespace mlat {
+    /**
+     * @brief 2D position with given coordinate type
+     * 
+     * @tparam Scalar float (metres) or int16_t (centimetres, same grid as location_local_t)
+     */
+    template<typename Scalar>
+    struct basic_position_t{
+        Scalar x; /**< x coordinate */
+        Scalar y; /**< y coordinate */
+    };
+
+    /**
+     * @brief 2D anchor with given coordinate type
+     * 
+     * @tparam Scalar float (metres) or int16_t (centimetres, same grid as location_local_t)
+     */
+    template<typename Scalar>
+    struct basic_anchor_t{
+        basic_position_t<Scalar> pos; /**< anchor position */
+        Scalar distance; /**< distance to anchor */
+    };
+
+    using position_t = basic_position_t<float>;
+    using anchor_t = basic_anchor_t<float>;
+    using position_cm_t = basic_position_t<int16_t>;
+    using anchor_cm_t = basic_anchor_t<int16_t>;
+
+    typedef struct{
+        float xx; /**< variance of x coordinate */
+        float xy; /**< covariance of x and y coordinates */
+        float yy; /**< variance of y coordinate */
+    } covariance_t;
+
+    typedef struct{
+        position_t pos; /**< resulting position */
+        float error; /**< least squares error */
+        bool valid; /**< true if resulting position was found */
+        covariance_t covariance; /**< position covariance for unit variance of distances (multiply by variance of distances) */
+        uint16_t iterations; /**< iterations of nonlinear refinement (0 for closed form solutions) */
+        float residual; /**< root mean square of distance residuals after refinement */
+    } solution_t;
+    
     typedef struct{
         float x; /**< x coordinate */
         float y; /**< y coordinate */
-    } position_t;
-    
+        float z; /**< z coordinate (altitude) */
+    } position3d_t;
+
     typedef struct{
-        position_t pos; /**< anchor position */
+        position3d_t pos; /**< anchor position */
         float distance; /**< distance to anchor */
-    } anchor_t;
+    } anchor3d_t;
 
     typedef struct{
-        position_t pos; /**< resulting position */
+        position3d_t pos; /**< resulting position */
         float error; /**< least squares error */
         bool valid; /**< true if resulting position was found */
-    } solution_t;
-    
+    } solution3d_t;
+
     typedef struct{
         position_t pos1; /**< first intersection */
         position_t pos2; /**< second intersection */
         bool valid; /**< true if intersections were found */
     } double_solution_t;
 
+    typedef struct{
+        uint16_t max_iterations; /**< upper bound of iterations (bounds computation time) */
+        float tolerance; /**< stop when position step is smaller than this value */
+        float lambda; /**< initial Levenberg-Marquardt damping factor */
+    } refine_config_t;
+
+    typedef struct{
+        uint16_t max_iterations; /**< maximal number of evaluated anchor subsets (bounds computation time) */
+        float inlier_threshold; /**< anchor with larger distance residual is rejected */
+        float consensus; /**< stop early when this fraction of anchors agrees with a subset (0-1) */
+    } robust_config_t;
+
+    typedef struct{
+        solution_t solution; /**< least squares solution using only inlier anchors */
+        uint32_t rejected; /**< bit mask of rejected anchors (bit i represents anchors[i]) */
+        uint16_t iterations; /**< number of evaluated anchor subsets */
+    } robust_solution_t;
+
+    typedef struct{
+        uint8_t max_anchors; /**< upper bound of selected anchors */
+        uint8_t min_anchors; /**< always select at least this many anchors (if available) */
+        float gdop_target; /**< stop adding anchors when GDOP of selected anchors is not larger than this value */
+        float distance_weight; /**< growth of distance error with distance (error of anchor at distance d is 1 + distance_weight * d), 0 for plain GDOP */
+    } selection_config_t;
+
+    typedef struct{
+        uint32_t selected; /**< bit mask of selected anchors (bit i represents anchors[i]) */
+        float gdop; /**< geometric dilution of precision of selected anchors (infinity if position is not determined) */
+    } anchor_selection_t;
+
+    typedef struct{
+        float acceleration_sigma; /**< standard deviation of acceleration (m/s^2), how fast velocity can change */
+        float initial_speed_sigma; /**< standard deviation of velocity before it is observed (m/s) */
+        float gate; /**< fixes with squared Mahalanobis distance from prediction larger than this are rejected */
+        uint8_t max_rejections; /**< tracker restarts from a fix after this many consecutive rejected fixes */
+    } tracker_config_t;
+
+    typedef struct{
+        position_t pos; /**< tracked position */
+        position_t velocity; /**< tracked velocity (per second) */
+        covariance_t covariance; /**< covariance of tracked position */
+        bool valid; /**< true if tracker was initialized */
+        bool rejected; /**< true if the last fix was rejected as an outlier */
+    } track_t;
+
+    /**
+     * @brief Maximal number of anchors handled by heap-free fixed-size solvers
+     */
+    constexpr size_t max_anchors = 8;
+
+    /**
+     * @brief Dimension dependent properties of anchor types, allows sharing solvers between 2D and 3D
+     * 
+     * @tparam Anchor anchor_t (2D) or anchor3d_t (3D)
+     */
+    template<typename Anchor>
+    struct anchor_traits;
+
+    template<>
+    struct anchor_traits<anchor_t>{
+        using position_type = position_t;
+        using solution_type = solution_t;
+        static constexpr int dimensions = 2;
+        static constexpr size_t min_anchors = 3; /**< minimal number of anchors for unique solution */
+        static float coordinate(const position_t& pos, int i){ return i == 0 ? pos.x : pos.y; }
+        template<typename Vector>
+        static position_t position(const Vector& v){ return {v(0), v(1)}; }
+    };
+
+    template<>
+    struct anchor_traits<anchor3d_t>{
+        using position_type = position3d_t;
+        using solution_type = solution3d_t;
+        static constexpr int dimensions = 3;
+        static constexpr size_t min_anchors = 4; /**< minimal number of anchors for unique solution */
+        static float coordinate(const position3d_t& pos, int i){ return i == 0 ? pos.x : (i == 1 ? pos.y : pos.z); }
+        template<typename Vector>
+        static position3d_t position(const Vector& v){ return {v(0), v(1), v(2)}; }
+    };
+
+    /**
+     * @brief Fill linearized multilateration system that depends only on anchor positions
+     * 
+     * Equation of anchor 0 is subtracted from equations of the other anchors.
+     * Works with dynamic, fixed-size and fixed-maximal-size Eigen types.
+     * 
+     * @param[in] anchors anchors of multilateration (at least 2)
+     * @param[out] A resulting matrix with anchors.size()-1 rows and one column per dimension
+     * @param[out] b_geometry part of right side that does not depend on distances
+     */
+    template<typename Anchor, typename MatrixA, typename VectorB>
+    void linear_system(std::span<const Anchor> anchors, MatrixA& A, VectorB& b_geometry){
+        using traits = anchor_traits<Anchor>;
+        A.resize(anchors.size() - 1, traits::dimensions);
+        b_geometry.resize(anchors.size() - 1);
+        float norm0 = 0;
+        for(int d = 0; d < traits::dimensions; d++){
+            const float c0 = traits::coordinate(anchors[0].pos, d);
+            norm0 += c0*c0;
+        }
+        for(size_t i = 1; i < anchors.size(); i++){
+            float norm = 0;
+            for(int d = 0; d < traits::dimensions; d++){
+                const float c = traits::coordinate(anchors[i].pos, d);
+                A(i-1, d) = c - traits::coordinate(anchors[0].pos, d);
+                norm += c*c;
+            }
+            b_geometry(i-1) = 0.5f * (norm - norm0);
+        }
+    }
+
+    /**
+     * @brief Add part of right side of linearized system that depends on distances
+     * 
+     * @param[in] anchors anchors of multilateration
+     * @param[in,out] b right side with geometry part already filled by linear_system()
+     */
+    template<typename Anchor, typename VectorB>
+    void add_distances(std::span<const Anchor> anchors, VectorB& b){
+        const float dist0 = anchors[0].distance*anchors[0].distance;
+        for(size_t i = 1; i < anchors.size(); i++){
+            b(i-1) += 0.5f * (dist0 - anchors[i].distance*anchors[i].distance);
+        }
+    }
+
+    /**
+     * @brief Covariance of linearized least squares position for unit variance of distances
+     * 
+     * First order propagation of distance errors: x = P b, element i-1 of b depends 
+     * on distances of anchor 0 and anchor i (see add_distances()).
+     * 
+     * @param anchors anchors of multilateration
+     * @param P pseudo-inverse of matrix from linear_system() (the same one that solved the position)
+     * @return position covariance (dimensions x dimensions)
+     */
+    template<typename Anchor, typename MatrixP>
+    Eigen::Matrix<float, anchor_traits<Anchor>::dimensions, anchor_traits<Anchor>::dimensions> linear_covariance(std::span<const Anchor> anchors, const MatrixP& P){
+        constexpr int dimensions = anchor_traits<Anchor>::dimensions;
+        using vector_t = Eigen::Matrix<float, dimensions, 1>;
+        Eigen::Matrix<float, dimensions, dimensions> covariance = Eigen::Matrix<float, dimensions, dimensions>::Zero();
+        vector_t p_sum = vector_t::Zero();
+        for(size_t i = 1; i < anchors.size(); i++){
+            const vector_t p = P.col(i-1);
+            p_sum += p;
+            covariance += (anchors[i].distance*anchors[i].distance) * p * p.transpose();
+        }
+        covariance += (anchors[0].distance*anchors[0].distance) * p_sum * p_sum.transpose();
+        return covariance;
+    }
+
+    /**
+     * @brief Convert 2x2 covariance matrix to covariance_t
+     */
+    inline covariance_t to_covariance(const Eigen::Matrix2f& covariance){
+        return {covariance(0,0), covariance(0,1), covariance(1,1)};
+    }
+
+    /**
+     * @brief Least squares multilateration with compile-time number of anchors
+     * 
+     * All matrices have fixed size, so solving does not allocate any memory.
+     * 
+     * @tparam N number of anchors (dimensions+1 to @ref max_anchors)
+     * @tparam Anchor anchor_t (2D) or anchor3d_t (3D)
+     */
+    template<size_t N, typename Anchor = anchor_t>
+    class FixedMLAT {
+        using traits = anchor_traits<Anchor>;
+        static_assert(N >= traits::min_anchors && N <= max_anchors, "FixedMLAT supports dimensions+1 to max_anchors anchors");
+        public:
+            static constexpr int dimensions = traits::dimensions;
+            using matrix_t = Eigen::Matrix<float, N-1, dimensions>;
+            using pinv_t = Eigen::Matrix<float, dimensions, N-1>;
+            using vector_t = Eigen::Matrix<float, N-1, 1>;
+            using solution_type = typename traits::solution_type;
+
+            /**
+             * @brief Compute pseudo-inverse of linearized system matrix
+             * 
+             * Square matrix (dimensions+1 anchors) is inverted in closed form, 
+             * singular and overdetermined systems use complete orthogonal decomposition.
+             * 
+             * @param[in] A matrix from linear_system()
+             * @param[out] pinv pseudo-inverse of @p A
+             */
+            static void factorize(const matrix_t& A, pinv_t& pinv){
+                if constexpr (N-1 == dimensions){
+                    constexpr float eps = 1e-6;
+                    // determinant scales with length^dimensions, compare with the same power of norm of A
+                    if(std::abs(A.determinant()) >= eps * std::pow(A.squaredNorm(), dimensions / 2.0f)){
+                        pinv = A.inverse();
+                        return;
+                    }
+                }
+                pinv = A.completeOrthogonalDecomposition().pseudoInverse();
+            }
+
+            /**
+             * @brief Solve multilateration using Least squares method
+             * 
+             * Resulting 2D solution includes covariance computed from the same pseudo-inverse.
+             * 
+             * @param anchors exactly N anchors
+             * @return resulting position
+             */
+            static solution_type solve(std::span<const Anchor, N> anchors){
+                solution_type solution{};
+                matrix_t A;
+                vector_t b;
+                pinv_t pinv;
+                linear_system(std::span<const Anchor>(anchors), A, b);
+                factorize(A, pinv);
+                add_distances(std::span<const Anchor>(anchors), b);
+                Eigen::Matrix<float, dimensions, 1> x = pinv * b;
+                solution.pos = traits::position(x);
+                solution.error = ((A*x) - b).norm();
+                if constexpr (dimensions == 2){
+                    solution.covariance = to_covariance(linear_covariance(std::span<const Anchor>(anchors), pinv));
+                }
+                solution.valid = true;
+                return solution;
+            }
+    };
+
+    /**
+     * @brief Least squares multilateration through 2x2 normal equations, templated on coordinate type
+     * 
+     * Linearized system (see linear_system()) is accumulated directly into normal equations,
+     * so the kernel needs neither matrices nor decomposition. LinearMLAT<float> works in metres. 
+     * LinearMLAT<int16_t> works on the centimetre grid of location_local_t with integer 
+     * arithmetic only: 64-bit accumulators cannot overflow for int16_t inputs (up to 1024 anchors),
+     * the 2x2 system is solved after normalizing both sides to 30 bits and the result saturates 
+     * to int16_t range. It is suitable for cores without fast FPU and gives bit-exact results 
+     * on every platform (e.g. for replay of recorded measurements).
+     * 
+     * @tparam Scalar float or int16_t
+     */
+    template<typename Scalar>
+    class LinearMLAT {
+        public:
+            typedef struct{
+                basic_position_t<Scalar> pos; /**< resulting position */
+                Scalar error; /**< root of sum of squared distance residuals */
+                bool valid; /**< true if resulting position was found */
+            } solution_type;
+
+            /**
+             * @brief Solve multilateration using Least squares method
+             * 
+             * @param anchors anchors that define circles for multilateration (at least 3)
+             * @return solution_type resulting position, invalid if anchors are collinear
+             */
+            static solution_type solve(std::span<const basic_anchor_t<Scalar>> anchors);
+
+            /**
+             * @brief Project distance to horizontal plane (same as MLAT::project, rounded down on centimetre grid)
+             * 
+             * @param distance measured distance to the anchor
+             * @param dz difference of altitudes of the anchor and the plane
+             * @return Scalar horizontal distance, 0 if @p distance is shorter than @p dz
+             */
+            static Scalar project(Scalar distance, Scalar dz);
+    };
+
     class MLAT {
         public:
             /**
@@ -56,13 +367,366 @@ namespace mlat {
              */
             static double_solution_t solve_two_anchors(anchor_t anchor0, anchor_t anchor1);
 
+            /**
+             * @brief Closed form intersection of 3 circles (linearized system solved by Cramer's rule)
+             * 
+             * @param anchor0 first circle (reference of linearization)
+             * @param anchor1 second circle
+             * @param anchor2 third circle
+             * @return solution_t resulting position with covariance, invalid if anchors are collinear
+             */
+            static solution_t solve_three_anchors(anchor_t anchor0, anchor_t anchor1, anchor_t anchor2);
+
             /**
              * @brief Solve multilateration using Least squares method
              * 
+             * Dispatches to heap-free FixedMLAT for 3 to @ref max_anchors anchors (3 anchors are solved
+             * in closed form), more anchors are solved with dynamically allocated matrices.
+             * 
              * @param anchors anchors that define circles for multilateration
              * @return solution_t resulting position
              */
-            static solution_t solve(const std::vector<anchor_t>& anchors);
+            static solution_t solve(std::span<const anchor_t> anchors);
+
+            /**
+             * @brief Solve 3D multilateration using Least squares method
+             * 
+             * Dispatches to heap-free FixedMLAT for 4 to @ref max_anchors anchors.
+             * Anchors in one plane (e.g. all stations mounted at the same height) cannot determine
+             * the coordinate perpendicular to the plane, use project() with a known altitude instead.
+             * 
+             * @param anchors anchors that define spheres for multilateration
+             * @return solution3d_t resulting position
+             */
+            static solution3d_t solve(std::span<const anchor3d_t> anchors);
+
+            /**
+             * @brief Project 3D anchor into horizontal plane at altitude @p z
+             * 
+             * @param anchor 3D anchor
+             * @param z altitude of the plane (altitude of the localized device)
+             * @return anchor_t anchor with horizontal distance, 
+             *                  0 if the vertical difference is larger than measured distance
+             */
+            static anchor_t project(anchor3d_t anchor, float z);
+
+            /**
+             * @brief Determine floor of position and clamp altitude into allowed floors
+             * 
+             * Floor k spans altitudes from k * @p floor_height to (k+1) * @p floor_height.
+             * 
+             * @param[in,out] pos position, z is clamped into altitudes of floors @p min_floor to @p max_floor
+             * @param floor_height height of one floor
+             * @param min_floor lowest allowed floor
+             * @param max_floor highest allowed floor
+             * @return uint8_t floor number of the resulting position
+             */
+            static uint8_t snap_to_floor(position3d_t& pos, float floor_height, uint8_t min_floor, uint8_t max_floor);
+
+            /**
+             * @brief Refine position by minimizing distance residuals (Levenberg-Marquardt)
+             * 
+             * Unlike solve() the result does not depend on error of a single reference anchor.
+             * 
+             * @param anchors anchors that define circles for multilateration (at least 2)
+             * @param initial starting position (e.g. previous position or result of solve())
+             * @param config iteration limit and convergence criteria
+             * @return solution_t refined position with number of iterations and residual
+             */
+            static solution_t refine(std::span<const anchor_t> anchors, position_t initial, const refine_config_t& config);
+
+            /**
+             * @brief Refine position by minimizing weighted distance residuals (Levenberg-Marquardt)
+             * 
+             * @param anchors anchors that define circles for multilateration (at least 2)
+             * @param weights weight of each anchor (inverse of its distance variance relative to unit variance), empty for unit weights
+             * @param initial starting position (e.g. previous position or result of solve())
+             * @param config iteration limit and convergence criteria
+             * @return solution_t refined position, residual is weighted root mean square, covariance is weighted
+             */
+            static solution_t refine(std::span<const anchor_t> anchors, std::span<const float> weights, position_t initial, const refine_config_t& config);
+
+            /**
+             * @brief Sum of squared distance residuals at given position
+             * 
+             * @param anchors anchors of multilateration
+             * @param pos evaluated position
+             * @return float sum of squared differences between distances from @p pos and measured distances
+             */
+            static float cost(std::span<const anchor_t> anchors, position_t pos);
+
+            /**
+             * @brief Weighted sum of squared distance residuals at given position
+             * 
+             * @param anchors anchors of multilateration
+             * @param weights weight of each anchor, empty for unit weights
+             * @param pos evaluated position
+             * @return float sum of weighted squared differences between distances from @p pos and measured distances
+             */
+            static float cost(std::span<const anchor_t> anchors, std::span<const float> weights, position_t pos);
+
+            /**
+             * @brief Covariance of position for unit variance of distances
+             * 
+             * Inverse of Gauss-Newton normal matrix of distance residuals at @p pos 
+             * (covariance of positions that minimize cost()).
+             * 
+             * @param anchors anchors of multilateration
+             * @param pos evaluated position
+             * @return covariance_t position covariance, infinite variances if anchors do not determine the position
+             */
+            static covariance_t covariance(std::span<const anchor_t> anchors, position_t pos);
+
+            /**
+             * @brief Covariance of position for unit variance of distances with weighted anchors
+             * 
+             * @param anchors anchors of multilateration
+             * @param weights weight of each anchor (anchor with weight w has distance variance 1/w), empty for unit weights
+             * @param pos evaluated position
+             * @return covariance_t position covariance, infinite variances if anchors do not determine the position
+             */
+            static covariance_t covariance(std::span<const anchor_t> anchors, std::span<const float> weights, position_t pos);
+
+            /**
+             * @brief Solve multilateration with rejection of outlier anchors (e.g. NLOS measurements)
+             * 
+             * Least median of squares: positions of 3-anchor subsets (closed form) are scored by median
+             * of squared distance residuals of all anchors. Subsets are enumerated in order of anchors 
+             * (pass closest anchors first) until consensus is reached or @p config.max_iterations subsets 
+             * were evaluated. Anchors that disagree with the best subset are rejected and the rest is 
+             * solved by least squares. Outliers cannot be detected with less than 4 anchors.
+             * 
+             * @param anchors anchors that define circles for multilateration (3 to @ref max_anchors)
+             * @param config computation budget and rejection criteria
+             * @return robust_solution_t resulting position and rejected anchors
+             */
+            static robust_solution_t solve_robust(std::span<const anchor_t> anchors, const robust_config_t& config);
+
+            /**
+             * @brief Select subset of anchors with low geometric dilution of precision (GDOP)
+             * 
+             * Depends only on anchor positions and approximate position of the localized device, 
+             * so it can decide which distances are worth measuring. Anchor closest to @p pos is selected
+             * first, then anchor that minimizes GDOP of the selection is added (normal matrix of 
+             * the selection is updated incrementally) until @p config.max_anchors anchors are selected 
+             * or GDOP drops to @p config.gdop_target. Directions to anchors are weighted by expected 
+             * distance error, so distant anchors are selected only if they improve geometry enough.
+             * 
+             * @param anchors positions of anchors (only first 32 are considered)
+             * @param pos approximate position of the localized device (e.g. previous position)
+             * @param config size of the selection and GDOP target
+             * @return anchor_selection_t selected anchors and their GDOP
+             */
+            static anchor_selection_t select_anchors(std::span<const position_t> anchors, position_t pos, const selection_config_t& config);
+    };
+
+    /**
+     * @brief Least squares multilateration that caches factorization of anchor geometry
+     * 
+     * Matrix of the linearized system depends only on positions of anchors, only the right side
+     * depends on measured distances. Pseudo-inverse of the matrix is cached for last @ref cache_size 
+     * ordered sets of anchor positions, so solving with already seen anchors costs only 
+     * a matrix-vector product. Cache has fixed-size storage, so solving up to @ref max_anchors
+     * anchors does not allocate any memory.
+     * 
+     * @tparam Anchor anchor_t (2D, @ref MLATSolver) or anchor3d_t (3D, @ref MLATSolver3D)
+     */
+    template<typename Anchor>
+    class BasicMLATSolver {
+            using traits = anchor_traits<Anchor>;
+        public:
+            using position_type = typename traits::position_type;
+            using solution_type = typename traits::solution_type;
+
+            /**
+             * @brief Solve multilateration using Least squares method (same result as MLAT::solve())
+             * 
+             * @param anchors anchors that define circles for multilateration, 
+             *                cache is keyed on positions of anchors including their order,
+             *                more than @ref max_anchors anchors are solved by MLAT::solve() without caching
+             * @return resulting position
+             */
+            solution_type solve(std::span<const Anchor> anchors);
+
+            /**
+             * @brief Drop all cached factorizations
+             */
+            void invalidate();
+
+            /**
+             * @brief Number of solves that reused cached factorization
+             */
+            uint32_t cacheHits() const { return _cache_hits; }
+
+            /**
+             * @brief Number of solves that had to factorize anchor geometry
+             */
+            uint32_t cacheMisses() const { return _cache_misses; }
+
+            /**
+             * @brief number of anchor geometries kept in cache
+             */
+            static constexpr size_t cache_size = 4;
+            static constexpr int dimensions = traits::dimensions;
+            using matrix_t = Eigen::Matrix<float, Eigen::Dynamic, dimensions, Eigen::ColMajor, max_anchors-1, dimensions>;
+            using pinv_t = Eigen::Matrix<float, dimensions, Eigen::Dynamic, Eigen::ColMajor, dimensions, max_anchors-1>;
+            using vector_t = Eigen::Matrix<float, Eigen::Dynamic, 1, Eigen::ColMajor, max_anchors-1, 1>;
+        private:
+            typedef struct{
+                std::array<position_type, max_anchors> positions; /**< ordered anchor positions (cache key) */
+                size_t count; /**< number of anchors in @p positions */
+                matrix_t A; /**< matrix of linearized system */
+                pinv_t pinv; /**< pseudo-inverse of @p A */
+                vector_t b_geometry; /**< part of right side that depends only on positions */
+                uint32_t last_use; /**< value of @ref _use_counter when the entry was last used */
+                bool valid; /**< entry holds factorization */
+            } cache_entry_t;
+
+            /**
+             * @brief Find cache entry for given anchors or factorize their geometry into least recently used entry
+             * 
+             * @param anchors anchors of multilateration (dimensions+1 to @ref max_anchors)
+             * @return cache_entry_t& entry with factorization of @p anchors geometry
+             */
+            cache_entry_t& entry(std::span<const Anchor> anchors);
+
+            std::array<cache_entry_t, cache_size> _cache{};
+            uint32_t _use_counter = 0;
+            uint32_t _cache_hits = 0;
+            uint32_t _cache_misses = 0;
+    };
+
+    using MLATSolver = BasicMLATSolver<anchor_t>;
+    using MLATSolver3D = BasicMLATSolver<anchor3d_t>;
+
+    /**
+     * @brief Least squares multilateration updated incrementally when distance of a single anchor changes
+     * 
+     * Keeps normal equations (A^T A) x = A^T b of the linearized system. Matrix A depends only on
+     * anchor positions, so change of one distance changes only right side b. Change of anchor i > 0
+     * updates one element of b (rank-one update of A^T b), change of anchor 0 shifts all elements 
+     * of b by the same value. Position is then a product of cached (A^T A)^-1 and A^T b.
+     */
+    class IncrementalMLAT {
+        public:
+            /**
+             * @brief Set anchors and compute normal equations from scratch
+             * 
+             * @param anchors anchors of multilateration (3 to @ref max_anchors)
+             * @return bool true if anchors are valid and their geometry is not degenerate (e.g. collinear)
+             */
+            bool reset(std::span<const anchor_t> anchors);
+
+            /**
+             * @brief Update distance of a single anchor
+             * 
+             * @param index index of anchor in order given to reset()
+             * @param distance new distance to the anchor
+             * @return solution_t updated position, invalid if estimator was not successfully reset
+             */
+            solution_t update(size_t index, float distance);
+
+            /**
+             * @brief Current solution
+             */
+            solution_t solution() const { return _solution; }
+
+            /**
+             * @brief Current anchors with latest distances
+             */
+            std::span<const anchor_t> anchors() const { return std::span<const anchor_t>(_anchors.data(), _count); }
+
+            /**
+             * @brief Number of updates after which A^T b is recomputed to prevent accumulation of rounding errors
+             */
+            static constexpr uint32_t resync_interval = 32;
+        private:
+            using matrix_t = MLATSolver::matrix_t;
+            using vector_t = MLATSolver::vector_t;
+
+            /**
+             * @brief Compute position from normal equations
+             */
+            void updateSolution();
+
+            std::array<anchor_t, max_anchors> _anchors{};
+            size_t _count = 0;
+            matrix_t _A; /**< matrix of linearized system */
+            vector_t _b; /**< right side of linearized system */
+            Eigen::Matrix2f _normal_inv; /**< (A^T A)^-1 */
+            Eigen::Vector2f _atb; /**< A^T b */
+            Eigen::Vector2f _a_sum; /**< A^T 1, change of A^T b when all elements of b are shifted */
+            uint32_t _updates = 0; /**< updates since last recomputation of @ref _atb */
+            solution_t _solution{};
+    };
+
+    /**
+     * @brief Constant velocity Kalman filter that fuses position fixes with prediction from previous fixes
+     * 
+     * State is position and velocity, acceleration is modeled as white noise. Fixes far from 
+     * prediction (by Mahalanobis distance) are rejected, so a single wrong fix does not move 
+     * the track. Time between fixes is given by the caller, so the filter does not depend on any clock.
+     */
+    class PositionTracker {
+        public:
+            PositionTracker(const tracker_config_t& config) : _config(config) {}
+
+            /**
+             * @brief Fuse new position fix
+             * 
+             * @param pos position fix
+             * @param covariance covariance of @p pos (in squared units of position, must be finite)
+             * @param dt time since previous update in seconds (ignored by first update)
+             * @return track_t state after the update
+             */
+            track_t update(position_t pos, covariance_t covariance, float dt);
+
+            /**
+             * @brief Predict state without a new fix (state of the tracker is not changed)
+             * 
+             * @param dt time since last update in seconds
+             * @return track_t predicted state, invalid if tracker was not initialized
+             */
+            track_t predict(float dt) const;
+
+            /**
+             * @brief State after last update
+             */
+            track_t state() const { return predict(0); }
+
+            /**
+             * @brief Forget the track, next update initializes the tracker
+             */
+            void reset() { _initialized = false; }
+
+            /**
+             * @brief True if tracker holds a state
+             */
+            bool initialized() const { return _initialized; }
+        private:
+            using state_t = Eigen::Vector4f;
+            using state_covariance_t = Eigen::Matrix4f;
+
+            /**
+             * @brief Propagate state and its covariance by @p dt
+             */
+            void propagate(float dt, state_t& x, state_covariance_t& P) const;
+
+            /**
+             * @brief Start tracking from a fix (velocity is unknown)
+             */
+            void initialize(position_t pos, const Eigen::Matrix2f& R);
+
+            /**
+             * @brief Convert state to track_t
+             */
+            static track_t to_track(const state_t& x, const state_covariance_t& P);
+
+            tracker_config_t _config;
+            state_t _x; /**< position and velocity (x, y, vx, vy) */
+            state_covariance_t _P; /**< covariance of @ref _x */
+            uint8_t _rejections = 0; /**< number of consecutive rejected fixes */
+            bool _initialized = false;
     };
 }
 
@@ -0,0 +1,161 @@
+/**
+ * @file particle_filter.hpp
+ * @author Daniel Kurek (daniel.kurek.dev@gmail.com)
+ * @brief Localization from anchor distances using particle filter with fixed-size particle pool
+ * @version 0.1
+ * @date 2024-05-02
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#ifndef PARTICLE_FILTER_H
+#define PARTICLE_FILTER_H
+
+#include <array>
+#include <span>
+#include <cstdint>
+#include "mlat.hpp"
+
+namespace mlat {
+    typedef struct{
+        float motion_sigma; /**< random walk of particles, standard deviation of movement during 1 s (m) */
+        float distance_sigma; /**< standard deviation of distance measurements (m) */
+        float outlier_distance; /**< residual above this value is considered NLOS/outlier, its penalty does not grow further (m) */
+        float resample_threshold; /**< resample when effective number of particles drops below this fraction of particles (0-1) */
+    } particle_config_t;
+
+    /**
+     * @brief Buffers of particles owned by ParticleFilter, all of the same size
+     */
+    typedef struct{
+        std::span<float> x; /**< x coordinates of particles */
+        std::span<float> y; /**< y coordinates of particles */
+        std::span<float> log_weight; /**< logarithms of particle weights */
+        std::span<float> weight; /**< particle weights (exp of @ref log_weight, largest is 1) */
+        std::span<float> x_scratch; /**< buffer for resampling */
+        std::span<float> y_scratch; /**< buffer for resampling */
+    } particle_storage_t;
+
+    /**
+     * @brief Particle filter over buffers provided by ParticleFilter (implementation does not depend on number of particles)
+     *
+     * Particles are kept in structure of arrays (x, y, log-weight), so the filter never allocates 
+     * and the likelihood loop over particles can be vectorized. Unlike least squares it keeps 
+     * multiple hypotheses (e.g. both mirror positions of two anchors) until measurements
+     * decide between them. Systematic resampling is used when weights degenerate.
+     */
+    class ParticleFilterBase {
+        public:
+            ParticleFilterBase(const ParticleFilterBase&) = delete;
+            ParticleFilterBase& operator=(const ParticleFilterBase&) = delete;
+
+            /**
+             * @brief Spread particles uniformly over rectangle
+             *
+             * @param min corner with minimal coordinates
+             * @param max corner with maximal coordinates
+             */
+            void initialize(position_t min, position_t max);
+
+            /**
+             * @brief True if particles were spread by initialize()
+             */
+            bool initialized() const { return _initialized; }
+
+            /**
+             * @brief Move particles by random walk
+             *
+             * @param dt time since last prediction in seconds
+             */
+            void predict(float dt);
+
+            /**
+             * @brief Weight particles by likelihood of measured distances and resample if needed
+             *
+             * @param anchors anchors with measured distances
+             */
+            void update(std::span<const anchor_t> anchors);
+
+            /**
+             * @brief Weighted mean of particles and its covariance
+             *
+             * @return track_t estimated position (velocity is not estimated), invalid if not initialized
+             */
+            track_t estimate() const;
+
+            /**
+             * @brief Effective number of particles (1/sum of squared normalized weights)
+             */
+            float effective_size() const;
+        protected:
+            /**
+             * @brief Construct a new Particle Filter Base object
+             *
+             * @param config motion and measurement model
+             * @param seed seed of pseudo-random generator (same seed gives the same results)
+             * @param storage buffers of particles (kept by the derived class)
+             */
+            ParticleFilterBase(const particle_config_t& config, uint32_t seed, const particle_storage_t& storage) 
+                : _config(config), _random(seed ? seed : 1), _p(storage) {}
+        private:
+            /**
+             * @brief Convert log-weights to weights (largest weight is 1), keeps log-weights bounded
+             */
+            void normalize();
+
+            /**
+             * @brief Systematic resampling, particles are copied in proportion to their weights
+             */
+            void resample();
+
+            /**
+             * @brief Uniformly distributed number from [0, 1) (xorshift32)
+             */
+            float uniform();
+
+            /**
+             * @brief Two independent samples of standard normal distribution (Box-Muller)
+             */
+            void normal_pair(float& n0, float& n1);
+
+            particle_config_t _config;
+            uint32_t _random; /**< state of pseudo-random generator */
+            bool _initialized = false;
+            particle_storage_t _p; /**< particles */
+    };
+
+    /**
+     * @brief Particle filter with compile-time number of particles
+     *
+     * Particles are stored in preallocated arrays of this object, see ParticleFilterBase.
+     *
+     * @tparam N number of particles
+     */
+    template<size_t N>
+    class ParticleFilter : public ParticleFilterBase {
+        static_assert(N >= 2, "ParticleFilter needs at least 2 particles");
+        public:
+            /**
+             * @brief Construct a new Particle Filter object
+             *
+             * @param config motion and measurement model
+             * @param seed seed of pseudo-random generator (same seed gives the same results)
+             */
+            ParticleFilter(const particle_config_t& config, uint32_t seed = 1) 
+                : ParticleFilterBase(config, seed, {_x, _y, _log_weight, _weight, _x_scratch, _y_scratch}) {}
+
+            /**
+             * @brief Number of particles
+             */
+            static constexpr size_t size() { return N; }
+        private:
+            std::array<float, N> _x{};
+            std::array<float, N> _y{};
+            std::array<float, N> _log_weight{};
+            std::array<float, N> _weight{};
+            std::array<float, N> _x_scratch{};
+            std::array<float, N> _y_scratch{};
+    };
+}
+
+#endif /* PARTICLE_FILTER_H */
@@ -0,0 +1,126 @@
+/**
+ * @file survey.hpp
+ * @author Daniel Kurek (daniel.kurek.dev@gmail.com)
+ * @brief Batch localization of all stations from station-to-station distances
+ * @version 0.1
+ * @date 2024-05-14
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#ifndef SURVEY_H
+#define SURVEY_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "mlat.hpp"
+
+namespace mlat {
+    typedef struct{
+        uint16_t max_sweeps; /**< upper bound of refinement sweeps over all stations */
+        float tolerance; /**< stop when no station moved more than this in a sweep (m) */
+        refine_config_t refine; /**< refinement of a single station within a sweep */
+    } survey_config_t;
+
+    typedef struct{
+        std::vector<position_t> positions; /**< position of every station (m), fixed stations keep their positions */
+        std::vector<float> residuals; /**< root mean square distance residual of every station (m) */
+        float residual; /**< root mean square residual over all measured pairs (m) */
+        uint16_t sweeps; /**< number of performed refinement sweeps */
+        bool valid; /**< false if distances do not connect all stations */
+        bool ambiguous; /**< fixed stations do not determine rotation and reflection of the layout (1-2 or collinear fixed stations) */
+    } survey_solution_t;
+
+    /**
+     * @brief Places all stations at once from the matrix of their mutual distances
+     *
+     * Initial layout is found by classical multidimensional scaling of the distance matrix
+     * (missing distances are replaced by shortest paths over measured ones). Layout is aligned
+     * to fixed stations and then refined by sweeps of MLAT::refine() over free stations
+     * with measured distances only.
+     *
+     * Without fixed stations the layout is relative: the first station is in origin and
+     * the second one lies on positive x axis. Distances do not tell reflection of the layout,
+     * so at least 3 fixed stations that are not collinear are needed to orient it. With fewer
+     * fixed stations the solution is reported as ambiguous.
+     */
+    class SurveySolver {
+        public:
+            /**
+             * @brief Construct a new Survey Solver object
+             *
+             * @param stations number of stations
+             */
+            SurveySolver(size_t stations);
+
+            /**
+             * @brief Forget all distances (fixed positions are kept)
+             */
+            void clear_distances();
+
+            /**
+             * @brief Add measured distance between two stations (both directions are averaged)
+             *
+             * @param from index of measuring station
+             * @param to index of measured station
+             * @param distance measured distance (m)
+             */
+            void add_distance(size_t from, size_t to, float distance);
+
+            /**
+             * @brief Fix position of a station (e.g. configured location)
+             */
+            void fix(size_t station, position_t pos);
+
+            /**
+             * @brief Remove fixed position of a station
+             */
+            void release(size_t station);
+
+            /**
+             * @brief Averaged distance between two stations, negative if it was not measured
+             */
+            float distance(size_t a, size_t b) const;
+
+            /**
+             * @brief Check that every free station has at least 3 measured distances and all stations are connected
+             */
+            bool solvable() const;
+
+            /**
+             * @brief Compute positions of all stations
+             *
+             * @param config refinement limits
+             * @return survey_solution_t positions of stations, invalid if not solvable()
+             */
+            survey_solution_t solve(const survey_config_t& config) const;
+
+            /**
+             * @brief Number of stations
+             */
+            size_t size() const { return _stations; }
+        private:
+            /**
+             * @brief Fill full distance matrix, missing distances are shortest paths over measured ones
+             *
+             * @return false if some stations are not connected
+             */
+            bool complete_matrix(std::vector<float>& matrix) const;
+
+            /**
+             * @brief Rotate, reflect and translate layout to match fixed stations
+             *
+             * @return false if fixed stations do not determine rotation and reflection (layout is only shifted)
+             */
+            bool align(std::vector<position_t>& positions) const;
+
+            size_t _stations;
+            std::vector<float> _sum; /**< sum of measured distances, row-major, symmetric */
+            std::vector<uint16_t> _samples; /**< number of measured distances, row-major, symmetric */
+            std::vector<position_t> _fixed_pos; /**< positions of fixed stations */
+            std::vector<bool> _fixed; /**< station has fixed position */
+    };
+}
+
+#endif /* SURVEY_H */
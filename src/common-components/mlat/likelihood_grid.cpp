@@ -0,0 +1,210 @@
+/**
+ * @file likelihood_grid.cpp
+ * @author Daniel Kurek (daniel.kurek.dev@gmail.com)
+ * @brief Implementation of @ref likelihood_grid.hpp
+ * @version 0.1
+ * @date 2024-05-06
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#include "likelihood_grid.hpp"
+
+#include <cmath>
+#include <algorithm>
+#include <limits>
+
+using namespace mlat;
+using namespace std;
+
+constexpr float cm_scale = 100.0; // m to cm
+
+/**
+ * @brief Upper bound of capped residual (cm), sum of squares of LikelihoodGrid::max_stations residuals fits into uint32_t
+ */
+constexpr int32_t max_residual_cap = 4095;
+static_assert((uint64_t) LikelihoodGrid::max_stations * max_residual_cap * max_residual_cap <= numeric_limits<uint32_t>::max(),
+              "costs of grid cells would overflow");
+
+/**
+ * @brief Fine search window spans the best coarse cell and one coarse cell around it
+ */
+constexpr size_t window_coarse_cells = 3;
+
+LikelihoodGrid::LikelihoodGrid(const grid_config_t& config) : _config(config) {
+  _config.coarse_factor = max<uint8_t>(_config.coarse_factor, 1);
+}
+
+position_t LikelihoodGrid::cell_center(size_t col, size_t row) const{
+  return {_origin.x + (col + 0.5f) * _cell_cm, _origin.y + (row + 0.5f) * _cell_cm};
+}
+
+bool LikelihoodGrid::build(span<const position_t> stations){
+  _stations = 0;
+  if(stations.empty() || stations.size() > max_stations || _config.max_entries == 0){
+    return false;
+  }
+  // bounding box in cm, limited to range of location_local_t
+  constexpr float low = numeric_limits<int16_t>::min();
+  constexpr float high = numeric_limits<int16_t>::max();
+  float min_x = high, min_y = high, max_x = low, max_y = low;
+  for(auto && station : stations){
+    min_x = min(min_x, station.x * cm_scale);
+    min_y = min(min_y, station.y * cm_scale);
+    max_x = max(max_x, station.x * cm_scale);
+    max_y = max(max_y, station.y * cm_scale);
+  }
+  const float margin = _config.margin * cm_scale;
+  min_x = clamp(min_x - margin, low, high);
+  min_y = clamp(min_y - margin, low, high);
+  max_x = clamp(max_x + margin, low, high);
+  max_y = clamp(max_y + margin, low, high);
+  const float width = max(max_x - min_x, 1.0f);
+  const float height = max(max_y - min_y, 1.0f);
+
+  // grow cells until table fits into memory budget
+  const size_t cells_budget = max<size_t>(_config.max_entries / stations.size(), 1);
+  int32_t cell = max<int32_t>(lround(_config.cell_size * cm_scale), 1);
+  cell = max<int32_t>(cell, ceil(sqrt(width * height / cells_budget)));
+  size_t cols, rows;
+  while(true){
+    cols = ceil(width / cell);
+    rows = ceil(height / cell);
+    if(cols * rows <= cells_budget){
+      break;
+    }
+    cell++;
+  }
+
+  _cell_cm = cell;
+  _origin = {min_x, min_y};
+  _cols = cols;
+  _rows = rows;
+  const size_t factor = _config.coarse_factor;
+  _coarse_cols = (cols + factor - 1) / factor;
+  _coarse_rows = (rows + factor - 1) / factor;
+  const size_t cells = cols * rows;
+  const size_t coarse_cells = _coarse_cols * _coarse_rows;
+
+  auto distance_cm = [](position_t from, position_t station) -> uint16_t {
+    const float d = hypot(from.x - station.x * cm_scale, from.y - station.y * cm_scale);
+    return min<float>(lround(d), numeric_limits<uint16_t>::max());
+  };
+
+  _table.resize(stations.size() * cells);
+  _coarse_table.resize(stations.size() * coarse_cells);
+  for(size_t s = 0; s < stations.size(); s++){
+    uint16_t *table = &_table[s * cells];
+    for(size_t row = 0; row < rows; row++){
+      for(size_t col = 0; col < cols; col++){
+        table[row * cols + col] = distance_cm(cell_center(col, row), stations[s]);
+      }
+    }
+    uint16_t *coarse_table = &_coarse_table[s * coarse_cells];
+    for(size_t row = 0; row < _coarse_rows; row++){
+      for(size_t col = 0; col < _coarse_cols; col++){
+        // centre of coarse cell lies between grid cells
+        const position_t center = {_origin.x + (col + 0.5f) * factor * cell, _origin.y + (row + 0.5f) * factor * cell};
+        coarse_table[row * _coarse_cols + col] = distance_cm(center, stations[s]);
+      }
+    }
+  }
+  const size_t window = window_coarse_cells * factor;
+  _cost.resize(max(coarse_cells, window * window));
+  _stations = stations.size();
+  return true;
+}
+
+void LikelihoodGrid::accumulate(const uint16_t *table, uint32_t *cost, size_t count, int32_t distance, int32_t cap){
+  // independent iterations over arrays, vectorizable
+  for(size_t i = 0; i < count; i++){
+    const int32_t r = min(abs((int32_t)table[i] - distance), cap);
+    cost[i] += (uint32_t)(r * r);
+  }
+}
+
+track_t LikelihoodGrid::locate(span<const grid_distance_t> distances){
+  track_t track{};
+  track.valid = false;
+  if(!built() || distances.empty()){
+    return track;
+  }
+  // more residuals could overflow costs of cells
+  distances = distances.first(min(distances.size(), max_stations));
+  const size_t factor = _config.coarse_factor;
+  const int32_t cap = clamp<int32_t>(lround(_config.outlier_distance * cm_scale), 1, max_residual_cap);
+  // distance from coarse cell centre differs by up to half of its diagonal
+  const int32_t coarse_cap = min<int32_t>(cap + factor * _cell_cm, max_residual_cap);
+
+  // coarse search over whole venue
+  const size_t coarse_cells = _coarse_cols * _coarse_rows;
+  fill_n(_cost.begin(), coarse_cells, 0);
+  size_t used = 0;
+  for(auto && measurement : distances){
+    if(measurement.station >= _stations){
+      continue;
+    }
+    const int32_t d = min<float>(lround(max(measurement.distance, 0.0f) * cm_scale), numeric_limits<uint16_t>::max());
+    accumulate(&_coarse_table[measurement.station * coarse_cells], _cost.data(), coarse_cells, d, coarse_cap);
+    used++;
+  }
+  if(used == 0){
+    return track;
+  }
+  const size_t best = min_element(_cost.begin(), _cost.begin() + coarse_cells) - _cost.begin();
+
+  // fine search in window around the best coarse cell
+  const size_t best_col = (best % _coarse_cols) * factor;
+  const size_t best_row = (best / _coarse_cols) * factor;
+  const size_t col0 = best_col >= factor ? best_col - factor : 0;
+  const size_t row0 = best_row >= factor ? best_row - factor : 0;
+  const size_t col1 = min(_cols, best_col + 2 * factor);
+  const size_t row1 = min(_rows, best_row + 2 * factor);
+  const size_t window_cols = col1 - col0;
+  const size_t window_rows = row1 - row0;
+  const size_t cells = _cols * _rows;
+  fill_n(_cost.begin(), window_cols * window_rows, 0);
+  for(auto && measurement : distances){
+    if(measurement.station >= _stations){
+      continue;
+    }
+    const int32_t d = min<float>(lround(max(measurement.distance, 0.0f) * cm_scale), numeric_limits<uint16_t>::max());
+    const uint16_t *table = &_table[measurement.station * cells];
+    for(size_t row = row0; row < row1; row++){
+      accumulate(&table[row * _cols + col0], &_cost[(row - row0) * window_cols], window_cols, d, cap);
+    }
+  }
+  const uint32_t min_cost = *min_element(_cost.begin(), _cost.begin() + window_cols * window_rows);
+
+  // likelihood-weighted mean and covariance of window cells, relative to window corner for precision
+  const position_t corner = cell_center(col0, row0);
+  const float sigma = _config.distance_sigma * cm_scale;
+  const float k = 0.5f / (sigma * sigma);
+  float sum_w = 0, mx = 0, my = 0, sxx = 0, sxy = 0, syy = 0;
+  for(size_t row = row0; row < row1; row++){
+    for(size_t col = col0; col < col1; col++){
+      const float w = exp(-(float)(_cost[(row - row0) * window_cols + col - col0] - min_cost) * k);
+      const float x = (float)(col - col0) * _cell_cm;
+      const float y = (float)(row - row0) * _cell_cm;
+      sum_w += w;
+      mx += w * x;
+      my += w * y;
+      sxx += w * x * x;
+      sxy += w * x * y;
+      syy += w * y * y;
+    }
+  }
+  mx /= sum_w;
+  my /= sum_w;
+  // position inside a cell is uniformly distributed
+  const float quantization = (float)_cell_cm * _cell_cm / 12.0f;
+  const float variance_scale = 1.0f / (cm_scale * cm_scale);
+  track.pos = {(corner.x + mx) / cm_scale, (corner.y + my) / cm_scale};
+  track.covariance = {
+    (max(sxx / sum_w - mx * mx, 0.0f) + quantization) * variance_scale,
+    (sxy / sum_w - mx * my) * variance_scale,
+    (max(syy / sum_w - my * my, 0.0f) + quantization) * variance_scale,
+  };
+  track.valid = true;
+  return track;
+}
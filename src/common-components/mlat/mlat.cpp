@@ -13,6 +13,10 @@
 #include <eigen3/Eigen/Dense>
 #include <cmath>
 #include <numbers>
+#include <type_traits>
+#include <algorithm>
+#include <limits>
+#include <bit>
 
 using namespace mlat;
 using namespace std;
@@ -84,30 +88,763 @@ double_solution_t MLAT::solve_two_anchors(anchor_t anchor0, anchor_t anchor1){
   solution.valid = true;
   return solution;
 }
-solution_t MLAT::solve(const vector<anchor_t>& anchors){
+solution_t MLAT::solve_three_anchors(anchor_t anchor0, anchor_t anchor1, anchor_t anchor2){
   solution_t solution{};
-  if(anchors.size() < 3) {
+  constexpr float eps = 1e-6;
+  const array<anchor_t, 3> anchors {anchor0, anchor1, anchor2};
+  Matrix2f A;
+  Vector2f b;
+  linear_system(span<const anchor_t>(anchors), A, b);
+  add_distances(span<const anchor_t>(anchors), b);
+  const float det = A(0,0)*A(1,1) - A(0,1)*A(1,0);
+  if(abs(det) < eps * A.squaredNorm()){
+    // anchors are collinear
     solution.valid = false;
     return solution;
   }
-  MatrixXf A(anchors.size() - 1, 2);
-  for(size_t i = 1; i < anchors.size(); i++){
-    A(i-1, 0) = anchors[i].pos.x - anchors[0].pos.x;
-    A(i-1, 1) = anchors[i].pos.y - anchors[0].pos.y;
+  solution.pos.x = (b(0)*A(1,1) - A(0,1)*b(1)) / det;
+  solution.pos.y = (A(0,0)*b(1) - b(0)*A(1,0)) / det;
+  solution.error = 0;
+  Matrix2f inverse;
+  inverse << A(1,1), -A(0,1),
+            -A(1,0),  A(0,0);
+  inverse /= det;
+  solution.covariance = to_covariance(linear_covariance(span<const anchor_t>(anchors), inverse));
+  solution.valid = true;
+  return solution;
+}
+
+/**
+ * @brief Call @p f with FixedMLAT specialization matching number of anchors
+ * 
+ * @tparam N smallest supported number of anchors (anchor_traits::min_anchors)
+ * @param count number of anchors (N to max_anchors)
+ * @param f generic lambda taking std::integral_constant with number of anchors
+ * @return result of @p f
+ */
+template<size_t N, typename F>
+static auto dispatch_fixed(size_t count, F&& f){
+  if constexpr (N < max_anchors){
+    if(count > N){
+      return dispatch_fixed<N+1>(count, std::forward<F>(f));
+    }
   }
+  return f(integral_constant<size_t, N>{});
+}
 
-  VectorXf b(A.rows());
-  for(size_t i = 1; i < anchors.size(); i++){
-    b(i-1) = 0.5 * (
-        pow(anchors[0].distance,2) - pow(anchors[i].distance,2) 
-      + (pow(anchors[i].pos.x,2) + pow(anchors[i].pos.y, 2))
-      - (pow(anchors[0].pos.x,2) + pow(anchors[0].pos.y, 2))
-      );
-  }
-  VectorXf x = A.completeOrthogonalDecomposition().solve(b);
-  solution.pos.x = x(0);
-  solution.pos.y = x(1);
+/**
+ * @brief Least squares solution for any number of anchors (heap-free up to max_anchors)
+ */
+template<typename Anchor>
+static typename anchor_traits<Anchor>::solution_type solve_least_squares(span<const Anchor> anchors){
+  using traits = anchor_traits<Anchor>;
+  typename traits::solution_type solution{};
+  if(anchors.size() < traits::min_anchors) {
+    solution.valid = false;
+    return solution;
+  }
+  if(anchors.size() <= max_anchors){
+    return dispatch_fixed<traits::min_anchors>(anchors.size(), [&](auto n){
+      return FixedMLAT<n, Anchor>::solve(span<const Anchor, n>(anchors.data(), n));
+    });
+  }
+  MatrixXf A;
+  VectorXf b;
+  linear_system(anchors, A, b);
+  add_distances(anchors, b);
+  const MatrixXf pinv = A.completeOrthogonalDecomposition().pseudoInverse();
+  VectorXf x = pinv * b;
+  solution.pos = traits::position(x);
   solution.error = ((A*x) - b).norm();
+  if constexpr (traits::dimensions == 2){
+    solution.covariance = to_covariance(linear_covariance(anchors, pinv));
+  }
+  solution.valid = true;
+  return solution;
+}
+
+solution_t MLAT::solve(span<const anchor_t> anchors){
+  return solve_least_squares(anchors);
+}
+
+solution3d_t MLAT::solve(span<const anchor3d_t> anchors){
+  return solve_least_squares(anchors);
+}
+
+anchor_t MLAT::project(anchor3d_t anchor, float z){
+  const float dz = anchor.pos.z - z;
+  const float horizontal = anchor.distance*anchor.distance - dz*dz;
+  return {{anchor.pos.x, anchor.pos.y}, horizontal > 0 ? sqrt(horizontal) : 0.0f};
+}
+
+uint8_t MLAT::snap_to_floor(position3d_t& pos, float floor_height, uint8_t min_floor, uint8_t max_floor){
+  if(max_floor < min_floor){
+    swap(min_floor, max_floor);
+  }
+  const float lowest = min_floor * floor_height;
+  // keep altitude strictly below ceiling of the highest floor
+  const float highest = (max_floor + 1) * floor_height - 0.01f * floor_height;
+  pos.z = clamp(pos.z, lowest, highest);
+  return (uint8_t) clamp<int>(floor(pos.z / floor_height), min_floor, max_floor);
+}
+
+/**
+ * @brief Weight of i-th anchor, unit weights if @p weights are empty
+ */
+static inline float anchor_weight(span<const float> weights, size_t i){
+  return weights.empty() ? 1.0f : weights[i];
+}
+
+float MLAT::cost(span<const anchor_t> anchors, position_t pos){
+  return cost(anchors, {}, pos);
+}
+
+float MLAT::cost(span<const anchor_t> anchors, span<const float> weights, position_t pos){
+  float sum = 0;
+  for(size_t i = 0; i < anchors.size(); i++){
+    const float r = distance_2d(pos, anchors[i].pos) - anchors[i].distance;
+    sum += anchor_weight(weights, i) * r*r;
+  }
+  return sum;
+}
+
+covariance_t MLAT::covariance(span<const anchor_t> anchors, position_t pos){
+  return covariance(anchors, {}, pos);
+}
+
+covariance_t MLAT::covariance(span<const anchor_t> anchors, span<const float> weights, position_t pos){
+  constexpr float eps = 1e-6;
+  float h00 = 0, h01 = 0, h11 = 0;
+  for(size_t i = 0; i < anchors.size(); i++){
+    const float dx = pos.x - anchors[i].pos.x;
+    const float dy = pos.y - anchors[i].pos.y;
+    const float dist = sqrt(dx*dx + dy*dy);
+    if(dist < eps) continue; // gradient is undefined in the anchor position
+    const float w = anchor_weight(weights, i) / (dist*dist);
+    h00 += w * dx*dx;
+    h01 += w * dx*dy;
+    h11 += w * dy*dy;
+  }
+  const float det = h00*h11 - h01*h01;
+  if(det < eps * (h00 + h11) * (h00 + h11)){
+    // position is not determined (e.g. all anchors in one direction)
+    constexpr float inf = numeric_limits<float>::infinity();
+    return {inf, 0, inf};
+  }
+  return {h11 / det, -h01 / det, h00 / det};
+}
+
+solution_t MLAT::refine(span<const anchor_t> anchors, position_t initial, const refine_config_t& config){
+  return refine(anchors, {}, initial, config);
+}
+
+solution_t MLAT::refine(span<const anchor_t> anchors, span<const float> weights, position_t initial, const refine_config_t& config){
+  solution_t solution{};
+  if(anchors.size() < 2 || (!weights.empty() && weights.size() != anchors.size())){
+    solution.valid = false;
+    return solution;
+  }
+  constexpr float eps = 1e-6;
+  position_t pos = initial;
+  float current_cost = cost(anchors, weights, pos);
+  float lambda = config.lambda;
+  uint16_t iteration = 0;
+  while(iteration < config.max_iterations){
+    iteration++;
+    // normal equations of linearized residuals (J^T W J) delta = -J^T W r
+    float h00 = 0, h01 = 0, h11 = 0, g0 = 0, g1 = 0;
+    for(size_t i = 0; i < anchors.size(); i++){
+      const float dx = pos.x - anchors[i].pos.x;
+      const float dy = pos.y - anchors[i].pos.y;
+      const float dist = sqrt(dx*dx + dy*dy);
+      if(dist < eps) continue; // gradient is undefined in the anchor position
+      const float w = anchor_weight(weights, i);
+      const float jx = dx / dist;
+      const float jy = dy / dist;
+      const float r = dist - anchors[i].distance;
+      h00 += w*jx*jx;
+      h01 += w*jx*jy;
+      h11 += w*jy*jy;
+      g0 += w*jx*r;
+      g1 += w*jy*r;
+    }
+    const float a00 = h00 * (1 + lambda) + eps;
+    const float a11 = h11 * (1 + lambda) + eps;
+    const float det = a00*a11 - h01*h01;
+    if(abs(det) < eps) break;
+    const float step_x = -( a11*g0 - h01*g1) / det;
+    const float step_y = -(-h01*g0 + a00*g1) / det;
+    const position_t candidate {pos.x + step_x, pos.y + step_y};
+    const float candidate_cost = cost(anchors, weights, candidate);
+    if(candidate_cost < current_cost){
+      pos = candidate;
+      current_cost = candidate_cost;
+      lambda /= 10;
+    } else {
+      // step made things worse -> move closer to gradient descent
+      lambda *= 10;
+    }
+    if(sqrt(step_x*step_x + step_y*step_y) < config.tolerance){
+      break; // converged
+    }
+  }
+  float weight_sum = 0;
+  for(size_t i = 0; i < anchors.size(); i++){
+    weight_sum += anchor_weight(weights, i);
+  }
+  solution.pos = pos;
+  solution.error = sqrt(current_cost);
+  solution.residual = weight_sum > 0 ? sqrt(current_cost / weight_sum) : 0;
+  solution.covariance = covariance(anchors, weights, pos);
+  solution.iterations = iteration;
+  solution.valid = true;
+  return solution;
+}
+
+template<typename Anchor>
+typename BasicMLATSolver<Anchor>::cache_entry_t& BasicMLATSolver<Anchor>::entry(span<const Anchor> anchors){
+  _use_counter++;
+  cache_entry_t *lru = &_cache[0];
+  for(auto && cached : _cache){
+    if(cached.valid && cached.count == anchors.size()){
+      bool same = true;
+      for(size_t i = 0; i < anchors.size() && same; i++){
+        for(int d = 0; d < dimensions; d++){
+          if(traits::coordinate(cached.positions[i], d) != traits::coordinate(anchors[i].pos, d)){
+            same = false;
+            break;
+          }
+        }
+      }
+      if(same){
+        cached.last_use = _use_counter;
+        _cache_hits++;
+        return cached;
+      }
+    }
+    if(!cached.valid || (lru->valid && cached.last_use < lru->last_use)){
+      lru = &cached;
+    }
+  }
+
+  // geometry was not seen recently -> factorize it
+  _cache_misses++;
+  lru->count = anchors.size();
+  for(size_t i = 0; i < anchors.size(); i++){
+    lru->positions[i] = anchors[i].pos;
+  }
+  linear_system(anchors, lru->A, lru->b_geometry);
+  dispatch_fixed<traits::min_anchors>(anchors.size(), [&](auto n){
+    typename FixedMLAT<n, Anchor>::matrix_t A = lru->A;
+    typename FixedMLAT<n, Anchor>::pinv_t pinv;
+    FixedMLAT<n, Anchor>::factorize(A, pinv);
+    lru->pinv = pinv;
+  });
+  lru->last_use = _use_counter;
+  lru->valid = true;
+  return *lru;
+}
+
+template<typename Anchor>
+typename BasicMLATSolver<Anchor>::solution_type BasicMLATSolver<Anchor>::solve(span<const Anchor> anchors){
+  solution_type solution{};
+  if(anchors.size() < traits::min_anchors) {
+    solution.valid = false;
+    return solution;
+  }
+  if(anchors.size() > max_anchors){
+    return MLAT::solve(anchors);
+  }
+  const cache_entry_t& cached = entry(anchors);
+
+  vector_t b = cached.b_geometry;
+  add_distances(anchors, b);
+  Matrix<float, dimensions, 1> x = cached.pinv * b;
+  solution.pos = traits::position(x);
+  solution.error = ((cached.A*x) - b).norm();
+  if constexpr (dimensions == 2){
+    solution.covariance = to_covariance(linear_covariance(anchors, cached.pinv));
+  }
+  solution.valid = true;
+  return solution;
+}
+
+template<typename Anchor>
+void BasicMLATSolver<Anchor>::invalidate(){
+  for(auto && cached : _cache){
+    cached.valid = false;
+  }
+}
+
+template class mlat::BasicMLATSolver<anchor_t>;
+template class mlat::BasicMLATSolver<anchor3d_t>;
+
+bool IncrementalMLAT::reset(span<const anchor_t> anchors){
+  _solution = {};
+  _solution.valid = false;
+  _count = 0;
+  if(anchors.size() < 3 || anchors.size() > max_anchors){
+    return false;
+  }
+  _count = anchors.size();
+  copy(anchors.begin(), anchors.end(), _anchors.begin());
+  linear_system(anchors, _A, _b);
+  add_distances(anchors, _b);
+
+  const Matrix2f normal = _A.transpose() * _A;
+  constexpr float eps = 1e-6;
+  if(abs(normal.determinant()) < eps * normal.squaredNorm()){
+    // degenerate geometry, normal equations cannot be inverted
+    _count = 0;
+    return false;
+  }
+  _normal_inv = normal.inverse();
+  _a_sum = _A.colwise().sum().transpose();
+  _atb = _A.transpose() * _b;
+  _updates = 0;
+  updateSolution();
+  return true;
+}
+
+solution_t IncrementalMLAT::update(size_t index, float distance){
+  if(_count == 0 || index >= _count){
+    solution_t solution{};
+    solution.valid = false;
+    return solution;
+  }
+  const float old_distance = _anchors[index].distance;
+  _anchors[index].distance = distance;
+  if(index == 0){
+    // anchor 0 is subtracted from all equations -> every element of b is shifted
+    const float delta = 0.5f * (distance*distance - old_distance*old_distance);
+    _b.array() += delta;
+    _atb += _a_sum * delta;
+  } else {
+    const float delta = -0.5f * (distance*distance - old_distance*old_distance);
+    _b(index-1) += delta;
+    _atb += _A.row(index-1).transpose() * delta;
+  }
+  _updates++;
+  if(_updates >= resync_interval){
+    _atb = _A.transpose() * _b;
+    _updates = 0;
+  }
+  updateSolution();
+  return _solution;
+}
+
+void IncrementalMLAT::updateSolution(){
+  const Vector2f x = _normal_inv * _atb;
+  _solution.pos.x = x(0);
+  _solution.pos.y = x(1);
+  _solution.error = ((_A*x) - _b).norm();
+  // pseudo-inverse of full column rank A is (A^T A)^-1 A^T
+  const MLATSolver::pinv_t pinv = _normal_inv * _A.transpose();
+  _solution.covariance = to_covariance(linear_covariance(anchors(), pinv));
+  _solution.valid = true;
+}
+
+robust_solution_t MLAT::solve_robust(span<const anchor_t> anchors, const robust_config_t& config){
+  robust_solution_t result{};
+  const size_t n = anchors.size();
+  if(n < 4 || n > max_anchors){
+    // not enough redundancy to detect outliers (or too many anchors for fixed-size buffers)
+    result.solution = solve(anchors);
+    return result;
+  }
+
+  array<float, max_anchors> residuals;
+  array<float, max_anchors> sorted;
+  float best_median = numeric_limits<float>::max();
+  position_t best_pos {};
+  bool found = false;
+  uint16_t iterations = 0;
+  bool done = false;
+  for(size_t i = 0; i < n && !done; i++){
+    for(size_t j = i + 1; j < n && !done; j++){
+      for(size_t k = j + 1; k < n && !done; k++){
+        if(iterations >= config.max_iterations){
+          done = true;
+          break;
+        }
+        iterations++;
+        solution_t candidate = solve_three_anchors(anchors[i], anchors[j], anchors[k]);
+        if(!candidate.valid) continue;
+
+        size_t inliers = 0;
+        for(size_t a = 0; a < n; a++){
+          const float r = distance_2d(candidate.pos, anchors[a].pos) - anchors[a].distance;
+          residuals[a] = r*r;
+          if(abs(r) <= config.inlier_threshold) inliers++;
+        }
+        copy(residuals.begin(), residuals.begin() + n, sorted.begin());
+        nth_element(sorted.begin(), sorted.begin() + n/2, sorted.begin() + n);
+        const float median = sorted[n/2];
+        if(median < best_median){
+          best_median = median;
+          best_pos = candidate.pos;
+          found = true;
+        }
+        if(inliers >= config.consensus * n){
+          // enough anchors agree with this subset
+          best_pos = candidate.pos;
+          done = true;
+        }
+      }
+    }
+  }
+  result.iterations = iterations;
+  if(!found){
+    // all evaluated subsets were degenerate
+    result.solution = solve(anchors);
+    return result;
+  }
+
+  array<anchor_t, max_anchors> inliers;
+  size_t inlier_count = 0;
+  for(size_t a = 0; a < n; a++){
+    if(abs(distance_2d(best_pos, anchors[a].pos) - anchors[a].distance) <= config.inlier_threshold){
+      inliers[inlier_count++] = anchors[a];
+    } else {
+      result.rejected |= 1u << a;
+    }
+  }
+  if(inlier_count >= 3){
+    result.solution = solve(span<const anchor_t>(inliers.data(), inlier_count));
+  } else {
+    // no consensus, use position of the best subset
+    result.solution.pos = best_pos;
+    result.solution.error = sqrt(cost(anchors, best_pos));
+    result.solution.covariance = covariance(anchors, best_pos);
+    result.solution.valid = true;
+  }
+  return result;
+}
+
+/**
+ * @brief GDOP of normal matrix of unit vectors, @p regularization keeps singular matrices comparable
+ */
+static inline float gdop(float n00, float n01, float n11, float regularization){
+  constexpr float eps = 1e-6;
+  n00 += regularization;
+  n11 += regularization;
+  const float det = n00*n11 - n01*n01;
+  if(det <= eps * (n00 + n11) * (n00 + n11)){
+    // anchors in one direction do not determine the position
+    return numeric_limits<float>::infinity();
+  }
+  return sqrt((n00 + n11) / det);
+}
+
+anchor_selection_t MLAT::select_anchors(span<const position_t> anchors, position_t pos, const selection_config_t& config){
+  anchor_selection_t result{};
+  result.gdop = numeric_limits<float>::infinity();
+  const size_t n = min<size_t>(anchors.size(), 32);
+  if(n == 0){
+    return result;
+  }
+  // relative to normal matrix of a single anchor (unit vector), ranks anchors of not yet determined selection
+  constexpr float regularization = 1e-3;
+  constexpr float eps = 1e-6;
+  // unit vectors scaled by inverse of relative distance error
+  array<float, 32> ux, uy;
+  size_t closest = 0;
+  float closest_dist = numeric_limits<float>::max();
+  for(size_t i = 0; i < n; i++){
+    const float dx = anchors[i].x - pos.x;
+    const float dy = anchors[i].y - pos.y;
+    const float dist = sqrt(dx*dx + dy*dy);
+    // direction is undefined when device is at the anchor, such anchor does not improve geometry
+    const float scale = dist < eps ? 0 : 1 / (dist * (1 + config.distance_weight * dist));
+    ux[i] = dx * scale;
+    uy[i] = dy * scale;
+    if(dist < closest_dist){
+      closest_dist = dist;
+      closest = i;
+    }
+  }
+
+  // closest anchor has the most accurate distance
+  result.selected = 1u << closest;
+  float n00 = ux[closest]*ux[closest];
+  float n01 = ux[closest]*uy[closest];
+  float n11 = uy[closest]*uy[closest];
+  size_t count = 1;
+  while(count < min<size_t>(config.max_anchors, n)){
+    if(count >= config.min_anchors && gdop(n00, n01, n11, 0) <= config.gdop_target){
+      break;
+    }
+    size_t best = n;
+    float best_gdop = numeric_limits<float>::infinity();
+    for(size_t i = 0; i < n; i++){
+      if(result.selected & (1u << i)) continue;
+      const float candidate = gdop(n00 + ux[i]*ux[i], n01 + ux[i]*uy[i], n11 + uy[i]*uy[i], regularization);
+      if(best == n || candidate < best_gdop){
+        best = i;
+        best_gdop = candidate;
+      }
+    }
+    result.selected |= 1u << best;
+    n00 += ux[best]*ux[best];
+    n01 += ux[best]*uy[best];
+    n11 += uy[best]*uy[best];
+    count++;
+  }
+  result.gdop = gdop(n00, n01, n11, 0);
+  return result;
+}
+
+void PositionTracker::propagate(float dt, state_t& x, state_covariance_t& P) const{
+  Matrix4f F = Matrix4f::Identity();
+  F(0,2) = dt;
+  F(1,3) = dt;
+  // white noise acceleration integrated over dt
+  const float q = _config.acceleration_sigma * _config.acceleration_sigma;
+  const float dt2 = dt*dt;
+  Matrix4f Q = Matrix4f::Zero();
+  Q(0,0) = Q(1,1) = q * dt2*dt2 / 4;
+  Q(0,2) = Q(2,0) = Q(1,3) = Q(3,1) = q * dt2*dt / 2;
+  Q(2,2) = Q(3,3) = q * dt2;
+  x = F * x;
+  P = F * P * F.transpose() + Q;
+}
+
+void PositionTracker::initialize(position_t pos, const Matrix2f& R){
+  _x << pos.x, pos.y, 0, 0;
+  _P = Matrix4f::Zero();
+  _P.topLeftCorner<2,2>() = R;
+  _P(2,2) = _P(3,3) = _config.initial_speed_sigma * _config.initial_speed_sigma;
+  _rejections = 0;
+  _initialized = true;
+}
+
+track_t PositionTracker::to_track(const state_t& x, const state_covariance_t& P){
+  track_t track{};
+  track.pos = {x(0), x(1)};
+  track.velocity = {x(2), x(3)};
+  track.covariance = to_covariance(P.topLeftCorner<2,2>());
+  track.valid = true;
+  return track;
+}
+
+track_t PositionTracker::update(position_t pos, covariance_t covariance, float dt){
+  Matrix2f R;
+  R << covariance.xx, covariance.xy,
+       covariance.xy, covariance.yy;
+  if(!_initialized){
+    initialize(pos, R);
+    return to_track(_x, _P);
+  }
+  state_t x = _x;
+  state_covariance_t P = _P;
+  propagate(dt, x, P);
+
+  const Vector2f innovation (pos.x - x(0), pos.y - x(1));
+  const Matrix2f S = P.topLeftCorner<2,2>() + R;
+  const Matrix2f S_inv = S.inverse();
+  if(innovation.dot(S_inv * innovation) > _config.gate){
+    // fix does not agree with prediction
+    _rejections++;
+    if(_rejections >= _config.max_rejections){
+      // prediction is more likely wrong than all the fixes
+      initialize(pos, R);
+      return to_track(_x, _P);
+    }
+    // keep prediction, so that next dt is measured from this update
+    _x = x;
+    _P = P;
+    track_t track = to_track(_x, _P);
+    track.rejected = true;
+    return track;
+  }
+  _rejections = 0;
+  const Matrix<float, 4, 2> K = P.leftCols<2>() * S_inv;
+  _x = x + K * innovation;
+  _P = P - K * P.topRows<2>();
+  // keep covariance symmetric despite rounding errors
+  _P = 0.5f * (_P + _P.transpose()).eval();
+  return to_track(_x, _P);
+}
+
+track_t PositionTracker::predict(float dt) const{
+  if(!_initialized){
+    track_t track{};
+    track.valid = false;
+    return track;
+  }
+  state_t x = _x;
+  state_covariance_t P = _P;
+  propagate(dt, x, P);
+  return to_track(x, P);
+}
+
+/**
+ * @brief Arithmetic of LinearMLAT for given coordinate type
+ */
+template<typename Scalar>
+struct scalar_traits;
+
+template<>
+struct scalar_traits<float>{
+  using accumulator = float;
+
+  static accumulator root(accumulator v){
+    return sqrt(v);
+  }
+
+  static float saturate(accumulator v){
+    return v;
+  }
+
+  /**
+   * @brief Solve normal equations N x = g/2 (g is accumulated from doubled right side)
+   */
+  static bool solve(accumulator n00, accumulator n01, accumulator n11, accumulator g0, accumulator g1, position_t& pos){
+    constexpr float eps = 1e-6;
+    const float det = n00*n11 - n01*n01;
+    const float norm = max({abs(n00), abs(n01), abs(n11)});
+    if(det <= eps * norm * norm){
+      return false;
+    }
+    pos.x = (n11*g0 - n01*g1) / (2*det);
+    pos.y = (n00*g1 - n01*g0) / (2*det);
+    return true;
+  }
+};
+
+template<>
+struct scalar_traits<int16_t>{
+  using accumulator = int64_t;
+
+  /**
+   * @brief Integer square root (floor)
+   */
+  static accumulator root(accumulator v){
+    if(v <= 0) return 0;
+    const uint64_t value = v;
+    // Newton iteration from power of 2 that is not smaller than the root, decreases monotonically
+    uint64_t result = 1ull << ((bit_width(value) + 1) / 2);
+    while(true){
+      const uint64_t next = (result + value / result) / 2;
+      if(next >= result) return result;
+      result = next;
+    }
+  }
+
+  static int16_t saturate(accumulator v){
+    return (int16_t) clamp<accumulator>(v, numeric_limits<int16_t>::min(), numeric_limits<int16_t>::max());
+  }
+
+  /**
+   * @brief Number of bits that @p v has to be shifted right to fit into @p bits bits
+   */
+  static int normalization_shift(uint64_t v, int bits){
+    return max(0, (int) bit_width(v) - bits);
+  }
+
+  /**
+   * @brief Division rounded to nearest integer
+   */
+  static accumulator round_div(accumulator num, accumulator den){
+    const accumulator half = den / 2;
+    return (num >= 0) ? (num + half) / den : (num - half) / den;
+  }
+
+  /**
+   * @brief Solve x = N^-1 g * 2^exponent / 2 from normalized normal equations
+   */
+  static int16_t solve_coordinate(accumulator num, accumulator det, int exponent){
+    if(exponent >= 0){
+      const accumulator den = det >> exponent;
+      if(den == 0){
+        return saturate(num >= 0 ? numeric_limits<accumulator>::max() : numeric_limits<accumulator>::min());
+      }
+      return saturate(round_div(num, den));
+    }
+    return saturate(round_div(num >> -exponent, det));
+  }
+
+  static bool solve(accumulator n00, accumulator n01, accumulator n11, accumulator g0, accumulator g1, position_cm_t& pos){
+    // normalize both sides to 30 bits, so that products of 2 elements fit into 62 bits
+    constexpr int bits = 30;
+    const uint64_t n_max = max({(uint64_t) abs(n00), (uint64_t) abs(n01), (uint64_t) abs(n11)});
+    const uint64_t g_max = max((uint64_t) abs(g0), (uint64_t) abs(g1));
+    const int n_shift = normalization_shift(n_max, bits);
+    const int g_shift = normalization_shift(g_max, bits);
+    n00 >>= n_shift;
+    n01 >>= n_shift;
+    n11 >>= n_shift;
+    g0 >>= g_shift;
+    g1 >>= g_shift;
+
+    const accumulator det = n00*n11 - n01*n01;
+    const accumulator norm = n_max >> n_shift;
+    // same condition as float version: det <= 1e-6 * norm^2 (2^-20 ~ 1e-6)
+    if(det <= 0 || det <= ((norm*norm) >> 20)){
+      return false;
+    }
+    // x = (N' 2^n_shift)^-1 (g' 2^g_shift) / 2
+    const int exponent = g_shift - n_shift - 1;
+    pos.x = solve_coordinate(n11*g0 - n01*g1, det, exponent);
+    pos.y = solve_coordinate(n00*g1 - n01*g0, det, exponent);
+    return true;
+  }
+};
+
+template<typename Scalar>
+typename LinearMLAT<Scalar>::solution_type LinearMLAT<Scalar>::solve(span<const basic_anchor_t<Scalar>> anchors){
+  using traits = scalar_traits<Scalar>;
+  using accumulator = typename traits::accumulator;
+  solution_type solution{};
+  if(anchors.size() < 3){
+    solution.valid = false;
+    return solution;
+  }
+
+  // rows of linearized system and doubled right side, accumulated into normal equations
+  const accumulator x0 = anchors[0].pos.x;
+  const accumulator y0 = anchors[0].pos.y;
+  const accumulator d0 = anchors[0].distance;
+  const accumulator norm0 = x0*x0 + y0*y0 - d0*d0;
+  accumulator n00 = 0, n01 = 0, n11 = 0, g0 = 0, g1 = 0;
+  for(size_t i = 1; i < anchors.size(); i++){
+    const accumulator x = anchors[i].pos.x;
+    const accumulator y = anchors[i].pos.y;
+    const accumulator d = anchors[i].distance;
+    const accumulator ax = x - x0;
+    const accumulator ay = y - y0;
+    const accumulator b = x*x + y*y - d*d - norm0;
+    n00 += ax*ax;
+    n01 += ax*ay;
+    n11 += ay*ay;
+    g0 += ax*b;
+    g1 += ay*b;
+  }
+  if(!traits::solve(n00, n01, n11, g0, g1, solution.pos)){
+    // anchors are collinear
+    solution.valid = false;
+    return solution;
+  }
+
+  accumulator sum = 0;
+  for(auto && anchor : anchors){
+    const accumulator dx = (accumulator) solution.pos.x - anchor.pos.x;
+    const accumulator dy = (accumulator) solution.pos.y - anchor.pos.y;
+    const accumulator r = traits::root(dx*dx + dy*dy) - (accumulator) anchor.distance;
+    sum += r*r;
+  }
+  solution.error = traits::saturate(traits::root(sum));
   solution.valid = true;
   return solution;
-}
\ No newline at end of file
+}
+
+template<typename Scalar>
+Scalar LinearMLAT<Scalar>::project(Scalar distance, Scalar dz){
+  using traits = scalar_traits<Scalar>;
+  using accumulator = typename traits::accumulator;
+  const accumulator horizontal = (accumulator) distance*distance - (accumulator) dz*dz;
+  return horizontal > 0 ? traits::saturate(traits::root(horizontal)) : 0;
+}
+
+template class mlat::LinearMLAT<float>;
+template class mlat::LinearMLAT<int16_t>;
\ No newline at end of file
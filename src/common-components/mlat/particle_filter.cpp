@@ -0,0 +1,163 @@
+/**
+ * @file particle_filter.cpp
+ * @author Daniel Kurek (daniel.kurek.dev@gmail.com)
+ * @brief Implementation of @ref particle_filter.hpp
+ * @version 0.1
+ * @date 2024-05-02
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#include "particle_filter.hpp"
+
+#include <cmath>
+#include <numbers>
+#include <algorithm>
+#include <utility>
+
+using namespace mlat;
+using namespace std;
+
+void ParticleFilterBase::initialize(position_t min, position_t max){
+  const size_t n = _p.x.size();
+  for(size_t i = 0; i < n; i++){
+    _p.x[i] = min.x + (max.x - min.x) * uniform();
+    _p.y[i] = min.y + (max.y - min.y) * uniform();
+    _p.log_weight[i] = 0;
+    _p.weight[i] = 1;
+  }
+  _initialized = true;
+}
+
+void ParticleFilterBase::predict(float dt){
+  const float sigma = _config.motion_sigma * sqrt(std::max(dt, 0.0f));
+  const size_t n = _p.x.size();
+  for(size_t i = 0; i < n; i += 2){
+    // Box-Muller gives two independent normal samples
+    float n0, n1;
+    normal_pair(n0, n1);
+    _p.x[i] += sigma * n0;
+    _p.y[i] += sigma * n1;
+    if(i + 1 < n){
+      normal_pair(n0, n1);
+      _p.x[i+1] += sigma * n0;
+      _p.y[i+1] += sigma * n1;
+    }
+  }
+}
+
+void ParticleFilterBase::update(span<const anchor_t> anchors){
+  const float k = 0.5f / (_config.distance_sigma * _config.distance_sigma);
+  const float max_penalty = k * _config.outlier_distance * _config.outlier_distance;
+  const size_t n = _p.x.size();
+  // buffers of particles do not alias
+  float * __restrict x = _p.x.data();
+  float * __restrict y = _p.y.data();
+  float * __restrict log_weight = _p.log_weight.data();
+  for(auto && anchor : anchors){
+    const float ax = anchor.pos.x;
+    const float ay = anchor.pos.y;
+    const float d = anchor.distance;
+    // independent iterations over arrays, vectorizable
+    for(size_t i = 0; i < n; i++){
+      const float dx = x[i] - ax;
+      const float dy = y[i] - ay;
+      const float r = sqrt(dx*dx + dy*dy) - d;
+      log_weight[i] -= std::min(k * r * r, max_penalty);
+    }
+  }
+  normalize();
+  if(effective_size() < _config.resample_threshold * n){
+    resample();
+  }
+}
+
+track_t ParticleFilterBase::estimate() const{
+  track_t track{};
+  if(!_initialized){
+    track.valid = false;
+    return track;
+  }
+  const size_t n = _p.x.size();
+  float sum_w = 0, mx = 0, my = 0;
+  for(size_t i = 0; i < n; i++){
+    const float w = _p.weight[i];
+    sum_w += w;
+    mx += w * _p.x[i];
+    my += w * _p.y[i];
+  }
+  mx /= sum_w;
+  my /= sum_w;
+  float cxx = 0, cxy = 0, cyy = 0;
+  for(size_t i = 0; i < n; i++){
+    const float dx = _p.x[i] - mx;
+    const float dy = _p.y[i] - my;
+    cxx += _p.weight[i] * dx * dx;
+    cxy += _p.weight[i] * dx * dy;
+    cyy += _p.weight[i] * dy * dy;
+  }
+  track.pos = {mx, my};
+  track.covariance = {cxx / sum_w, cxy / sum_w, cyy / sum_w};
+  track.valid = true;
+  return track;
+}
+
+float ParticleFilterBase::effective_size() const{
+  float sum_w = 0, sum_w2 = 0;
+  for(auto && w : _p.weight){
+    sum_w += w;
+    sum_w2 += w * w;
+  }
+  return sum_w * sum_w / sum_w2;
+}
+
+void ParticleFilterBase::normalize(){
+  const float max_log = *max_element(_p.log_weight.begin(), _p.log_weight.end());
+  const size_t n = _p.x.size();
+  for(size_t i = 0; i < n; i++){
+    _p.log_weight[i] -= max_log;
+    _p.weight[i] = exp(_p.log_weight[i]);
+  }
+}
+
+void ParticleFilterBase::resample(){
+  const size_t n = _p.x.size();
+  float sum_w = 0;
+  for(auto && w : _p.weight){
+    sum_w += w;
+  }
+  const float step = sum_w / n;
+  float position = step * uniform();
+  float cumulative = _p.weight[0];
+  size_t source = 0;
+  for(size_t i = 0; i < n; i++){
+    while(position > cumulative && source < n - 1){
+      source++;
+      cumulative += _p.weight[source];
+    }
+    _p.x_scratch[i] = _p.x[source];
+    _p.y_scratch[i] = _p.y[source];
+    position += step;
+  }
+  // resampled particles become current, old ones are the next scratch buffer
+  swap(_p.x, _p.x_scratch);
+  swap(_p.y, _p.y_scratch);
+  fill(_p.log_weight.begin(), _p.log_weight.end(), 0.0f);
+  fill(_p.weight.begin(), _p.weight.end(), 1.0f);
+}
+
+float ParticleFilterBase::uniform(){
+  _random ^= _random << 13;
+  _random ^= _random >> 17;
+  _random ^= _random << 5;
+  return (_random >> 8) * (1.0f / (1u << 24));
+}
+
+void ParticleFilterBase::normal_pair(float& n0, float& n1){
+  const float u0 = 1.0f - uniform(); // (0, 1], logarithm is finite
+  const float u1 = uniform();
+  const float radius = sqrt(-2.0f * log(u0));
+  const float angle = 2.0f * numbers::pi_v<float> * u1;
+  n0 = radius * cos(angle);
+  n1 = radius * sin(angle);
+}
@@ -0,0 +1,270 @@
+/**
+ * @file survey.cpp
+ * @author Daniel Kurek (daniel.kurek.dev@gmail.com)
+ * @brief Implementation of @ref survey.hpp
+ * @version 0.1
+ * @date 2024-05-14
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#include "survey.hpp"
+
+#include <eigen3/Eigen/Dense>
+#include <cmath>
+#include <algorithm>
+#include <limits>
+
+using namespace mlat;
+using namespace std;
+using namespace Eigen;
+
+/**
+ * @brief Fixed stations closer than this to a common line (RMS) do not tell reflection of the layout (m)
+ */
+constexpr float min_fixed_spread = 0.5;
+
+static inline float distance_2d(const position_t pos1, const position_t pos2){
+  return hypot(pos1.x - pos2.x, pos1.y - pos2.y);
+}
+
+SurveySolver::SurveySolver(size_t stations)
+  : _stations(stations), _sum(stations * stations, 0), _samples(stations * stations, 0),
+    _fixed_pos(stations, position_t{0, 0}), _fixed(stations, false) {}
+
+void SurveySolver::clear_distances(){
+  fill(_sum.begin(), _sum.end(), 0);
+  fill(_samples.begin(), _samples.end(), 0);
+}
+
+void SurveySolver::add_distance(size_t from, size_t to, float distance){
+  if(from >= _stations || to >= _stations || from == to || distance < 0){
+    return;
+  }
+  _sum[from * _stations + to] += distance;
+  _sum[to * _stations + from] += distance;
+  _samples[from * _stations + to]++;
+  _samples[to * _stations + from]++;
+}
+
+void SurveySolver::fix(size_t station, position_t pos){
+  if(station >= _stations) return;
+  _fixed[station] = true;
+  _fixed_pos[station] = pos;
+}
+
+void SurveySolver::release(size_t station){
+  if(station >= _stations) return;
+  _fixed[station] = false;
+}
+
+float SurveySolver::distance(size_t a, size_t b) const{
+  const uint16_t samples = _samples[a * _stations + b];
+  if(samples == 0){
+    return -1;
+  }
+  return _sum[a * _stations + b] / samples;
+}
+
+bool SurveySolver::solvable() const{
+  if(_stations == 0){
+    return false;
+  }
+  // free station needs 3 distances to be unambiguous (or all of them in smaller networks)
+  const size_t required = min<size_t>(3, _stations - 1);
+  for(size_t i = 0; i < _stations; i++){
+    if(_fixed[i]) continue;
+    size_t measured = 0;
+    for(size_t j = 0; j < _stations; j++){
+      if(i != j && _samples[i * _stations + j] > 0) measured++;
+    }
+    if(measured < required){
+      return false;
+    }
+  }
+  vector<float> matrix;
+  return complete_matrix(matrix);
+}
+
+bool SurveySolver::complete_matrix(vector<float>& matrix) const{
+  constexpr float inf = numeric_limits<float>::infinity();
+  const size_t n = _stations;
+  matrix.assign(n * n, inf);
+  for(size_t i = 0; i < n; i++){
+    matrix[i * n + i] = 0;
+    for(size_t j = 0; j < n; j++){
+      if(i != j && _samples[i * n + j] > 0){
+        matrix[i * n + j] = distance(i, j);
+      }
+    }
+  }
+  // Floyd-Warshall, shortest path overestimates the distance but keeps the layout connected
+  for(size_t k = 0; k < n; k++){
+    for(size_t i = 0; i < n; i++){
+      const float ik = matrix[i * n + k];
+      if(ik == inf) continue;
+      for(size_t j = 0; j < n; j++){
+        const float through = ik + matrix[k * n + j];
+        if(through < matrix[i * n + j]){
+          matrix[i * n + j] = through;
+        }
+      }
+    }
+  }
+  return none_of(matrix.begin(), matrix.end(), [](float d){ return d == inf; });
+}
+
+bool SurveySolver::align(vector<position_t>& positions) const{
+  const size_t n = positions.size();
+  vector<size_t> fixed;
+  for(size_t i = 0; i < n; i++){
+    if(_fixed[i]) fixed.push_back(i);
+  }
+
+  if(fixed.empty()){
+    // relative layout: first station in origin, second one on x axis
+    const position_t origin = positions[0];
+    const float angle = n > 1 ? atan2(positions[1].y - origin.y, positions[1].x - origin.x) : 0;
+    const float c = cos(-angle);
+    const float s = sin(-angle);
+    for(auto && pos : positions){
+      const float x = pos.x - origin.x;
+      const float y = pos.y - origin.y;
+      pos = {c*x - s*y, s*x + c*y};
+    }
+    return true;
+  }
+
+  Vector2f layout_center = Vector2f::Zero();
+  Vector2f fixed_center = Vector2f::Zero();
+  for(auto && i : fixed){
+    layout_center += Vector2f(positions[i].x, positions[i].y);
+    fixed_center += Vector2f(_fixed_pos[i].x, _fixed_pos[i].y);
+  }
+  layout_center /= fixed.size();
+  fixed_center /= fixed.size();
+  // spread of fixed stations across their main direction, 0 if they lie on a line
+  Matrix2f scatter = Matrix2f::Zero();
+  for(auto && i : fixed){
+    const Vector2f d = Vector2f(_fixed_pos[i].x, _fixed_pos[i].y) - fixed_center;
+    scatter += d * d.transpose();
+  }
+  const float spread = sqrt(max(SelfAdjointEigenSolver<Matrix2f>(scatter, EigenvaluesOnly).eigenvalues()(0), 0.0f) / fixed.size());
+  if(fixed.size() < 3 || spread < min_fixed_spread){
+    // rotation and reflection are unknown, keep the layout as scaling found it and only move it to fixed stations
+    const Vector2f shift = fixed_center - layout_center;
+    for(auto && pos : positions){
+      pos = {pos.x + shift.x(), pos.y + shift.y()};
+    }
+    return false;
+  }
+
+  // orthogonal Procrustes (Kabsch) between layout and fixed positions of fixed stations, reflection is allowed
+  Matrix2f h = Matrix2f::Zero();
+  for(auto && i : fixed){
+    h += (Vector2f(positions[i].x, positions[i].y) - layout_center) * (Vector2f(_fixed_pos[i].x, _fixed_pos[i].y) - fixed_center).transpose();
+  }
+  JacobiSVD<Matrix2f> svd(h, ComputeFullU | ComputeFullV);
+  const Matrix2f rotation = svd.matrixV() * svd.matrixU().transpose();
+  for(auto && pos : positions){
+    const Vector2f aligned = rotation * (Vector2f(pos.x, pos.y) - layout_center) + fixed_center;
+    pos = {aligned.x(), aligned.y()};
+  }
+  return true;
+}
+
+survey_solution_t SurveySolver::solve(const survey_config_t& config) const{
+  survey_solution_t solution{};
+  solution.valid = false;
+  const size_t n = _stations;
+  vector<float> matrix;
+  if(!solvable() || !complete_matrix(matrix)){
+    return solution;
+  }
+
+  // classical MDS: coordinates from two largest eigenvectors of double centred squared distances
+  MatrixXf b(n, n);
+  for(size_t i = 0; i < n; i++){
+    for(size_t j = 0; j < n; j++){
+      b(i, j) = matrix[i * n + j] * matrix[i * n + j];
+    }
+  }
+  const VectorXf row_mean = b.rowwise().mean();
+  const float mean = row_mean.mean();
+  for(size_t i = 0; i < n; i++){
+    for(size_t j = 0; j < n; j++){
+      b(i, j) = -0.5f * (b(i, j) - row_mean(i) - row_mean(j) + mean);
+    }
+  }
+  vector<position_t> positions(n, position_t{0, 0});
+  if(n > 1){
+    SelfAdjointEigenSolver<MatrixXf> eigen(b);
+    if(eigen.info() != Success){
+      return solution;
+    }
+    // eigenvalues are sorted in increasing order
+    const float scale_x = sqrt(max(eigen.eigenvalues()(n - 1), 0.0f));
+    const float scale_y = n > 2 ? sqrt(max(eigen.eigenvalues()(n - 2), 0.0f)) : 0.0f;
+    for(size_t i = 0; i < n; i++){
+      positions[i].x = eigen.eigenvectors()(i, n - 1) * scale_x;
+      positions[i].y = n > 2 ? eigen.eigenvectors()(i, n - 2) * scale_y : 0.0f;
+    }
+  }
+  solution.ambiguous = !align(positions);
+  for(size_t i = 0; i < n; i++){
+    if(_fixed[i]) positions[i] = _fixed_pos[i];
+  }
+
+  // refine free stations against measured distances only (shortest paths are not real distances)
+  vector<anchor_t> anchors;
+  anchors.reserve(n);
+  uint16_t sweep = 0;
+  while(sweep < config.max_sweeps){
+    sweep++;
+    float max_step = 0;
+    for(size_t i = 0; i < n; i++){
+      if(_fixed[i]) continue;
+      anchors.clear();
+      for(size_t j = 0; j < n; j++){
+        const float d = i != j ? distance(i, j) : -1;
+        if(d >= 0){
+          anchors.push_back({positions[j], d});
+        }
+      }
+      solution_t refined = MLAT::refine(anchors, positions[i], config.refine);
+      if(!refined.valid) continue;
+      max_step = max(max_step, distance_2d(refined.pos, positions[i]));
+      positions[i] = refined.pos;
+    }
+    if(max_step < config.tolerance){
+      break;
+    }
+  }
+  if(none_of(_fixed.begin(), _fixed.end(), [](bool fixed){ return fixed; })){
+    // refinement may have drifted the relative frame
+    align(positions);
+  }
+
+  solution.residuals.assign(n, 0);
+  float total = 0;
+  size_t pairs = 0;
+  for(size_t i = 0; i < n; i++){
+    float sum = 0;
+    size_t count = 0;
+    for(size_t j = 0; j < n; j++){
+      const float d = i != j ? distance(i, j) : -1;
+      if(d < 0) continue;
+      const float r = distance_2d(positions[i], positions[j]) - d;
+      sum += r*r;
+      count++;
+    }
+    solution.residuals[i] = count > 0 ? sqrt(sum / count) : 0;
+    total += sum;
+    pairs += count;
+  }
+  solution.positions = move(positions);
+  solution.residual = pairs > 0 ? sqrt(total / pairs) : 0;
+  solution.sweeps = sweep;
+  solution.valid = true;
+  return solution;
+}
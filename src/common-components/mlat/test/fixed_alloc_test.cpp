@@ -0,0 +1,137 @@
+/**
+ * @file fixed_alloc_test.cpp
+ * @author Daniel Kurek (daniel.kurek.dev@gmail.com)
+ * @brief Solving with 3 to mlat::max_anchors anchors allocates no memory, benchmark of fixed-size solver
+ * @version 0.1
+ * @date 2024-05-20
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#include "test_utils.hpp"
+#include <array>
+
+using namespace mlat;
+using namespace mlat_test;
+
+/**
+ * @brief Number of heap allocations since start of the program
+ */
+static size_t allocations = 0;
+
+// Eigen allocates with malloc, not operator new (which uses malloc too), so the C allocator is counted (glibc)
+extern "C" {
+    void *__libc_malloc(size_t size);
+    void *__libc_calloc(size_t count, size_t size);
+    void *__libc_realloc(void *ptr, size_t size);
+
+    void *malloc(size_t size){
+        allocations++;
+        return __libc_malloc(size);
+    }
+
+    void *calloc(size_t count, size_t size){
+        allocations++;
+        return __libc_calloc(count, size);
+    }
+
+    void *realloc(void *ptr, size_t size){
+        allocations++;
+        return __libc_realloc(ptr, size);
+    }
+}
+
+constexpr size_t fixes = 20000;
+
+/**
+ * @brief Number of allocations made by @p f
+ */
+template<typename F>
+static size_t count_allocations(F&& f){
+    const size_t before = allocations;
+    f();
+    return allocations - before;
+}
+
+static void test_no_allocations(){
+    std::mt19937 rng(1);
+    MLATSolver solver;
+    IncrementalMLAT incremental;
+    PositionTracker tracker({0.2, 1.5, 13.8, 3});
+    constexpr refine_config_t refine_config {10, 0.01, 1e-3};
+    constexpr robust_config_t robust_config {10, 1.5, 0.8};
+    for(size_t n = 3; n <= max_anchors; n++){
+        std::array<anchor_t, max_anchors> buffer;
+        std::span<anchor_t> anchors(buffer.data(), n);
+        std::array<float, max_anchors> weights;
+        weights.fill(0.5);
+        random_anchors(rng, {1, 2}, anchors);
+        add_noise(rng, 0.3, anchors);
+        std::span<const anchor_t> const_anchors(anchors);
+
+        solution_t solution{};
+        CHECK(count_allocations([&]{ solution = MLAT::solve(const_anchors); }) == 0);
+        CHECK(solution.valid);
+        CHECK(count_allocations([&]{ solution = solver.solve(const_anchors); }) == 0);
+        CHECK(count_allocations([&]{ solution = solver.solve(const_anchors); }) == 0);
+        CHECK(count_allocations([&]{ solution = MLAT::refine(const_anchors, std::span<const float>(weights.data(), n), solution.pos, refine_config); }) == 0);
+        CHECK(count_allocations([&]{ MLAT::solve_robust(const_anchors, robust_config); }) == 0);
+        CHECK(count_allocations([&]{ incremental.reset(const_anchors); incremental.update(n - 1, 5); }) == 0);
+        CHECK(count_allocations([&]{ tracker.update(solution.pos, solution.covariance, 1); }) == 0);
+
+        std::array<anchor_cm_t, max_anchors> anchors_cm;
+        for(size_t i = 0; i < n; i++){
+            anchors_cm[i] = {{(int16_t) (anchors[i].pos.x * 100), (int16_t) (anchors[i].pos.y * 100)}, (int16_t) (anchors[i].distance * 100)};
+        }
+        CHECK(count_allocations([&]{ LinearMLAT<int16_t>::solve(std::span<const anchor_cm_t>(anchors_cm.data(), n)); }) == 0);
+    }
+
+    // more anchors than max_anchors fall back to dynamically allocated matrices
+    std::array<anchor_t, max_anchors + 1> many;
+    random_anchors(rng, {1, 2}, many);
+    CHECK(count_allocations([&]{ MLAT::solve(std::span<const anchor_t>(many)); }) > 0);
+}
+
+/**
+ * @brief Results of fixed-size solvers match the dynamic solver
+ */
+static void test_same_result(){
+    std::mt19937 rng(2);
+    for(size_t n = 3; n <= max_anchors; n++){
+        for(size_t i = 0; i < 50; i++){
+            std::array<anchor_t, max_anchors> buffer;
+            std::span<anchor_t> anchors(buffer.data(), n);
+            random_anchors(rng, {-2, 3}, anchors);
+            add_noise(rng, 0.3, anchors);
+            const solution_t solution = MLAT::solve(std::span<const anchor_t>(anchors));
+            const position_t reference = reference_solve(anchors);
+            // 3 anchors are solved in closed form, nearly collinear ones amplify rounding differently
+            const float tolerance = 1e-3f * std::max(1.0f, std::abs(reference.x) + std::abs(reference.y));
+            CHECK_NEAR(solution.pos.x, reference.x, tolerance);
+            CHECK_NEAR(solution.pos.y, reference.y, tolerance);
+        }
+    }
+}
+
+static void benchmark(){
+    std::mt19937 rng(3);
+    for(size_t n = 3; n <= max_anchors; n++){
+        std::array<anchor_t, max_anchors> buffer;
+        std::span<anchor_t> anchors(buffer.data(), n);
+        random_anchors(rng, {1, 1}, anchors);
+        std::span<const anchor_t> const_anchors(anchors);
+        const size_t before = allocations;
+        const double dynamic_ns = time_ns(fixes, [&](size_t){ sink = reference_solve(const_anchors).x; });
+        const double dynamic_allocations = (double) (allocations - before) / fixes;
+        const double fixed_ns = time_ns(fixes, [&](size_t){ sink = MLAT::solve(const_anchors).pos.x; });
+        std::printf("%zu anchors, ns per solve: dynamic %.0f (%.1f allocations), fixed-size %.0f (%.1fx)\n",
+            n, dynamic_ns, dynamic_allocations, fixed_ns, dynamic_ns / fixed_ns);
+    }
+}
+
+int main(){
+    test_no_allocations();
+    test_same_result();
+    benchmark();
+    return result("fixed_alloc_test");
+}
@@ -0,0 +1,149 @@
+/**
+ * @file fixed_point_bench.cpp
+ * @author Daniel Kurek (daniel.kurek.dev@gmail.com)
+ * @brief mlat::LinearMLAT<int16_t> against float mlat::MLAT: error, bit-exact replay and throughput
+ * @version 0.1
+ * @date 2024-05-20
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#include "test_utils.hpp"
+#include <array>
+#include <vector>
+
+using namespace mlat;
+using namespace mlat_test;
+
+constexpr size_t anchor_count = 5;
+constexpr size_t sets = 20000;
+constexpr float pos_scale = 100; // m to cm
+
+/**
+ * @brief Hash of fixed point results of random_sets(1), see test_bit_exact()
+ */
+constexpr uint32_t expected_hash = 0x20c3c04f;
+
+/**
+ * @brief Anchor set on centimetre grid and the true position of the device
+ */
+typedef struct{
+    std::array<anchor_cm_t, anchor_count> anchors_cm;
+    std::array<anchor_t, anchor_count> anchors; /**< the same anchors in metres */
+    position_t truth;
+} anchor_set_t;
+
+/**
+ * @brief Random integer from [min, max] that does not depend on the standard library implementation
+ */
+static int32_t random_cm(std::mt19937& rng, int32_t min, int32_t max){
+    return min + (int32_t)(rng() % (uint32_t)(max - min + 1));
+}
+
+/**
+ * @brief Random anchors of a 50x50 m venue on cm grid, distances with uniform +-20 cm noise rounded to cm
+ */
+static std::vector<anchor_set_t> random_sets(uint32_t seed){
+    std::mt19937 rng(seed);
+    std::vector<anchor_set_t> result(sets);
+    for(auto && set : result){
+        const int32_t x = random_cm(rng, -2000, 2000);
+        const int32_t y = random_cm(rng, -2000, 2000);
+        set.truth = {x / pos_scale, y / pos_scale};
+        for(size_t i = 0; i < anchor_count; i++){
+            anchor_cm_t& anchor = set.anchors_cm[i];
+            anchor.pos = {(int16_t) random_cm(rng, -2500, 2500), (int16_t) random_cm(rng, -2500, 2500)};
+            const int32_t dx = anchor.pos.x - x, dy = anchor.pos.y - y;
+            // correctly rounded square root, same distances on every platform
+            const double d = std::sqrt((double)(dx*dx + dy*dy)) + random_cm(rng, -20, 20);
+            anchor.distance = (int16_t) std::max(std::lround(d), 0l);
+            set.anchors[i] = {{anchor.pos.x / pos_scale, anchor.pos.y / pos_scale}, anchor.distance / pos_scale};
+        }
+    }
+    return result;
+}
+
+/**
+ * @brief FNV-1a hash of fixed-point results
+ */
+static uint32_t hash(uint32_t h, int16_t value){
+    const uint16_t bits = (uint16_t) value;
+    for(uint8_t byte : {(uint8_t)(bits & 0xff), (uint8_t)(bits >> 8)}){
+        h = (h ^ byte) * 16777619u;
+    }
+    return h;
+}
+
+/**
+ * @brief Both solvers have the same error against ground truth and agree within few cm on the same inputs
+ */
+static void test_error(const std::vector<anchor_set_t>& anchor_sets){
+    double float_error = 0, fixed_error = 0;
+    float max_difference = 0;
+    size_t solved = 0;
+    for(auto && set : anchor_sets){
+        const solution_t f = MLAT::solve(set.anchors);
+        const auto q = LinearMLAT<int16_t>::solve(set.anchors_cm);
+        if(!f.valid || !q.valid){
+            continue;
+        }
+        const position_t fixed {q.pos.x / pos_scale, q.pos.y / pos_scale};
+        float_error += distance(f.pos, set.truth);
+        fixed_error += distance(fixed, set.truth);
+        max_difference = std::max(max_difference, distance(f.pos, fixed));
+        solved++;
+    }
+    float_error /= solved;
+    fixed_error /= solved;
+    std::printf("%zu sets: mean error float %.1f cm, fixed point %.1f cm, max difference %.1f cm\n",
+        solved, float_error * pos_scale, fixed_error * pos_scale, max_difference * pos_scale);
+    CHECK(solved > sets * 99 / 100);
+    // rounding to cm must not add more than 1 cm to the mean error
+    CHECK_NEAR(fixed_error, float_error, 0.01);
+    CHECK(max_difference < 0.05);
+}
+
+/**
+ * @brief Fixed point results do not depend on platform or compiler (hash recorded on x86-64)
+ */
+static void test_bit_exact(const std::vector<anchor_set_t>& anchor_sets){
+    uint32_t first = 2166136261u, second = 2166136261u;
+    for(auto && set : anchor_sets){
+        const auto q = LinearMLAT<int16_t>::solve(set.anchors_cm);
+        first = hash(hash(hash(first, q.pos.x), q.pos.y), q.error);
+    }
+    // replay of the same measurements
+    for(auto && set : anchor_sets){
+        const auto q = LinearMLAT<int16_t>::solve(set.anchors_cm);
+        second = hash(hash(hash(second, q.pos.x), q.pos.y), q.error);
+    }
+    std::printf("hash of fixed point results: 0x%08x\n", (unsigned) first);
+    CHECK(first == second);
+    CHECK(first == expected_hash);
+}
+
+/**
+ * @brief Cost of a float and fixed point solve of the same anchor sets
+ */
+static void benchmark(const std::vector<anchor_set_t>& anchor_sets){
+    const double float_ns = time_ns(sets, [&](size_t i){
+        sink = MLAT::solve(anchor_sets[i].anchors).pos.x;
+    });
+    const double linear_ns = time_ns(sets, [&](size_t i){
+        sink = LinearMLAT<float>::solve(anchor_sets[i].anchors).pos.x;
+    });
+    const double fixed_ns = time_ns(sets, [&](size_t i){
+        sink = LinearMLAT<int16_t>::solve(anchor_sets[i].anchors_cm).pos.x;
+    });
+    std::printf("%zu anchors, ns per solve: MLAT %.0f, LinearMLAT<float> %.0f, LinearMLAT<int16_t> %.0f\n",
+        anchor_count, float_ns, linear_ns, fixed_ns);
+    std::printf("solves per second: MLAT %.0f, LinearMLAT<int16_t> %.0f\n", 1e9 / float_ns, 1e9 / fixed_ns);
+}
+
+int main(){
+    const std::vector<anchor_set_t> anchor_sets = random_sets(1);
+    test_error(anchor_sets);
+    test_bit_exact(anchor_sets);
+    benchmark(anchor_sets);
+    return result("fixed_point_bench");
+}
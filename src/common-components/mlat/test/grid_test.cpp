@@ -0,0 +1,95 @@
+/**
+ * @file grid_test.cpp
+ * @author Daniel Kurek (daniel.kurek.dev@gmail.com)
+ * @brief mlat::LikelihoodGrid: position from distances, limit of stations
+ * @version 0.1
+ * @date 2024-05-20
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#include "test_utils.hpp"
+#include "likelihood_grid.hpp"
+#include <vector>
+
+using namespace mlat;
+using namespace mlat_test;
+
+/**
+ * @brief Configuration used by GridLocalization (with default Kconfig)
+ */
+constexpr grid_config_t grid_config {
+    .cell_size = 0.5,
+    .coarse_factor = 4,
+    .margin = 5.0,
+    .distance_sigma = 1.0,
+    .outlier_distance = 1.5,
+    .max_entries = 64 * 1024 / sizeof(uint16_t),
+};
+
+/**
+ * @brief Stations on a circle around the venue centre
+ */
+static std::vector<position_t> stations_on_circle(size_t count, float radius){
+    std::vector<position_t> stations(count);
+    for(size_t i = 0; i < count; i++){
+        const float angle = 2 * 3.14159265f * i / count;
+        stations[i] = {radius * std::cos(angle), radius * std::sin(angle)};
+    }
+    return stations;
+}
+
+/**
+ * @brief Exact and noisy distances locate the device within a cell (or the noise)
+ */
+static void test_locate(){
+    std::mt19937 rng(1);
+    const std::vector<position_t> stations = stations_on_circle(6, 8);
+    LikelihoodGrid grid(grid_config);
+    CHECK(!grid.locate({}).valid);
+    CHECK(grid.build(stations));
+    std::uniform_real_distribution<float> coordinate(-6, 6);
+    std::normal_distribution<float> noise(0, 0.2);
+    for(size_t i = 0; i < 100; i++){
+        const position_t pos {coordinate(rng), coordinate(rng)};
+        std::vector<grid_distance_t> exact, noisy;
+        for(size_t s = 0; s < stations.size(); s++){
+            exact.push_back({(uint16_t) s, distance(stations[s], pos)});
+            noisy.push_back({(uint16_t) s, distance(stations[s], pos) + noise(rng)});
+        }
+        const track_t track = grid.locate(exact);
+        CHECK(track.valid);
+        CHECK(distance(track.pos, pos) < grid.cell_size());
+        CHECK(distance(grid.locate(noisy).pos, pos) < 0.5);
+    }
+}
+
+/**
+ * @brief Costs of cells are uint32_t sums, more stations than LikelihoodGrid::max_stations are rejected
+ *
+ * With all residuals at the cap, the best cell has to be found as with few stations.
+ */
+static void test_station_limit(){
+    LikelihoodGrid grid(grid_config);
+    CHECK(!grid.build(stations_on_circle(LikelihoodGrid::max_stations + 1, 20)));
+    CHECK(!grid.built());
+
+    const std::vector<position_t> stations = stations_on_circle(LikelihoodGrid::max_stations, 20);
+    CHECK(grid.build(stations));
+    const position_t pos {3, -2};
+    std::vector<grid_distance_t> distances;
+    for(size_t s = 0; s < stations.size(); s++){
+        distances.push_back({(uint16_t) s, distance(stations[s], pos)});
+    }
+    // duplicate measurements beyond the limit are ignored
+    distances.insert(distances.end(), distances.begin(), distances.end());
+    const track_t track = grid.locate(distances);
+    CHECK(track.valid);
+    CHECK(distance(track.pos, pos) < grid.cell_size());
+}
+
+int main(){
+    test_locate();
+    test_station_limit();
+    return result("grid_test");
+}
@@ -0,0 +1,107 @@
+/**
+ * @file incremental_test.cpp
+ * @author Daniel Kurek (daniel.kurek.dev@gmail.com)
+ * @brief mlat::IncrementalMLAT against batch solve of the same anchors, benchmark of an update
+ * @version 0.1
+ * @date 2024-05-20
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#include "test_utils.hpp"
+#include <array>
+
+using namespace mlat;
+using namespace mlat_test;
+
+constexpr size_t fixes = 20000;
+
+/**
+ * @brief Every update gives the same position as batch solve of current distances
+ *
+ * Runs many more updates than IncrementalMLAT::resync_interval and updates every anchor
+ * (including the first one, which is subtracted from all rows of the linearized system).
+ */
+static void test_same_as_batch(){
+    std::mt19937 rng(1);
+    for(size_t n = 3; n <= max_anchors; n++){
+        std::array<anchor_t, max_anchors> buffer;
+        std::span<anchor_t> anchors(buffer.data(), n);
+        random_anchors(rng, {1, 2}, anchors);
+        IncrementalMLAT incremental;
+        CHECK(incremental.reset(std::span<const anchor_t>(anchors)));
+        CHECK_NEAR(incremental.solution().pos.x, 1, 1e-3);
+        CHECK_NEAR(incremental.solution().pos.y, 2, 1e-3);
+
+        std::uniform_int_distribution<size_t> index(0, n - 1);
+        std::uniform_real_distribution<float> coordinate(-8, 8);
+        position_t pos {1, 2};
+        for(size_t i = 0; i < 10 * IncrementalMLAT::resync_interval; i++){
+            if(i % 8 == 0){
+                pos = {coordinate(rng), coordinate(rng)};
+            }
+            const size_t updated = i < n ? i : index(rng);
+            std::normal_distribution<float> noise(0, 0.3);
+            anchors[updated].distance = std::max(distance(anchors[updated].pos, pos) + noise(rng), 0.0f);
+            const solution_t solution = incremental.update(updated, anchors[updated].distance);
+            const solution_t batch = MLAT::solve(std::span<const anchor_t>(anchors));
+            CHECK(solution.valid);
+            CHECK_NEAR(solution.pos.x, batch.pos.x, 1e-2);
+            CHECK_NEAR(solution.pos.y, batch.pos.y, 1e-2);
+            CHECK_NEAR(incremental.anchors()[updated].distance, anchors[updated].distance, 0);
+        }
+    }
+}
+
+/**
+ * @brief Degenerate geometry is refused and updates are invalid until the next successful reset
+ */
+static void test_degenerate(){
+    IncrementalMLAT incremental;
+    CHECK(!incremental.update(0, 1).valid);
+    const std::array<anchor_t, 3> collinear {{{{0, 0}, 1}, {{1, 1}, 1}, {{2, 2}, 1}}};
+    CHECK(!incremental.reset(collinear));
+    CHECK(!incremental.update(0, 1).valid);
+    const std::array<anchor_t, 2> two {{{{0, 0}, 1}, {{1, 0}, 1}}};
+    CHECK(!incremental.reset(two));
+
+    std::mt19937 rng(2);
+    std::array<anchor_t, 4> anchors;
+    random_anchors(rng, {0, 0}, anchors);
+    CHECK(incremental.reset(anchors));
+    CHECK(incremental.update(3, anchors[3].distance).valid);
+    CHECK(incremental.anchors().size() == 4);
+}
+
+/**
+ * @brief Cost of a fix after change of one distance: incremental update and batch solve
+ */
+static void benchmark(){
+    std::mt19937 rng(3);
+    for(size_t n = 4; n <= max_anchors; n += 2){
+        std::array<anchor_t, max_anchors> buffer;
+        std::span<anchor_t> anchors(buffer.data(), n);
+        random_anchors(rng, {1, 1}, anchors);
+        add_noise(rng, 0.3, anchors);
+        std::span<const anchor_t> const_anchors(anchors);
+        IncrementalMLAT incremental;
+        incremental.reset(const_anchors);
+        const double batch_ns = time_ns(fixes, [&](size_t i){
+            anchors[i % n].distance += (i & 1) ? 0.01f : -0.01f;
+            sink = MLAT::solve(const_anchors).pos.x;
+        });
+        const double incremental_ns = time_ns(fixes, [&](size_t i){
+            anchors[i % n].distance += (i & 1) ? 0.01f : -0.01f;
+            sink = incremental.update(i % n, anchors[i % n].distance).pos.x;
+        });
+        std::printf("%zu anchors, ns per fix: batch %.0f, incremental %.0f (%.1fx)\n",
+            n, batch_ns, incremental_ns, batch_ns / incremental_ns);
+    }
+}
+
+int main(){
+    test_same_as_batch();
+    test_degenerate();
+    benchmark();
+    return result("incremental_test");
+}
@@ -0,0 +1,86 @@
+/**
+ * @file log_replay.hpp
+ * @author Daniel Kurek (daniel.kurek.dev@gmail.com)
+ * @brief Ticks of MlatLocalization recorded in result/logs, for replay in host tests of mlat
+ * @version 0.1
+ * @date 2024-05-20
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#ifndef MLAT_TEST_LOG_REPLAY_HPP_
+#define MLAT_TEST_LOG_REPLAY_HPP_
+
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "mlat.hpp"
+
+namespace mlat_test {
+    typedef struct{
+        uint32_t id; /**< station id */
+        uint32_t distance_cm; /**< measured distance */
+        mlat::position_t pos; /**< position of the station */
+    } logged_distance_t;
+
+    typedef struct{
+        uint32_t time_ms; /**< time of the resulting position since boot */
+        std::vector<logged_distance_t> distances; /**< distances measured in this tick */
+        mlat::position_t pos; /**< resulting position computed on the device */
+    } logged_tick_t;
+
+    /**
+     * @brief Path of a recorded log (directory is set by CMakeLists.txt)
+     */
+    inline std::string log_path(const char *name){
+        return std::string(MLAT_LOGS_DIR) + "/" + name;
+    }
+
+    /**
+     * @brief Read ticks of MLAT_LOC from a log of a mobile device (e.g. result/logs/0011.txt)
+     *
+     * Every "resulting pos" line closes a tick, distances logged since the previous one belong to it.
+     *
+     * @return std::vector<logged_tick_t> ticks in order of the log, empty if the log cannot be read
+     */
+    inline std::vector<logged_tick_t> read_log(const std::string& path){
+        std::vector<logged_tick_t> ticks;
+        FILE *file = std::fopen(path.c_str(), "r");
+        if(file == nullptr){
+            std::printf("cannot open %s\n", path.c_str());
+            return ticks;
+        }
+        char line[512];
+        logged_tick_t tick{};
+        while(std::fgets(line, sizeof(line), file) != nullptr){
+            uint32_t time_ms;
+            if(std::sscanf(line, "W|I (%" SCNu32 ")", &time_ms) != 1){
+                continue;
+            }
+            const char *message = std::strstr(line, "MLAT_LOC: ");
+            if(message == nullptr){
+                continue;
+            }
+            message += std::strlen("MLAT_LOC: ");
+            logged_distance_t distance;
+            float x, y;
+            if(std::sscanf(message, "id %" SCNu32 " distance %" SCNu32 "(%*[^)]) pos=x%f,y%f",
+                           &distance.id, &distance.distance_cm, &x, &y) == 4){
+                distance.pos = {x, y};
+                tick.distances.push_back(distance);
+            } else if(std::sscanf(message, "resulting pos x=%f,y=%f", &x, &y) == 2){
+                tick.time_ms = time_ms;
+                tick.pos = {x, y};
+                ticks.push_back(std::move(tick));
+                tick = {};
+            }
+        }
+        std::fclose(file);
+        return ticks;
+    }
+}
+
+#endif
@@ -0,0 +1,145 @@
+/**
+ * @file particle_test.cpp
+ * @author Daniel Kurek (daniel.kurek.dev@gmail.com)
+ * @brief mlat::ParticleFilter: convergence, replay of the recorded path of mobile device 0011, benchmark of a tick
+ * @version 0.1
+ * @date 2024-05-20
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#include "test_utils.hpp"
+#include "log_replay.hpp"
+#include "particle_filter.hpp"
+#include <array>
+#include <vector>
+
+using namespace mlat;
+using namespace mlat_test;
+
+/**
+ * @brief Configuration used by ParticleLocalization (with default Kconfig)
+ */
+constexpr particle_config_t particle_config {
+    .motion_sigma = 0.7,
+    .distance_sigma = 1.0,
+    .outlier_distance = 1.5,
+    .resample_threshold = 0.5,
+};
+
+/**
+ * @brief Particles are spread this far around stations when the filter starts (as in ParticleLocalization)
+ */
+constexpr float initial_margin = 5.0;
+
+constexpr size_t particle_count = 256;
+
+/**
+ * @brief Static device with noisy distances to 4 anchors is found, estimate does not depend on anything but the seed
+ */
+static void test_convergence(){
+    std::mt19937 rng(1);
+    const position_t pos {2, -1};
+    std::array<anchor_t, 4> anchors {{{{-5, -5}, 0}, {{5, -5}, 0}, {{5, 5}, 0}, {{-5, 5}, 0}}};
+    ParticleFilter<particle_count> filter(particle_config, 7);
+    ParticleFilter<particle_count> same_seed(particle_config, 7);
+    CHECK(!filter.estimate().valid);
+    filter.initialize({-10, -10}, {10, 10});
+    same_seed.initialize({-10, -10}, {10, 10});
+    for(size_t i = 0; i < 20; i++){
+        for(auto && anchor : anchors){
+            anchor.distance = distance(anchor.pos, pos);
+        }
+        add_noise(rng, 0.3, anchors);
+        filter.predict(1);
+        filter.update(anchors);
+        same_seed.predict(1);
+        same_seed.update(anchors);
+    }
+    const track_t estimate = filter.estimate();
+    CHECK(estimate.valid);
+    CHECK(distance(estimate.pos, pos) < 0.5);
+    CHECK(estimate.covariance.xx > 0 && estimate.covariance.yy > 0);
+    CHECK(filter.effective_size() >= 1 && filter.effective_size() <= particle_count);
+    CHECK_NEAR(same_seed.estimate().pos.x, estimate.pos.x, 0);
+    CHECK_NEAR(same_seed.estimate().pos.y, estimate.pos.y, 0);
+}
+
+/**
+ * @brief Particle filter follows the recorded path of 0011 with smaller steps than least squares fixes of the device
+ *
+ * Distances and times of every tick are read from result/logs/0011.txt, as ParticleLocalization
+ * would get them from DistanceMeter.
+ */
+template<size_t N>
+static void replay(const std::vector<logged_tick_t>& ticks, bool check){
+    ParticleFilter<N> filter(particle_config, 0x11);
+    std::vector<anchor_t> anchors;
+    position_t min {1e9, 1e9}, max {-1e9, -1e9};
+    for(auto && tick : ticks){
+        for(auto && d : tick.distances){
+            min = {std::min(min.x, d.pos.x), std::min(min.y, d.pos.y)};
+            max = {std::max(max.x, d.pos.x), std::max(max.y, d.pos.y)};
+        }
+    }
+    double raw_step = 0, filtered_step = 0, from_fix = 0, tick_ns = 0;
+    size_t steps = 0;
+    position_t last {};
+    for(size_t i = 0; i < ticks.size(); i++){
+        anchors.clear();
+        for(auto && d : ticks[i].distances){
+            anchors.push_back({d.pos, d.distance_cm / 100.0f});
+        }
+        const auto start = std::chrono::steady_clock::now();
+        if(!filter.initialized()){
+            filter.initialize({min.x - initial_margin, min.y - initial_margin}, {max.x + initial_margin, max.y + initial_margin});
+        } else {
+            filter.predict((ticks[i].time_ms - ticks[i-1].time_ms) / 1000.0f);
+        }
+        filter.update(anchors);
+        const track_t estimate = filter.estimate();
+        tick_ns += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        if(check){
+            CHECK(estimate.valid);
+            CHECK(estimate.pos.x >= min.x - initial_margin - 5 && estimate.pos.x <= max.x + initial_margin + 5);
+            CHECK(estimate.pos.y >= min.y - initial_margin - 5 && estimate.pos.y <= max.y + initial_margin + 5);
+        }
+        if(i > 0){
+            raw_step += distance(ticks[i-1].pos, ticks[i].pos);
+            filtered_step += distance(last, estimate.pos);
+            from_fix += distance(estimate.pos, ticks[i].pos);
+            steps++;
+        }
+        last = estimate.pos;
+    }
+    raw_step /= steps;
+    filtered_step /= steps;
+    from_fix /= steps;
+    std::printf("%zu particles, %zu ticks: mean step %.2f m least squares, %.2f m particles, "
+                "%.2f m from least squares fix, %.1f us per tick\n",
+        N, ticks.size(), raw_step, filtered_step, from_fix, tick_ns / ticks.size() / 1000);
+    if(check){
+        CHECK_NEAR(raw_step, 3.4, 0.05);
+        CHECK(filtered_step < 0.75 * raw_step);
+        // follows the same path (least squares fixes have errors of 1.5-2 m and use only 5 closest stations)
+        CHECK(from_fix < 4.0);
+    }
+}
+
+static void test_replay(){
+    const std::vector<logged_tick_t> ticks = read_log(log_path("0011.txt"));
+    CHECK(ticks.size() == 160);
+    if(ticks.size() < 2){
+        return;
+    }
+    replay<particle_count>(ticks, true);
+    // tick time for range of IMF_PARTICLE_COUNT
+    replay<128>(ticks, false);
+    replay<512>(ticks, false);
+}
+
+int main(){
+    test_convergence();
+    test_replay();
+    return result("particle_test");
+}
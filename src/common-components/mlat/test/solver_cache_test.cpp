@@ -0,0 +1,128 @@
+/**
+ * @file solver_cache_test.cpp
+ * @author Daniel Kurek (daniel.kurek.dev@gmail.com)
+ * @brief Cached factorization of mlat::MLATSolver: same result as full solve, reuse and eviction, benchmark
+ * @version 0.1
+ * @date 2024-05-20
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#include "test_utils.hpp"
+#include <array>
+#include <vector>
+
+using namespace mlat;
+using namespace mlat_test;
+
+constexpr size_t anchor_count = 5;
+constexpr size_t fixes = 20000;
+
+/**
+ * @brief Fixes with static anchors and changing distances give the same positions as a full solve
+ */
+static void test_same_result(){
+    std::mt19937 rng(1);
+    std::array<anchor_t, anchor_count> anchors;
+    random_anchors(rng, {1, 2}, anchors);
+    MLATSolver solver;
+    std::uniform_real_distribution<float> coordinate(-8, 8);
+    for(size_t i = 0; i < 100; i++){
+        const position_t pos {coordinate(rng), coordinate(rng)};
+        for(auto && anchor : anchors){
+            anchor.distance = distance(anchor.pos, pos);
+        }
+        add_noise(rng, 0.3, anchors);
+        const solution_t cached = solver.solve(anchors);
+        const position_t reference = reference_solve(anchors);
+        CHECK(cached.valid);
+        CHECK_NEAR(cached.pos.x, reference.x, 1e-3);
+        CHECK_NEAR(cached.pos.y, reference.y, 1e-3);
+    }
+    // geometry was factorized once
+    CHECK(solver.cacheMisses() == 1);
+    CHECK(solver.cacheHits() == 99);
+}
+
+/**
+ * @brief Least recently used geometry is evicted, order of anchors is part of the key
+ */
+static void test_eviction(){
+    std::mt19937 rng(2);
+    std::array<std::array<anchor_t, anchor_count>, MLATSolver::cache_size + 1> geometries;
+    for(auto && anchors : geometries){
+        random_anchors(rng, {0, 0}, anchors);
+    }
+    MLATSolver solver;
+    for(size_t i = 0; i < MLATSolver::cache_size; i++){
+        solver.solve(geometries[i]);
+    }
+    CHECK(solver.cacheMisses() == MLATSolver::cache_size);
+    for(size_t i = 0; i < MLATSolver::cache_size; i++){
+        solver.solve(geometries[i]);
+    }
+    CHECK(solver.cacheHits() == MLATSolver::cache_size);
+
+    // evicts geometries[0], the least recently used one
+    solver.solve(geometries[MLATSolver::cache_size]);
+    solver.solve(geometries[1]);
+    CHECK(solver.cacheHits() == MLATSolver::cache_size + 1);
+    solver.solve(geometries[0]);
+    CHECK(solver.cacheMisses() == MLATSolver::cache_size + 2);
+
+    std::array<anchor_t, anchor_count> swapped = geometries[1];
+    std::swap(swapped[1], swapped[2]);
+    const uint32_t misses = solver.cacheMisses();
+    const solution_t solution = solver.solve(swapped);
+    CHECK(solver.cacheMisses() == misses + 1);
+    CHECK_NEAR(solution.pos.x, reference_solve(swapped).x, 1e-3);
+
+    solver.invalidate();
+    solver.solve(geometries[1]);
+    CHECK(solver.cacheMisses() == misses + 2);
+}
+
+/**
+ * @brief Cost of a fix with full factorization and with cached factorization
+ */
+static void benchmark(){
+    std::mt19937 rng(3);
+    std::array<anchor_t, anchor_count> anchors;
+    random_anchors(rng, {1, 1}, anchors);
+    std::vector<std::array<float, anchor_count>> distances(256);
+    for(auto && row : distances){
+        std::normal_distribution<float> noise(0, 0.3);
+        for(size_t i = 0; i < anchor_count; i++){
+            row[i] = anchors[i].distance + noise(rng);
+        }
+    }
+    auto set_distances = [&](size_t i){
+        const auto& row = distances[i % distances.size()];
+        for(size_t a = 0; a < anchor_count; a++){
+            anchors[a].distance = row[a];
+        }
+    };
+
+    const double reference_ns = time_ns(fixes, [&](size_t i){
+        set_distances(i);
+        sink = reference_solve(anchors).x;
+    });
+    const double fixed_ns = time_ns(fixes, [&](size_t i){
+        set_distances(i);
+        sink = MLAT::solve(anchors).pos.x;
+    });
+    MLATSolver solver;
+    const double cached_ns = time_ns(fixes, [&](size_t i){
+        set_distances(i);
+        sink = solver.solve(anchors).pos.x;
+    });
+    std::printf("%zu anchors, ns per fix: dynamic factorization %.0f, fixed-size factorization %.0f, cached %.0f (%.1fx)\n",
+        anchor_count, reference_ns, fixed_ns, cached_ns, reference_ns / cached_ns);
+}
+
+int main(){
+    test_same_result();
+    test_eviction();
+    benchmark();
+    return result("solver_cache_test");
+}
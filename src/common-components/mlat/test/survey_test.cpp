@@ -0,0 +1,102 @@
+/**
+ * @file survey_test.cpp
+ * @author Daniel Kurek (daniel.kurek.dev@gmail.com)
+ * @brief mlat::SurveySolver: layout from mutual distances, orientation by fixed stations
+ * @version 0.1
+ * @date 2024-05-20
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#include "test_utils.hpp"
+#include "survey.hpp"
+#include <initializer_list>
+#include <vector>
+
+using namespace mlat;
+using namespace mlat_test;
+
+constexpr survey_config_t survey_config {
+    .max_sweeps = 50,
+    .tolerance = 0.01,
+    .refine = {
+        .max_iterations = 20,
+        .tolerance = 0.001,
+        .lambda = 1e-3,
+    },
+};
+
+/**
+ * @brief Stations of an asymmetric layout (mirror image is a different layout)
+ */
+static const std::vector<position_t> layout {{0, 0}, {8, 0}, {9, 6}, {2, 7}, {5, 3}, {-3, 4}};
+
+/**
+ * @brief Solver with all mutual distances of @ref layout, given stations are fixed
+ */
+static SurveySolver solver_with(std::initializer_list<size_t> fixed, const std::vector<position_t>& fixed_pos = layout){
+    SurveySolver solver(layout.size());
+    for(size_t i = 0; i < layout.size(); i++){
+        for(size_t j = 0; j < layout.size(); j++){
+            if(i != j){
+                solver.add_distance(i, j, distance(layout[i], layout[j]));
+            }
+        }
+    }
+    for(auto && i : fixed){
+        solver.fix(i, fixed_pos[i]);
+    }
+    return solver;
+}
+
+/**
+ * @brief 3 fixed stations not on a line place every station, also when scaling found the mirror image
+ */
+static void test_oriented(){
+    for(auto && fixed : {std::initializer_list<size_t>{0, 1, 3}, {2, 3, 5}, {0, 1, 2, 3}}){
+        const SurveySolver solver = solver_with(fixed);
+        CHECK(solver.solvable());
+        const survey_solution_t solution = solver.solve(survey_config);
+        CHECK(solution.valid);
+        CHECK(!solution.ambiguous);
+        for(size_t i = 0; i < layout.size(); i++){
+            CHECK(distance(solution.positions[i], layout[i]) < 0.05);
+        }
+    }
+    // mirrored fixed positions give mirrored layout
+    std::vector<position_t> mirrored = layout;
+    for(auto && pos : mirrored){
+        pos.y = -pos.y;
+    }
+    const survey_solution_t solution = solver_with({0, 1, 3}, mirrored).solve(survey_config);
+    CHECK(!solution.ambiguous);
+    for(size_t i = 0; i < layout.size(); i++){
+        CHECK(distance(solution.positions[i], mirrored[i]) < 0.05);
+    }
+}
+
+/**
+ * @brief 1-2 or collinear fixed stations leave reflection (and rotation) open, solution reports it
+ */
+static void test_ambiguous(){
+    CHECK(solver_with({0}).solve(survey_config).ambiguous);
+    CHECK(solver_with({0, 1}).solve(survey_config).ambiguous);
+    // fixed on a line: 0, 1 and a third station moved onto x axis
+    std::vector<position_t> collinear = layout;
+    collinear[4] = {4, 0.1};
+    CHECK(solver_with({0, 1, 4}, collinear).solve(survey_config).ambiguous);
+
+    // without fixed stations the layout is relative: first station in origin, second on x axis
+    const survey_solution_t relative = solver_with({}).solve(survey_config);
+    CHECK(relative.valid);
+    CHECK(!relative.ambiguous);
+    CHECK(distance(relative.positions[0], {0, 0}) < 0.05);
+    CHECK_NEAR(relative.positions[1].y, 0, 0.05);
+    CHECK_NEAR(relative.positions[1].x, 8, 0.05);
+}
+
+int main(){
+    test_oriented();
+    test_ambiguous();
+    return result("survey_test");
+}
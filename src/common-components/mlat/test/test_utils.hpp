@@ -0,0 +1,113 @@
+/**
+ * @file test_utils.hpp
+ * @author Daniel Kurek (daniel.kurek.dev@gmail.com)
+ * @brief Minimal checks, timing and random geometry shared by host tests of mlat
+ * @version 0.1
+ * @date 2024-05-20
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#ifndef MLAT_TEST_UTILS_HPP_
+#define MLAT_TEST_UTILS_HPP_
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <span>
+#include "mlat.hpp"
+
+namespace mlat_test {
+    inline int failures = 0;
+
+    /**
+     * @brief Value that the optimizer has to compute (keeps benchmarked calls alive)
+     */
+    inline volatile float sink = 0;
+
+    /**
+     * @brief Exit code of the test, summary is printed
+     */
+    inline int result(const char *name){
+        if(failures > 0){
+            std::printf("%s: %d check(s) FAILED\n", name, failures);
+            return 1;
+        }
+        std::printf("%s: OK\n", name);
+        return 0;
+    }
+
+    /**
+     * @brief Mean duration of @p f in nanoseconds
+     */
+    template<typename F>
+    double time_ns(size_t iterations, F&& f){
+        const auto start = std::chrono::steady_clock::now();
+        for(size_t i = 0; i < iterations; i++){
+            f(i);
+        }
+        const auto end = std::chrono::steady_clock::now();
+        return std::chrono::duration<double, std::nano>(end - start).count() / iterations;
+    }
+
+    inline float distance(mlat::position_t a, mlat::position_t b){
+        return std::hypot(a.x - b.x, a.y - b.y);
+    }
+
+    /**
+     * @brief Anchors at random positions of a 20x20 m venue with exact distances to @p pos
+     */
+    inline void random_anchors(std::mt19937& rng, mlat::position_t pos, std::span<mlat::anchor_t> anchors){
+        std::uniform_real_distribution<float> coordinate(-10, 10);
+        for(auto && anchor : anchors){
+            anchor.pos = {coordinate(rng), coordinate(rng)};
+            anchor.distance = distance(anchor.pos, pos);
+        }
+    }
+
+    /**
+     * @brief Least squares solve as it was before caching (dynamic matrices, factorization in every call)
+     */
+    inline mlat::position_t reference_solve(std::span<const mlat::anchor_t> anchors){
+        Eigen::MatrixXf A(anchors.size() - 1, 2);
+        Eigen::VectorXf b(A.rows());
+        for(size_t i = 1; i < anchors.size(); i++){
+            A(i-1, 0) = anchors[i].pos.x - anchors[0].pos.x;
+            A(i-1, 1) = anchors[i].pos.y - anchors[0].pos.y;
+            b(i-1) = 0.5f * (anchors[0].distance*anchors[0].distance - anchors[i].distance*anchors[i].distance
+                + anchors[i].pos.x*anchors[i].pos.x + anchors[i].pos.y*anchors[i].pos.y
+                - anchors[0].pos.x*anchors[0].pos.x - anchors[0].pos.y*anchors[0].pos.y);
+        }
+        const Eigen::VectorXf x = A.completeOrthogonalDecomposition().solve(b);
+        return {x(0), x(1)};
+    }
+
+    /**
+     * @brief Add gaussian noise to distances
+     */
+    inline void add_noise(std::mt19937& rng, float sigma, std::span<mlat::anchor_t> anchors){
+        std::normal_distribution<float> noise(0, sigma);
+        for(auto && anchor : anchors){
+            anchor.distance = std::max(anchor.distance + noise(rng), 0.0f);
+        }
+    }
+}
+
+#define CHECK(cond) do { \
+        if(!(cond)){ \
+            std::printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            mlat_test::failures++; \
+        } \
+    } while(0)
+
+#define CHECK_NEAR(a, b, tolerance) do { \
+        const double check_a_ = (a), check_b_ = (b); \
+        if(!(std::abs(check_a_ - check_b_) <= (tolerance))){ \
+            std::printf("%s:%d: check failed: %s = %g, %s = %g (tolerance %g)\n", __FILE__, __LINE__, \
+                #a, check_a_, #b, check_b_, (double)(tolerance)); \
+            mlat_test::failures++; \
+        } \
+    } while(0)
+
+#endif
@@ -0,0 +1,128 @@
+/**
+ * @file tracker_test.cpp
+ * @author Daniel Kurek (daniel.kurek.dev@gmail.com)
+ * @brief mlat::PositionTracker: prediction between fixes and replay of the recorded path of mobile device 0011
+ * @version 0.1
+ * @date 2024-05-20
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#include "test_utils.hpp"
+#include "log_replay.hpp"
+
+using namespace mlat;
+using namespace mlat_test;
+
+/**
+ * @brief Configuration used by MlatLocalization
+ */
+constexpr tracker_config_t tracker_config {
+    .acceleration_sigma = 0.2,
+    .initial_speed_sigma = 1.5,
+    .gate = 13.8,
+    .max_rejections = 3,
+};
+
+/**
+ * @brief Between fixes the track moves with constant velocity and its uncertainty grows, state is not changed
+ */
+static void test_prediction(){
+    PositionTracker tracker(tracker_config);
+    CHECK(!tracker.predict(1).valid);
+    // walking 1 m/s along x with exact fixes every second
+    for(int i = 0; i <= 10; i++){
+        tracker.update({(float) i, 2}, {0.01, 0, 0.01}, 1);
+    }
+    const track_t state = tracker.state();
+    CHECK(state.valid);
+    CHECK_NEAR(state.velocity.x, 1, 0.05);
+    CHECK_NEAR(state.velocity.y, 0, 0.05);
+    for(float dt : {0.5f, 1.0f, 2.0f}){
+        const track_t predicted = tracker.predict(dt);
+        CHECK(predicted.valid);
+        CHECK_NEAR(predicted.pos.x, state.pos.x + state.velocity.x * dt, 1e-4);
+        CHECK_NEAR(predicted.pos.y, state.pos.y + state.velocity.y * dt, 1e-4);
+        CHECK(predicted.covariance.xx > state.covariance.xx);
+        CHECK(predicted.covariance.yy > state.covariance.yy);
+    }
+    CHECK(tracker.predict(2).covariance.xx > tracker.predict(1).covariance.xx);
+    // prediction does not change the state
+    CHECK_NEAR(tracker.state().pos.x, state.pos.x, 0);
+    CHECK_NEAR(tracker.state().covariance.xx, state.covariance.xx, 0);
+
+    // far fix is rejected and the prediction is kept
+    const track_t rejected = tracker.update({100, 2}, {0.01, 0, 0.01}, 1);
+    CHECK(rejected.rejected);
+    CHECK_NEAR(rejected.pos.x, 11, 0.1);
+}
+
+/**
+ * @brief Mean step between consecutive positions of the recorded path of 0011
+ *
+ * path_0011.csv lists only the stations visited by 0011, so the fixes are taken
+ * from "resulting pos" lines of its log (0011.txt).
+ *
+ * @param ticks ticks of the log
+ * @param fix_sigma standard deviation of the fixes given to the tracker (m)
+ * @param raw_step mean step between fixes computed on the device
+ * @return double mean step between tracked positions
+ */
+static double replay(const std::vector<logged_tick_t>& ticks, float fix_sigma, double& raw_step){
+    const covariance_t fix_covariance {fix_sigma*fix_sigma, 0, fix_sigma*fix_sigma};
+    PositionTracker tracker(tracker_config);
+    double tracked_step = 0;
+    raw_step = 0;
+    position_t last_tracked {};
+    for(size_t i = 0; i < ticks.size(); i++){
+        const float dt = i > 0 ? (ticks[i].time_ms - ticks[i-1].time_ms) / 1000.0f : 0;
+        if(i > 0){
+            // track is predicted to the time of the next fix, uncertainty grows until then
+            const track_t state = tracker.state();
+            const track_t half = tracker.predict(dt / 2);
+            const track_t predicted = tracker.predict(dt);
+            CHECK(predicted.valid);
+            CHECK(state.covariance.xx < half.covariance.xx && half.covariance.xx < predicted.covariance.xx);
+            CHECK_NEAR(half.pos.x, (state.pos.x + predicted.pos.x) / 2, 1e-3);
+            CHECK_NEAR(half.pos.y, (state.pos.y + predicted.pos.y) / 2, 1e-3);
+        }
+        const track_t track = tracker.update(ticks[i].pos, fix_covariance, dt);
+        CHECK(track.valid);
+        if(i > 0){
+            raw_step += distance(ticks[i-1].pos, ticks[i].pos);
+            tracked_step += distance(last_tracked, track.pos);
+        }
+        last_tracked = track.pos;
+    }
+    raw_step /= ticks.size() - 1;
+    return tracked_step / (ticks.size() - 1);
+}
+
+/**
+ * @brief Tracked path of 0011 jitters less than the fixes computed on the device
+ *
+ * Fixes of the recorded path have errors of 1.5-2 m, the mean step drops from 3.4 m to 2.7-3.2 m.
+ */
+static void test_replay(){
+    const std::vector<logged_tick_t> ticks = read_log(log_path("0011.txt"));
+    CHECK(ticks.size() == 160);
+    if(ticks.size() < 2){
+        return;
+    }
+    double raw_step;
+    const double step_low_sigma = replay(ticks, 1.5, raw_step);
+    const double step_high_sigma = replay(ticks, 2.0, raw_step);
+    std::printf("%zu fixes: mean step %.2f m raw, %.2f m tracked (fix sigma 1.5 m), %.2f m tracked (fix sigma 2 m)\n",
+        ticks.size(), raw_step, step_low_sigma, step_high_sigma);
+    // steps are compared rounded to 0.1 m
+    CHECK_NEAR(raw_step, 3.4, 0.05);
+    CHECK(step_low_sigma < 3.25);
+    CHECK(step_high_sigma > 2.65);
+    CHECK(step_high_sigma < step_low_sigma);
+}
+
+int main(){
+    test_prediction();
+    test_replay();
+    return result("tracker_test");
+}
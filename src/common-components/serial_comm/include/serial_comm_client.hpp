@@ -7,6 +7,7 @@
 #include "serial_comm_common.hpp"
 #include "freertos/semphr.h"
 #include <unordered_map>
+#include <vector>
 
 namespace com{
     typedef struct {
@@ -14,6 +15,21 @@ namespace com{
         std::string value; /**< field value */
     } cache_value_t;
 
+    /**
+     * @brief Handler of field value change
+     * 
+     * @param handler_args argument passed to SerialCommCli::registerFieldHandler
+     * @param field changed field (with normalized address if the field has one)
+     * @param value new value of the field
+     */
+    typedef void (*field_handler_t)(void *handler_args, const std::string& field, const std::string& value);
+
+    typedef struct {
+        std::string field_name; /**< field name without address */
+        field_handler_t handler; /**< called when value of the field changes */
+        void *handler_args; /**< first argument of @ref handler */
+    } field_handler_entry_t;
+
     class SerialCommCli : public SerialComm {
         public:
             /**
@@ -60,6 +76,19 @@ namespace com{
              * @return esp_err_t ESP_OK if succeeds
              */
             esp_err_t PutField(uint16_t addr, const std::string& field_name, const std::string& value);
+
+            /**
+             * @brief Register handler called when value of field changes (of any device)
+             * 
+             * Handler is called from the read task, only when received value differs from the cached one.
+             * Should be registered before starting the read task.
+             * 
+             * @param field_name field name without address
+             * @param handler handler
+             * @param handler_args first argument of @p handler
+             * @return esp_err_t ESP_OK if succeeds
+             */
+            esp_err_t registerFieldHandler(const std::string& field_name, field_handler_t handler, void *handler_args);
         private:
             /**
              * @brief Implement processing of incoming messages (only @ref com::SerialReponse)
@@ -73,6 +102,7 @@ namespace com{
             std::unordered_map<std::string, cache_value_t> cache{};
             SemaphoreHandle_t _semMutex; /**< semaphore to synchronize writing and reading to/from cache */
             TickType_t _cacheThreshold; /**< time threshold for value renewal in cache */
+            std::vector<field_handler_entry_t> _fieldHandlers; /**< handlers of field value changes */
     };
 }
 
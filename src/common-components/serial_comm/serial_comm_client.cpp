@@ -67,6 +67,18 @@ esp_err_t SerialCommCli::PutField(uint16_t addr, const std::string& field_name,
     return PutField(field, value);
 }
 
+esp_err_t SerialCommCli::registerFieldHandler(const std::string& field_name, field_handler_t handler, void *handler_args){
+    if(field_name.empty() || handler == nullptr){
+        return ESP_ERR_INVALID_ARG;
+    }
+    if(pdTRUE != xSemaphoreTake(_semMutex, 500 / portTICK_PERIOD_MS)){
+        return ESP_FAIL;
+    }
+    _fieldHandlers.push_back({field_name, handler, handler_args});
+    xSemaphoreGive(_semMutex);
+    return ESP_OK;
+}
+
 void SerialCommCli::processInput(const std::string& input){
     ESP_LOGI(TAG, "Processing input: %s", input.c_str());
     TickType_t now = xTaskGetTickCount();
@@ -96,9 +108,22 @@ void SerialCommCli::processInput(const std::string& input){
                 ESP_LOGW(TAG, "Could not take semaphore when processing input");
                 return;
             }
-            ESP_LOGI(TAG, "Setting cache[%s]=%s", resp.field.c_str(), resp.value.c_str());
-            cache[resp.field] = (cache_value_t){now, resp.value};
-            xSemaphoreGive(_semMutex);
+            {
+                ESP_LOGI(TAG, "Setting cache[%s]=%s", resp.field.c_str(), resp.value.c_str());
+                auto it = cache.find(resp.field);
+                const bool changed = it == cache.end() || it->second.value != resp.value;
+                cache[resp.field] = (cache_value_t){now, resp.value};
+                xSemaphoreGive(_semMutex);
+                if(!changed){
+                    break;
+                }
+                // handlers are called without the mutex, so that they can call GetField()
+                for(auto && entry : _fieldHandlers){
+                    if(entry.field_name == field){
+                        entry.handler(entry.handler_args, resp.field, resp.value);
+                    }
+                }
+            }
             break;
         case FieldParseErr::malformed_addr:
             ESP_LOGE(TAG, "Error during parsing field '%s': malformed_addr", resp.field.c_str());
@@ -34,6 +34,16 @@ typedef struct {
     web_config_validate_function_t validate_function; /**< validation function, value will be saved only if it is valid */
 } config_option_t;
 
+/**
+ * @brief status function
+ * 
+ * @param ctx context passed to web_config_set_status_function()
+ * @param buf output buffer for JSON object
+ * @param buf_size size of @p buf
+ * @return int length of the JSON (as snprintf), negative on error
+ */
+typedef int (*web_config_status_function_t) (void *ctx, char *buf, size_t buf_size);
+
 /**
  * @brief Start web server with website interface for configuration
  */
@@ -54,6 +64,15 @@ void web_config_stop();
  */
 esp_err_t web_config_set_custom_options(size_t size, config_option_t* options_arr);
 
+/**
+ * @brief Set function that provides application status (JSON) for GET /api/v1/status
+ * 
+ * @param function status function, NULL to disable the endpoint
+ * @param ctx context passed to @p function
+ * @return esp_err_t ESP_OK
+ */
+esp_err_t web_config_set_status_function(web_config_status_function_t function, void *ctx);
+
 #ifdef __cplusplus
 }
 #endif
@@ -90,6 +90,10 @@ static const size_t options_len = sizeof(options) / sizeof(options[0]);
 static config_option_t *custom_options;
 
 static size_t custom_options_len;
+
+static web_config_status_function_t status_function;
+
+static void *status_ctx;
 typedef struct {
     nvs_handle_t config_handle;
     char scratch_buf[SCRATCH_BUFSIZE];
@@ -574,6 +578,26 @@ static esp_err_t log_delete_handler(httpd_req_t *req){
     return httpd_resp_sendstr(req, "Ok");
 }
 
+static esp_err_t status_get_handler(httpd_req_t *req){
+    web_config_data_t *data = (web_config_data_t *) req->user_ctx;
+
+    response_custom_header(req);
+
+    if(status_function == NULL){
+        httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "Status is not available");
+        return ESP_FAIL;
+    }
+    int len = status_function(status_ctx, data->scratch_buf, SCRATCH_BUFSIZE);
+    if(len < 0 || len >= SCRATCH_BUFSIZE){
+        ESP_LOGE(TAG, "Failed creating status JSON");
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed creating JSON");
+        return ESP_FAIL;
+    }
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_send(req, data->scratch_buf, len);
+    return ESP_OK;
+}
+
 static esp_err_t reboot_get_handler(httpd_req_t *req){
     response_custom_header(req);
 
@@ -637,6 +661,13 @@ static void web_config_register_uri(httpd_handle_t server, web_config_data_t *us
         .user_ctx = user_ctx};
     httpd_register_uri_handler(server, &log_delete);
     
+    const httpd_uri_t status = {
+        .uri = API_PATH("/status"),
+        .method = HTTP_GET,
+        .handler = status_get_handler,
+        .user_ctx = user_ctx};
+    httpd_register_uri_handler(server, &status);
+
     const httpd_uri_t reboot = {
         .uri = API_PATH("/reboot"),
         .method = HTTP_GET,
@@ -840,6 +871,12 @@ esp_err_t web_config_set_custom_options(size_t size, config_option_t* options_ar
     return ESP_OK;
 }
 
+esp_err_t web_config_set_status_function(web_config_status_function_t function, void *ctx){
+    status_function = function;
+    status_ctx = ctx;
+    return ESP_OK;
+}
+
 void web_config_start()
 {
     esp_err_t ret = nvs_flash_init();
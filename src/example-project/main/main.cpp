@@ -36,6 +36,7 @@ extern "C" void event_handler(void* event_handler_arg, esp_event_base_t event_ba
     if(event_base == DM_EVENT){
         dm_measurement_data_t *dm_measurement;
         dm_nearest_device_change_t *dm_nearest_dev;
+        dm_point_health_change_t *dm_point_health;
         // Check which event was generated
         switch(event_id){
             case DM_MEASUREMENT_DONE:
@@ -50,6 +51,10 @@ extern "C" void event_handler(void* event_handler_arg, esp_event_base_t event_ba
                 dm_nearest_dev = (dm_nearest_device_change_t*) event_data;
                 LOGGER_I(TAG, "DM_NEAREST_DEVICE_CHANGE, from: %" PRIx32 " | to: %" PRIx32, dm_nearest_dev->old_point_id, dm_nearest_dev->new_point_id);
                 break;
+            case DM_POINT_HEALTH_CHANGE:
+                dm_point_health = (dm_point_health_change_t*) event_data;
+                LOGGER_I(TAG, "DM_POINT_HEALTH_CHANGE, id=%" PRIu32 ", health: %d -> %d, failures=%d", dm_point_health->point_id, dm_point_health->old_health, dm_point_health->new_health, dm_point_health->failures);
+                break;
             default:
                 LOGGER_I(TAG, "Unknown event of DM, id=%" PRId32, event_id);
         }